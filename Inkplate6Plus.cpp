@@ -17,6 +17,17 @@ NOTE: This library is still heavily in progress, so there is still some bugs. Us
 SPIClass spi2(HSPI);
 SdFat sd(&spi2);
 
+#if MCP23017_INT_PIN >= 0
+// Given from I/O expander interrupt when TPS65186 PWRGOOD changes.
+static SemaphoreHandle_t pwrGoodSem = NULL;
+static void IRAM_ATTR pwrGoodInt()
+{
+    BaseType_t _woken = pdFALSE;
+    xSemaphoreGiveFromISR(pwrGoodSem, &_woken);
+    if (_woken) portYIELD_FROM_ISR();
+}
+#endif
+
 
 //--------------------------USER FUNCTIONS--------------------------------------------
 Inkplate::Inkplate(uint8_t _mode) : Adafruit_GFX(E_INK_WIDTH, E_INK_HEIGHT) {
@@ -28,11 +39,29 @@ Inkplate::Inkplate(uint8_t _mode) : Adafruit_GFX(E_INK_WIDTH, E_INK_HEIGHT) {
 
 void Inkplate::begin(void) {
     if(_beginDone == 1) return;
+    if (_i2cMutex == NULL) _i2cMutex = xSemaphoreCreateRecursiveMutex();
+    if (_i2cGate == NULL) _i2cGate = xSemaphoreCreateMutex();
+    if (_panelMutex == NULL) _panelMutex = xSemaphoreCreateRecursiveMutex();
+    if (_keepAliveTimer == NULL)
+    {
+        esp_timer_create_args_t _args = {};
+        _args.callback = keepAliveCallback;
+        _args.arg = this;
+        _args.name = "keepAlive";
+        esp_timer_create(&_args, &_keepAliveTimer);
+    }
     Wire.begin();
+    Wire.setClock(I2C_BUS_CLOCK);
+    _i2cClock = I2C_BUS_CLOCK;
+    i2cSetClock(MCP23017_INT_ADDR, MCP23017_FAST_CLOCK);
+    i2cSetClock(MCP23017_EXT_ADDR, MCP23017_FAST_CLOCK);
     memset(mcpRegsInt, 0, 22);
     memset(mcpRegsEx, 0, 22);
     mcpBegin(MCP23017_INT_ADDR, mcpRegsInt);
     mcpBegin(MCP23017_EXT_ADDR, mcpRegsEx);
+
+    // All I/O expander settings are collected and sent in as few I2C transactions as possible.
+    mcpBatchBegin();
     pinModeInternal(MCP23017_INT_ADDR, mcpRegsInt, VCOM, OUTPUT);
     pinModeInternal(MCP23017_INT_ADDR, mcpRegsInt, PWRUP, OUTPUT);
     pinModeInternal(MCP23017_INT_ADDR, mcpRegsInt, WAKEUP, OUTPUT);
@@ -40,23 +69,26 @@ void Inkplate::begin(void) {
     digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, GPIO0_ENABLE, HIGH);
   
     WAKEUP_SET;
+    mcpBatchCommit();
     delay(1);
-    Wire.beginTransmission(0x48);
-    Wire.write(0x09);
-    Wire.write(B00011011); // Power up seq.
-    Wire.write(B00000000); // Power up delay (3mS per rail)
-    Wire.write(B00011011); // Power down seq.
-    Wire.write(B00000000); // Power down delay (6mS per rail)
-    Wire.endTransmission();
+    const uint8_t _pwrSeq[] = {0x09,
+                               B00011011,  // Power up seq.
+                               B00000000,  // Power up delay (3mS per rail)
+                               B00011011,  // Power down seq.
+                               B00000000}; // Power down delay (6mS per rail)
+    i2cWrite(0x48, _pwrSeq, 5);
     delay(1);
+    mcpBatchBegin();
     WAKEUP_CLEAR;
   
     //Set all pins of seconds I/O expander to outputs, low.
     //For some reason, it draw more current in deep sleep when pins are set as inputs...
+    //(These used to go through mcpRegsInt, so they overwrote internal expander's register copy. Batched writes are
+    //flushed per register copy, so second expander has to use its own, mcpRegsEx.)
     for(int i = 0; i < 15; i++)
     {
-        pinModeInternal(MCP23017_EXT_ADDR, mcpRegsInt, i, OUTPUT);
-        digitalWriteInternal(MCP23017_EXT_ADDR, mcpRegsInt, i, LOW);
+        pinModeInternal(MCP23017_EXT_ADDR, mcpRegsEx, i, OUTPUT);
+        digitalWriteInternal(MCP23017_EXT_ADDR, mcpRegsEx, i, LOW);
     }
   
     //For same reason, unused pins of first I/O expander have to be also set as outputs, low.
@@ -96,6 +128,19 @@ void Inkplate::begin(void) {
     // Disable/Enable Backlight PWR
     pinModeInternal(MCP23017_INT_ADDR, mcpRegsInt, BACKLIGHT_EN, OUTPUT);
     digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, BACKLIGHT_EN, HIGH);
+
+#if MCP23017_INT_PIN >= 0
+    // TPS65186 power good signal, any change of it sets interrupt (active low, push-pull)
+    pinModeInternal(MCP23017_INT_ADDR, mcpRegsInt, TPS_PWRGOOD, INPUT);
+    setIntOutputInternal(MCP23017_INT_ADDR, mcpRegsInt, MCP23017_INT_PORTA, MCP23017_INT_NO_MIRROR, MCP23017_INT_PUSHPULL, MCP23017_INT_ACTLOW);
+    setIntPinInternal(MCP23017_INT_ADDR, mcpRegsInt, TPS_PWRGOOD, CHANGE);
+#endif
+    mcpBatchCommit();
+#if MCP23017_INT_PIN >= 0
+    if (pwrGoodSem == NULL) pwrGoodSem = xSemaphoreCreateBinary();
+    pinMode(MCP23017_INT_PIN, INPUT);
+    attachInterrupt(MCP23017_INT_PIN, pwrGoodInt, FALLING);
+#endif
   
     D_memory_new = (uint8_t*)ps_malloc(E_INK_WIDTH * E_INK_HEIGHT / 8);
     _partial = (uint8_t*)ps_malloc(E_INK_WIDTH * E_INK_HEIGHT / 8);
@@ -182,41 +227,70 @@ void Inkplate::display() {
 }
 
 void Inkplate::partialUpdate()
+{
+    partialUpdate(0, E_INK_HEIGHT - 1);
+}
+
+// Partial update of framebuffer rows _y1 to _y2 (panel rows, without rotation). Changes outside of these rows are kept
+// for the next update. Rows outside of the region aren't shifted into the panel at all, only gate driver is clocked.
+void Inkplate::partialUpdate(int16_t _y1, int16_t _y2)
 {
     if (_displayMode == 1) return;
-    if (_blockPartial == 1) 
+    if (_blockPartial == 1)
     {
         display1b();
         return;
     }
-    uint32_t _pos = (E_INK_WIDTH * E_INK_HEIGHT / 8) - 1;
-    uint32_t _send;
-    uint8_t data;
-    uint8_t diffw, diffb;
-    uint32_t n = (E_INK_WIDTH * E_INK_HEIGHT / 4) - 1;
-    uint8_t dram;
-  
-    for (int i = 0; i < E_INK_HEIGHT; i++)
+    if (_y1 < 0) _y1 = 0;
+    if (_y2 > E_INK_HEIGHT - 1) _y2 = E_INK_HEIGHT - 1;
+    if (_y1 > _y2) return;
+    // Rows with the same checksum as the shown ones are skipped like rows outside of the region, nothing at all is done
+    // if no row changed
+    if (rowSumUpdate(_partial, E_INK_WIDTH / 8, _y1, _y2) == 0)
     {
-        for (int j = 0; j < E_INK_WIDTH/8; j++)
-        {
-            diffw = ((*(D_memory_new+_pos))^(*(_partial+_pos)))&(~(*(_partial+_pos)));
-            diffb = ((*(D_memory_new+_pos))^(*(_partial+_pos)))&((*(_partial+_pos)));
-            _pos--;
-            *(_pBuffer+n) = LUTW[diffw>>4] & (LUTB[diffb>>4]);
-            n--;
-            *(_pBuffer+n) = LUTW[diffw&0x0F] & (LUTB[diffb&0x0F]);
-            n--;
-        }
-    }	  
-   
-    einkOn();
+        _refreshesSkipped++;
+        return;
+    }
+    while (!rowChanged(_y1)) _y1++;
+    while (!rowChanged(_y2)) _y2--;
+    _fullSumValid = false;
+    uint8_t data;
+    uint32_t n;
+    statsRefreshBegin(2);
+    if (_energyOn) _energyStats.drivenPixels += energyPixels(2, _partial, _y1, _y2);
+    partialDiff(_y1, _y2);
+
+    panelBegin();
+    statsPhase(REFRESH_PHASE_DATA);
     for (int k = 0; k < 3; k++)
     {
         vscan_start();
         n = (E_INK_WIDTH * E_INK_HEIGHT / 4) - 1;
-        for (int i = 0; i < E_INK_HEIGHT; i++)
+        uint8_t _skipLoaded = 0;
+        for (int i = E_INK_HEIGHT - 1; i >= 0; i--)
         {
+            if (i < _y1 || i > _y2 || !rowChanged(i))
+            {
+                n -= E_INK_WIDTH / 4;
+                if (_skipLoaded)
+                {
+                    skipRow();
+                    continue;
+                }
+                // Source driver still holds data of the last written row, so "no change" row is shifted in once
+                hscan_start(pinLUT[0xFF]);
+                for (int j = 0; j < ((E_INK_WIDTH / 4) - 1); j++)
+                {
+                    GPIO.out_w1ts = (pinLUT[0xFF]) | CL;
+                    GPIO.out_w1tc = DATA | CL;
+                }
+                GPIO.out_w1ts = CL;
+                GPIO.out_w1tc = DATA | CL;
+                vscan_end();
+                _skipLoaded = 1;
+                continue;
+            }
+            _skipLoaded = 0;
             data = *(_pBuffer + n);
             hscan_start(pinLUT[data]);
             n--;
@@ -227,11 +301,11 @@ void Inkplate::partialUpdate()
             GPIO.out_w1tc = DATA | CL;
             n--;
         }
-        GPIO.out_w1ts = (_send) | CL;
+        GPIO.out_w1ts = CL;
         GPIO.out_w1tc = DATA | CL;
         vscan_end();
         }
-        delayMicroseconds(230);
+        vscan_gap(230);
     }
   /*
     for (int k = 0; k < 1; k++) {
@@ -261,11 +335,12 @@ void Inkplate::partialUpdate()
       GPIO.out_w1tc = DATA | CL;
 	  vscan_end();
     }
-    delayMicroseconds(230);
+    vscan_gap(230);
   }
   */
   
-    for (int i = 0; i<(E_INK_WIDTH * E_INK_HEIGHT / 8); i++)
+    statsPhase(REFRESH_PHASE_PREPARE);
+    for (int i = E_INK_WIDTH / 8 * _y1; i < (E_INK_WIDTH * (_y2 + 1) / 8); i++)
     {
 	  *(D_memory_new + i) &= *(_partial + i);
 	  *(D_memory_new + i) |= (*(_partial + i));
@@ -300,13 +375,37 @@ void Inkplate::partialUpdate()
         GPIO.out_w1tc = DATA | CL;
         vscan_end();
         }
-        delayMicroseconds(230);
+        vscan_gap(230);
     }
   */
     cleanFast(2, 2);
     cleanFast(3, 1);
     vscan_start();
-    einkOff();
+    panelEnd();
+    statsRefreshEnd();
+}
+
+// Fills _pBuffer rows _y1 to _y2 with source data that moves pixels changed between D_memory_new (shown image) and
+// _partial (new image) to their new color. Unchanged pixels get "no change" code.
+void Inkplate::partialDiff(int16_t _y1, int16_t _y2)
+{
+    uint32_t _pos = (E_INK_WIDTH * (_y2 + 1) / 8) - 1;
+    uint8_t diffw, diffb;
+    uint32_t n = (E_INK_WIDTH * (_y2 + 1) / 4) - 1;
+
+    for (int i = _y1; i <= _y2; i++)
+    {
+        for (int j = 0; j < E_INK_WIDTH/8; j++)
+        {
+            diffw = ((*(D_memory_new+_pos))^(*(_partial+_pos)))&(~(*(_partial+_pos)));
+            diffb = ((*(D_memory_new+_pos))^(*(_partial+_pos)))&((*(_partial+_pos)));
+            _pos--;
+            *(_pBuffer+n) = LUTW[diffw>>4] & (LUTB[diffb>>4]);
+            n--;
+            *(_pBuffer+n) = LUTW[diffw&0x0F] & (LUTB[diffb&0x0F]);
+            n--;
+        }
+    }
 }
 
 void Inkplate::drawBitmap3Bit(int16_t _x, int16_t _y, const unsigned char* _p, int16_t _w, int16_t _h) {
@@ -340,6 +439,7 @@ void Inkplate::setRotation(uint8_t r) {
         _height = E_INK_WIDTH;
         break;
     }
+    tsUpdateMatrix();
 }
 
 //Turn off epapewr supply and put all digital IO pins in high Z state
@@ -348,25 +448,39 @@ void Inkplate::einkOff()
 {
     if (getPanelState() == 0)
         return;
+    uint8_t _phase = statsPhase(REFRESH_PHASE_POWER_OFF);
+    while (_tempState != 0 && !collectTemperature()) delay(1);
+    // Same order as without batching: source and gate drivers are stopped before VCOM is turned off
+    mcpBatchBegin();
     OE_CLEAR;
     GMOD_CLEAR;
+    mcpBatchCommit();
     GPIO.out &= ~(DATA | LE | CL);
     CKV_CLEAR;
     SPH_CLEAR;
+    mcpBatchBegin();
     SPV_CLEAR;
-
     VCOM_CLEAR;
+    mcpBatchCommit();
+
     delay(6);
+    mcpBatchBegin();
     PWRUP_CLEAR;
     WAKEUP_CLEAR;
+    mcpBatchCommit();
+    _spvStaged = 0;
+    if (_frameLock)
+    {
+        _frameLock = 0;
+        i2cUnlock();
+    }
     
-    unsigned long timer = millis();
-    do {
-        delay(1);
-    } while ((readPowerGood() != 0) && (millis() - timer) < 250);
+    waitPowerGood(0);
 
     //pinsZstate();
     setPanelState(0);
+    if (_energyOn) _energyStats.railsUs += micros() - _energyRailsOn;
+    statsPhase(_phase);
 }
 
 // Turn on supply for epaper display (TPS65186) [+15 VDC, -15VDC, +22VDC, -20VDC, +3.3VDC, VCOM]
@@ -374,15 +488,15 @@ void Inkplate::einkOn()
 {
     if (getPanelState() == 1)
         return;
+    uint8_t _phase = statsPhase(REFRESH_PHASE_POWER_ON);
     WAKEUP_SET;
     delay(1);
     PWRUP_SET;
 
     // Enable all rails
-    Wire.beginTransmission(0x48);
-    Wire.write(0x01);
-    Wire.write(B00111111);
-    Wire.endTransmission();
+    const uint8_t _rails[] = {0x01, B00111111};
+    i2cWrite(0x48, _rails, 2, I2C_PRIO_HIGH);
+    mcpBatchBegin();
     pinsAsOutputs();
     LE_CLEAR;
     OE_CLEAR;
@@ -393,30 +507,225 @@ void Inkplate::einkOn()
     CKV_CLEAR;
     OE_CLEAR;
     VCOM_SET;
+    mcpBatchCommit();
 
-    unsigned long timer = millis();
-    do {
-        delay(1);
-    } while ((readPowerGood() != PWR_GOOD_OK) && (millis() - timer) < 250);
-	if ((millis() - timer) >= 250)
+    if (!waitPowerGood(PWR_GOOD_OK))
     {
+        mcpBatchBegin();
         WAKEUP_CLEAR;
 		VCOM_CLEAR;
 		PWRUP_CLEAR;
+        mcpBatchCommit();
+        statsPhase(_phase);
 		return;
     }
 
     OE_SET;
     setPanelState(1);
+    _energyRailsOn = micros();
+    _powerCycles++;
+    // Rails are up anyway, so temperature is measured during the refresh and collected before power down.
+    startTemperature();
+    _spvStaged = 0;
+    _frameStartTime = 0;
+    _frameStarts = 0;
+    statsPhase(_phase);
+}
+
+// Waits until power good register of TPS65186 reads _pg. Without interrupt, register is polled every PWR_GOOD_POLL_MS.
+// With interrupt, task blocks until PWRGOOD pin changes (or PWR_GOOD_INT_POLL_MS passes, in case an edge was missed) and
+// only then reads the register again, bus is free for other tasks in the meantime.
+bool Inkplate::waitPowerGood(uint8_t _pg)
+{
+    unsigned long _timer = millis();
+#if MCP23017_INT_PIN >= 0
+    // Interrupt left active from earlier change would block the next falling edge, so release it first.
+    if (digitalRead(MCP23017_INT_PIN) == LOW) getINTstateInternal(MCP23017_INT_ADDR, mcpRegsInt);
+    if (pwrGoodSem != NULL) xSemaphoreTake(pwrGoodSem, 0);
+    const uint32_t _poll = pwrGoodSem != NULL ? PWR_GOOD_INT_POLL_MS : PWR_GOOD_POLL_MS;
+#else
+    const uint32_t _poll = PWR_GOOD_POLL_MS;
+#endif
+    while (readPowerGood() != _pg)
+    {
+        uint32_t _elapsed = millis() - _timer;
+        if (_elapsed >= PWR_GOOD_TIMEOUT) return false;
+        uint32_t _wait = PWR_GOOD_TIMEOUT - _elapsed < _poll ? PWR_GOOD_TIMEOUT - _elapsed : _poll;
+#if MCP23017_INT_PIN >= 0
+        if (pwrGoodSem != NULL)
+        {
+            // Reading captured state releases interrupt output of I/O expander, so the next change can be seen.
+            if (xSemaphoreTake(pwrGoodSem, pdMS_TO_TICKS(_wait)) == pdTRUE)
+                getINTstateInternal(MCP23017_INT_ADDR, mcpRegsInt);
+            continue;
+        }
+#endif
+        delay(_wait);
+    }
+    return true;
+}
+
+// Every refresh starts with panelBegin() and ends with panelEnd(). If keep-alive time is set, panel stays powered
+// after refresh and it's turned off from timer if there is no new refresh in that time.
+void Inkplate::panelBegin()
+{
+    statsPhase(REFRESH_PHASE_OTHER);
+    if (_panelMutex != NULL) xSemaphoreTakeRecursive(_panelMutex, portMAX_DELAY);
+    if (_keepAliveTimer != NULL) esp_timer_stop(_keepAliveTimer);
+    _keepAliveExpired = false;
+    if (getPanelState() == 1) _powerCyclesAvoided++;
+    einkOn();
+}
+
+void Inkplate::panelEnd()
+{
+    statsPhase(REFRESH_PHASE_OTHER);
+    if (_keepAlive == 0 || _keepAliveTimer == NULL || _keepAliveTask == NULL || getPanelState() == 0)
+    {
+        einkOff();
+    }
+    else
+    {
+        // Rails stay up, but gate driver clock is stopped and I2C bus is released until the next refresh.
+        CKV_CLEAR;
+        if (_frameLock)
+        {
+            _frameLock = 0;
+            i2cUnlock();
+        }
+        esp_timer_start_once(_keepAliveTimer, (uint64_t)_keepAlive * 1000);
+    }
+    if (_panelMutex != NULL) xSemaphoreGiveRecursive(_panelMutex);
+}
+
+// Runs from esp_timer task when keep-alive time expires. Power down takes several milliseconds and I2C transactions, so it
+// isn't done here (it would hold up all other esp_timer callbacks), the task that does it is only notified.
+void Inkplate::keepAliveCallback(void *_p)
+{
+    Inkplate *_d = (Inkplate *)_p;
+    _d->_keepAliveExpired = true;
+    xTaskNotifyGive(_d->_keepAliveTask);
+}
+
+void Inkplate::keepAliveTask(void *_p)
+{
+    Inkplate *_d = (Inkplate *)_p;
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        _d->keepAliveOff();
+    }
+}
+
+// Turns the panel off if keep-alive time expired. Refresh that started meanwhile (it holds panel mutex) clears the flag
+// in panelBegin(), so panel stays on and the timer is started again at the end of that refresh.
+void Inkplate::keepAliveOff()
+{
+    if (_panelMutex != NULL) xSemaphoreTakeRecursive(_panelMutex, portMAX_DELAY);
+    if (_keepAliveExpired)
+    {
+        _keepAliveExpired = false;
+        i2cLock(I2C_PRIO_NORMAL);
+        einkOff();
+        i2cUnlock();
+    }
+    if (_panelMutex != NULL) xSemaphoreGiveRecursive(_panelMutex);
+}
+
+// Time (in milliseconds) panel power stays on after refresh. 0 (default) turns it off right after each refresh.
+void Inkplate::setPowerKeepAlive(uint32_t _ms)
+{
+    if (_ms != 0 && _keepAliveTask == NULL &&
+        xTaskCreatePinnedToCore(keepAliveTask, "keepAlive", 3072, this, 2, &_keepAliveTask, tskNO_AFFINITY) != pdPASS)
+    {
+        _keepAliveTask = NULL;
+        return;
+    }
+    _keepAlive = _ms;
+    if (_ms == 0 && _keepAliveTimer != NULL && getPanelState() == 1)
+    {
+        esp_timer_stop(_keepAliveTimer);
+        _keepAliveExpired = true;
+        keepAliveOff();
+    }
+}
+
+uint32_t Inkplate::getPowerKeepAlive()
+{
+    return _keepAlive;
+}
+
+// Number of times panel power was turned on.
+uint32_t Inkplate::getPowerCycles()
+{
+    return _powerCycles;
+}
+
+// Number of refreshes that found panel already powered (keep-alive time didn't expire yet).
+uint32_t Inkplate::getPowerCyclesAvoided()
+{
+    return _powerCyclesAvoided;
+}
+
+// With skipping on (off by default), display() of the same image that the last display() showed does nothing, if
+// there was no partialUpdate() or cleaning since. So display() after partial updates still removes ghosting.
+// partialUpdate() always drives only rows that changed and does nothing if no row changed.
+void Inkplate::setSkipUnchanged(bool _on)
+{
+    _skipUnchanged = _on;
+}
+
+bool Inkplate::getSkipUnchanged()
+{
+    return _skipUnchanged;
+}
+
+// Number of display() and partialUpdate() calls that were skipped because nothing changed.
+uint32_t Inkplate::getRefreshesSkipped()
+{
+    return _refreshesSkipped;
+}
+
+// Checksum of one framebuffer row (_n bytes, multiple of 4). One multiplication per 32 bit word, so it is much cheaper
+// than one frame of refresh. Every step is invertible, change of any single word always changes the checksum.
+uint32_t Inkplate::rowChecksum(const uint8_t *_p, uint16_t _n)
+{
+    const uint32_t *_w = (const uint32_t *)_p;
+    uint32_t _h = 0x811C9DC5;
+    for (uint16_t i = 0; i < _n / 4; i++)
+        _h = (_h ^ _w[i]) * 0x01000193;
+    return _h;
+}
+
+// Stores checksums of rows _y1 to _y2 of _fb and marks rows whose checksum differs from the shown one. Returns number
+// of changed rows. All rows are changed if checksums aren't valid.
+uint16_t Inkplate::rowSumUpdate(const uint8_t *_fb, uint16_t _rowBytes, int16_t _y1, int16_t _y2)
+{
+    uint16_t _changed = 0;
+    memset(_rowChanged, 0, sizeof(_rowChanged));
+    for (int16_t i = _y1; i <= _y2; i++)
+    {
+        uint32_t _sum = rowChecksum(_fb + (uint32_t)_rowBytes * i, _rowBytes);
+        if (!_rowSumValid || _sum != _rowSum[i])
+        {
+            _rowChanged[i >> 3] |= 1 << (i & 7);
+            _changed++;
+        }
+        _rowSum[i] = _sum;
+    }
+    return _changed;
+}
+
+bool Inkplate::rowChanged(int16_t _y)
+{
+    return _rowChanged[_y >> 3] & (1 << (_y & 7));
 }
 
 uint8_t Inkplate::readPowerGood() {
-    Wire.beginTransmission(0x48);
-    Wire.write(0x0F);
-    Wire.endTransmission();
-	
-    Wire.requestFrom(0x48, 1);
-    return Wire.read();
+    const uint8_t _reg = 0x0F;
+    uint8_t _pg = 0;
+    i2cWriteRead(0x48, &_reg, 1, &_pg, 1, I2C_PRIO_HIGH);
+    return _pg;
 }
 
 void Inkplate::selectDisplayMode(uint8_t _mode) {
@@ -427,6 +736,8 @@ void Inkplate::selectDisplayMode(uint8_t _mode) {
 		memset(_pBuffer, 0, E_INK_WIDTH * E_INK_HEIGHT/4);
 		memset(D_memory4Bit, 255, E_INK_WIDTH * E_INK_HEIGHT/2);
 		_blockPartial = 1;
+		_rowSumValid = false;
+		_fullSumValid = false;
 	}
 }
 
@@ -436,40 +747,187 @@ uint8_t Inkplate::getDisplayMode() {
 
 int Inkplate::drawBitmapFromSD(SdFile* p, int x, int y) {
 	if(sdCardOk == 0) return 0;
-	struct bitmapHeader bmpHeader;
-	readBmpHeader(p, &bmpHeader);
-	if (bmpHeader.signature != 0x4D42 || bmpHeader.compression != 0 || !(bmpHeader.color == 1 || bmpHeader.color == 24)) return 0;
-
-	if ((bmpHeader.color == 24 || bmpHeader.color == 32) && getDisplayMode() != INKPLATE_3BIT) {
-		selectDisplayMode(INKPLATE_3BIT);
-	}
-
-	if (bmpHeader.color == 1 && getDisplayMode() != INKPLATE_1BIT) {
-		selectDisplayMode(INKPLATE_1BIT);
-	}
-  
-	if (bmpHeader.color == 1) drawMonochromeBitmap(p, bmpHeader, x, y);
-	if (bmpHeader.color == 24) drawGrayscaleBitmap24(p, bmpHeader, x, y);
-
-  return 1;
+	SdRawReader r(p, _sdRawBuffer, &_sdClock);
+	return drawBitmap(&r, x, y, true);
 }
 
 int Inkplate::drawBitmapFromSD(char* fileName, int x, int y) {
   if(sdCardOk == 0) return 0;
   SdFile dat;
   if (dat.open(fileName, O_RDONLY)) {
-    return drawBitmapFromSD(&dat, x, y);
+    int ret = drawBitmapFromSD(&dat, x, y);
+    dat.close();
+    return ret;
   } else {
     return 0;
   }
 }
 
-int Inkplate::sdCardInit() {
-	spi2.begin(14, 12, 13, 15);
-	sdCardOk = sd.begin(15, SD_SCK_MHZ(25));
+// Draws bitmap from any image source (see ImageSource class), e.g. file, buffer in memory or Serial.
+int Inkplate::drawBitmapFromSource(ImageSource* s, int x, int y) {
+	return drawBitmap(s, x, y, true);
+}
+
+// Draws bitmap that is sent over Serial (or any other Stream) without storing it anywhere first.
+int Inkplate::drawBitmapFromStream(Stream* s, int x, int y) {
+	StreamSource src(*s);
+	return drawBitmap(&src, x, y, true);
+}
+
+int Inkplate::drawBitmapFromBuffer(const uint8_t* p, uint32_t size, int x, int y) {
+	MemorySource src(p, size);
+	return drawBitmap(&src, x, y, true);
+}
+
+// Allocates spare framebuffer for current display mode and starts the task on the other core that decodes images into it.
+bool Inkplate::slideshowBegin()
+{
+    uint32_t _size = _displayMode == INKPLATE_1BIT ? (E_INK_WIDTH * E_INK_HEIGHT / 8) : (E_INK_WIDTH * E_INK_HEIGHT / 2);
+    if (_spareBuffer != NULL && _spareMode != _displayMode)
+    {
+        free(_spareBuffer);
+        _spareBuffer = NULL;
+    }
+    if (_spareBuffer == NULL)
+    {
+        _spareBuffer = (uint8_t*)ps_malloc(_size);
+        if (_spareBuffer == NULL) return false;
+        _spareMode = _displayMode;
+    }
+    if (_prefetchTask == NULL)
+    {
+        _prefetchStart = xSemaphoreCreateBinary();
+        _prefetchDone = xSemaphoreCreateBinary();
+        if (_prefetchStart == NULL || _prefetchDone == NULL) return false;
+        if (xTaskCreatePinnedToCore(prefetchTask, "inkPrefetch", 8192, this, 1, &_prefetchTask, 0) != pdPASS)
+        {
+            _prefetchTask = NULL;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Prefetch task is not deleted from here, because it could be in the middle of SD card read, holding the bus. It's asked
+// to exit and this waits until it does.
+void Inkplate::slideshowEnd()
+{
+    if (_prefetchTask != NULL)
+    {
+        _prefetchExited = false;
+        _prefetchExit = true;
+        xSemaphoreGive(_prefetchStart);
+        while (!_prefetchExited)
+            xSemaphoreTake(_prefetchDone, portMAX_DELAY);
+        _prefetchExit = false;
+        vSemaphoreDelete(_prefetchStart);
+        vSemaphoreDelete(_prefetchDone);
+        _prefetchTask = NULL;
+    }
+    free(_spareBuffer);
+    _spareBuffer = NULL;
+}
+
+// Shows image that is currently in framebuffer and in the same time decodes next image from SD card into spare framebuffer
+// on the other core. After refresh buffers are swapped, so next image is already in framebuffer when this function returns.
+// Images must have the same color depth as current display mode. Returns 1 if next image is decoded, 0 if not (then the
+// framebuffer still holds the image that was just shown).
+int Inkplate::displayAndPrefetch(char* fileName, int x, int y)
+{
+    if (sdCardOk == 0 || ((_spareMode != _displayMode || _spareBuffer == NULL) && !slideshowBegin()))
+    {
+        display();
+        return 0;
+    }
+
+    uint8_t *_front;
+    if (_displayMode == INKPLATE_1BIT)
+    {
+        _front = _partial;
+        _partial = _spareBuffer;
+        memset(_partial, 0, E_INK_WIDTH * E_INK_HEIGHT / 8);
+    }
+    else
+    {
+        _front = D_memory4Bit;
+        D_memory4Bit = _spareBuffer;
+        memset(D_memory4Bit, 255, E_INK_WIDTH * E_INK_HEIGHT / 2);
+    }
+    _spareBuffer = _front;
+
+    strncpy(_prefetchName, fileName, sizeof(_prefetchName) - 1);
+    _prefetchName[sizeof(_prefetchName) - 1] = 0;
+    _prefetchX = x;
+    _prefetchY = y;
+    xSemaphoreGive(_prefetchStart);
+
+    if (_displayMode == INKPLATE_1BIT)
+        display1b(_front);
+    else
+        display3b(_front);
+
+    xSemaphoreTake(_prefetchDone, portMAX_DELAY);
+    if (!_prefetchResult)
+    {
+        if (_displayMode == INKPLATE_1BIT)
+        {
+            _spareBuffer = _partial;
+            _partial = _front;
+        }
+        else
+        {
+            _spareBuffer = D_memory4Bit;
+            D_memory4Bit = _front;
+        }
+    }
+    return _prefetchResult;
+}
+
+void Inkplate::prefetchTask(void *_p)
+{
+    Inkplate *_d = (Inkplate*)_p;
+    while (true)
+    {
+        xSemaphoreTake(_d->_prefetchStart, portMAX_DELAY);
+        if (_d->_prefetchExit) break;
+        _d->_prefetchResult = _d->prefetchImage();
+        xSemaphoreGive(_d->_prefetchDone);
+    }
+    _d->_prefetchExited = true;
+    xSemaphoreGive(_d->_prefetchDone);
+    vTaskDelete(NULL);
+}
+
+// Same as drawBitmapFromSD(), but it never changes display mode, because other core is refreshing the screen meanwhile.
+int Inkplate::prefetchImage()
+{
+    SdFile dat;
+    if (!dat.open(_prefetchName, O_RDONLY)) return 0;
+    SdRawReader r(&dat, _sdRawBuffer, &_sdClock);
+    int ret = drawBitmap(&r, _prefetchX, _prefetchY, false);
+    dat.close();
+    return ret;
+}
+
+// Init SD card with given SPI clock (in MHz). If the card doesn't work with that clock, clock is lowered until it does.
+int Inkplate::sdCardInit(uint8_t _mhz) {
+	spi2.begin(14, 12, 13, SD_CS);
+	_sdClock = _mhz;
+	sdCardOk = sd.begin(SD_CS, SD_SCK_MHZ(_sdClock));
+	while (!sdCardOk && _sdClock > SD_MIN_MHZ)
+	{
+		_sdClock = _sdClock > SD_DEFAULT_MHZ ? SD_DEFAULT_MHZ : _sdClock / 2;
+		if (_sdClock < SD_MIN_MHZ) _sdClock = SD_MIN_MHZ;
+		sdCardOk = sd.begin(SD_CS, SD_SCK_MHZ(_sdClock));
+	}
+	if (sdCardOk && _sdRawBuffer == NULL) _sdRawBuffer = (uint8_t*)heap_caps_malloc(SD_RAW_BLOCKS * 512, MALLOC_CAP_DMA);
 	return sdCardOk;
 }
 
+uint8_t Inkplate::getSdClock() {
+	return _sdClock;
+}
+
 SdFat Inkplate::getSdFat() {
 	return sd;
 }
@@ -487,56 +945,160 @@ void Inkplate::setPanelState(uint8_t state) {
 }
 
 int8_t Inkplate::readTemperature() {
-    int8_t temp;
-    if(getPanelState() == 0)
+    startTemperature();
+    while (!collectTemperature()) delay(1);
+    return _temperature;
+}
+
+// Non-blocking temperature reading: startTemperature() starts the conversion on TPS65186 and collectTemperature()
+// returns true once the result is read (call it again later if it returns false). Conversion takes about 5 ms,
+// plus 5 ms to wake up TPS65186 if panel is off. Every refresh also measures temperature while the panel is powered.
+bool Inkplate::startTemperature() {
+    if (_tempState != 0) return true;
+    if (getPanelState() == 0)
     {
+        mcpBatchBegin();
         WAKEUP_SET;
         PWRUP_SET;
-        delay(5);
+        mcpBatchCommit();
+        _tempState = 1;
+        _tempTimer = millis();
+        return true;
     }
-    Wire.beginTransmission(0x48);
-    Wire.write(0x0D);
-    Wire.write(B10000000);
-    Wire.endTransmission();
-    delay(5);
-
-    Wire.beginTransmission(0x48);
-    Wire.write(0x00);
-    Wire.endTransmission();
+    const uint8_t _convert[] = {0x0D, B10000000};
+    if (i2cWrite(0x48, _convert, 2)) return false;
+    _tempState = 2;
+    _tempTimer = millis();
+    return true;
+}
 
-    Wire.requestFrom(0x48, 1);
-    temp = Wire.read();
-    if(getPanelState() == 0)
+bool Inkplate::collectTemperature() {
+    if (_tempState == 0 || (millis() - _tempTimer) < 5) return false;
+    if (_tempState == 1)
+    {
+        const uint8_t _convert[] = {0x0D, B10000000};
+        i2cWrite(0x48, _convert, 2);
+        _tempState = 2;
+        _tempTimer = millis();
+        return false;
+    }
+    const uint8_t _reg = 0x00;
+    uint8_t _t = 0;
+    i2cWriteRead(0x48, &_reg, 1, &_t, 1);
+    _temperature = (int8_t)_t;
+    _temperatureTime = millis();
+    _tempState = 0;
+    if (getPanelState() == 0)
     {
+        mcpBatchBegin();
         PWRUP_CLEAR;
         WAKEUP_CLEAR;
-        delay(5);
+        mcpBatchCommit();
     }
-    return temp;
+    return true;
+}
+
+// Last measured temperature and time of that measurement (millis(), 0 if temperature was never measured).
+int8_t Inkplate::getTemperature() {
+    return _temperature;
+}
+
+uint32_t Inkplate::getTemperatureTime() {
+    return _temperatureTime;
 }
 
+// If battery monitor is running, filtered value from it is returned (no I2C or ADC access), otherwise battery is
+// measured right away.
 double Inkplate::readBattery() {
+  if (_batteryTask != NULL && _batteryTime != 0) return _batteryUv / 1000000.0;
+  return sampleBattery();
+}
+
+// Battery voltage is measured through 1:2 voltage divider that is connected only while pin 9 of I/O expander is high.
+// ADC is read BATTERY_SAMPLES times and converted using calibration data from eFuse (if chip has it). ADC is read
+// through Arduino core, so only attenuation of battery pin is set here, ADC width stays as core sets it (12 bits, unless
+// sketch changes it with analogSetWidth()).
+double Inkplate::sampleBattery() {
+  if (!_adcReady)
+  {
+    analogSetPinAttenuation(BATTERY_ADC_PIN, ADC_11db);
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &_adcChars);
+    _adcReady = 1;
+  }
   digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, 9, HIGH);
   delay(1);
-  int adc = analogRead(35);
+  uint32_t _sum = 0;
+  for (int i = 0; i < BATTERY_SAMPLES; i++)
+  {
+    _sum += analogRead(BATTERY_ADC_PIN);
+  }
   digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, 9, LOW);
-  //Calculate the voltage using the following formula
-  //1.1V is internal ADC reference of ESP32, 3.548133892 is 11dB in linear scale (Analog signal is attenuated by 11dB before ESP32 ADC input)
-  return (double(adc) / 4095 * 1.1 * 3.548133892 * 2);
+  uint32_t _mv = esp_adc_cal_raw_to_voltage((_sum + BATTERY_SAMPLES / 2) / BATTERY_SAMPLES, &_adcChars);
+  return _mv * 2 / 1000.0;
+}
+
+// Starts a task that measures battery every _period ms and keeps exponentially filtered result, so readBattery()
+// only returns that value.
+bool Inkplate::batteryMonitorBegin(uint32_t _period) {
+  if (_batteryTask != NULL) return true;
+  _batteryPeriod = _period ? _period : BATTERY_PERIOD_MS;
+  _batteryTime = 0;
+  return xTaskCreatePinnedToCore(batteryTask, "battery", 3072, this, 1, &_batteryTask, tskNO_AFFINITY) == pdPASS;
+}
+
+void Inkplate::batteryMonitorEnd() {
+  if (_batteryTask == NULL) return;
+  _batteryStop = 1;
+  xTaskNotifyGive(_batteryTask);
+  while (_batteryTask != NULL) delay(1);
+  _batteryStop = 0;
+}
+
+// Time (millis()) of the last battery measurement made by battery monitor, 0 if there is none yet.
+uint32_t Inkplate::getBatteryTime() {
+  return _batteryTime;
+}
+
+void Inkplate::batteryTask(void *_p) {
+  Inkplate *_d = (Inkplate *)_p;
+  double _filtered = 0;
+  while (!_d->_batteryStop)
+  {
+    double _v = _d->sampleBattery();
+    _filtered = _d->_batteryTime == 0 ? _v : _filtered + (_v - _filtered) * BATTERY_FILTER;
+    _d->_batteryUv = _filtered * 1000000 + 0.5;
+    _d->_batteryTime = millis();
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(_d->_batteryPeriod));
+  }
+  _d->_batteryTask = NULL;
+  vTaskDelete(NULL);
 }
 
 //--------------------------LOW LEVEL STUFF--------------------------------------------
 void Inkplate::vscan_start()
 {
-  CKV_SET;
-  delayMicroseconds(7);
-  SPV_CLEAR;
+  unsigned long _t = micros();
+  // I2C bus is held only during the start sequence (SPV writes must not wait for other transactions), rows are written
+  // without I2C, so the bus is free for other tasks for the rest of the frame.
+  if (!_frameLock)
+  {
+    i2cLock(I2C_PRIO_HIGH);
+    _frameLock = 1;
+  }
+  // If start pulse (SPV low) is already set in the gap after the previous frame, first CKV pulse is already done too.
+  if (!_spvStaged)
+  {
+    CKV_SET;
+    delayMicroseconds(7);
+    spvWrite(LOW);
+  }
+  _spvStaged = 0;
   delayMicroseconds(10);
   CKV_CLEAR;
   delayMicroseconds(0); //usleep1();
   CKV_SET;
   delayMicroseconds(8);
-  SPV_SET;
+  spvWrite(HIGH);
   delayMicroseconds(10);
   CKV_CLEAR;
   delayMicroseconds(0); //usleep1();
@@ -550,6 +1112,74 @@ void Inkplate::vscan_start()
   delayMicroseconds(0); //usleep1();
   CKV_SET;
   //delayMicroseconds(18);
+  _frameLock = 0;
+  i2cUnlock();
+  _frameStartTime += micros() - _t;
+  _frameStarts++;
+}
+
+// Gap between two frames, I2C bus is free for other tasks during it. With staging on, beginning of the next
+// vscan_start (first CKV pulse and SPV low) is done at the end of the gap, so I2C write to I/O expander is hidden inside
+// the delay that is needed anyway. CKV and SPV keep their levels from the end of the frame until then.
+void Inkplate::vscan_gap(uint16_t _us)
+{
+  uint8_t _phase = statsPhase(REFRESH_PHASE_GAP);
+  if (_statsOn) _stats.frames++;
+  if (_energyOn) _energyStats.frames++;
+  unsigned long _t = micros();
+  if (_frameLock)
+  {
+    _frameLock = 0;
+    i2cUnlock();
+  }
+  if (_spvStage)
+  {
+    // Frame start lead (7 us and SPV write) takes the last part of the gap, its length is known from the previous frame.
+    long _left = (long)_us - (long)_spvLead - (long)(micros() - _t);
+    if (_left > 0) delayMicroseconds(_left);
+    i2cLock(I2C_PRIO_HIGH);
+    _frameLock = 1;
+    _t = micros();
+    CKV_SET;
+    delayMicroseconds(7);
+    spvWrite(LOW);
+    _spvLead = micros() - _t;
+    _spvStaged = 1;
+  }
+  else
+  {
+    long _left = (long)_us - (long)(micros() - _t);
+    if (_left > 0) delayMicroseconds(_left);
+  }
+  statsPhase(_phase);
+}
+
+// Moves the first CKV pulse and SPV low write of the frame start into the end of the gap between frames (see
+// VSCAN_STAGE_SPV). Takes effect from the next refresh.
+void Inkplate::setFrameStartStaging(bool _on)
+{
+  _spvStage = _on;
+}
+
+bool Inkplate::getFrameStartStaging()
+{
+  return _spvStage;
+}
+
+// SPV is written straight into GPIOA of I/O expander (no pin mode checks, single I2C write).
+void Inkplate::spvWrite(uint8_t _state)
+{
+  uint8_t _d = _state ? (mcpRegsInt[MCP23017_GPIOA] | (1 << SPV)) : (mcpRegsInt[MCP23017_GPIOA] & ~(1 << SPV));
+  const uint8_t _b[] = {MCP23017_GPIOA, _d};
+  i2cWrite(MCP23017_INT_ADDR, _b, 2, I2C_PRIO_HIGH);
+  mcpRegsInt[MCP23017_GPIOA] = _d;
+  _mcpSentInt[MCP23017_GPIOA] = _d;
+}
+
+// Average time (in microseconds) of the frame start sequence (vscan_start) since the panel was last turned on.
+uint32_t Inkplate::getFrameStartTime()
+{
+  return _frameStarts ? _frameStartTime / _frameStarts : 0;
 }
 
 void Inkplate::vscan_write()
@@ -567,6 +1197,7 @@ void Inkplate::vscan_write()
 
 void Inkplate::hscan_start(uint32_t _d)
 {
+  if (_statsOn) _stats.loadedRows++;
   SPH_CLEAR;
   GPIO.out_w1ts = (_d) | CL;
   GPIO.out_w1tc = DATA | CL;
@@ -575,6 +1206,7 @@ void Inkplate::hscan_start(uint32_t _d)
 }
 
 void Inkplate::vscan_end() {
+  if (_statsOn) _stats.rows++;
   CKV_CLEAR;
   LE_SET;
   LE_CLEAR;
@@ -582,8 +1214,18 @@ void Inkplate::vscan_end() {
   //CKV_SET;
 }
 
+// Moves gate driver to the next row without shifting new data into source driver (row gets the same data as previous one).
+void Inkplate::skipRow() {
+  CKV_SET;
+  delayMicroseconds(1);
+  vscan_end();
+}
+
 //Clears content from epaper diplay as fast as ESP32 can.
 void Inkplate::cleanFast(uint8_t c, uint8_t rep) {
+  uint8_t _phase = statsPhase(REFRESH_PHASE_CLEAN);
+  if (_energyOn && c < 2) _energyStats.drivenPixels += (uint64_t)rep * E_INK_WIDTH * E_INK_HEIGHT;
+  if (c < 2) _rowSumValid = _fullSumValid = false;
   einkOn();
   uint8_t data;
   if (c == 0) {
@@ -613,8 +1255,9 @@ void Inkplate::cleanFast(uint8_t c, uint8_t rep) {
       GPIO.out_w1tc = DATA | CL;
       vscan_end();
     }
-    delayMicroseconds(230);
+    vscan_gap(230);
   }
+  statsPhase(_phase);
 }
 
 void Inkplate::pinsZstate() {
@@ -661,16 +1304,25 @@ void Inkplate::pinsAsOutputs() {
 
 //--------------------------PRIVATE FUNCTIONS--------------------------------------------
 //Display content from RAM to display (1 bit per pixel,. monochrome picture).
-void Inkplate::display1b()
+//If _fb is set, that buffer is shown instead of _partial (used when next image is decoded into _partial in the meantime).
+void Inkplate::display1b(uint8_t *_fb)
 {
+    if (_fb == NULL) _fb = _partial;
+    if (rowSumUpdate(_fb, E_INK_WIDTH / 8, 0, E_INK_HEIGHT - 1) == 0 && _skipUnchanged && _fullSumValid)
+    {
+        _refreshesSkipped++;
+        return;
+    }
+    statsRefreshBegin(0);
     for(int i = 0; i<(E_INK_HEIGHT * E_INK_WIDTH) / 8; i++) {
-        *(D_memory_new+i) &= *(_partial+i);
-        *(D_memory_new+i) |= (*(_partial+i));
+        *(D_memory_new+i) &= *(_fb+i);
+        *(D_memory_new+i) |= (*(_fb+i));
     }
+    if (_energyOn) _energyStats.drivenPixels += energyPixels(0, D_memory_new, 0, E_INK_HEIGHT - 1);
     uint32_t _pos;
     uint8_t data;
     uint8_t dram;
-    einkOn();
+    panelBegin();
     /*
     cleanFast(0, 1);
     cleanFast(1, 15);
@@ -687,6 +1339,7 @@ void Inkplate::display1b()
     cleanFast(0, 5);
     cleanFast(2, 1);
     cleanFast(1, 15);
+    statsPhase(REFRESH_PHASE_DATA);
     for (int k = 0; k < 4; k++) {
         _pos = (E_INK_HEIGHT * E_INK_WIDTH / 8) - 1;
         vscan_start();
@@ -712,7 +1365,7 @@ void Inkplate::display1b()
         GPIO.out_w1tc = DATA | CL;
         vscan_end();
         }
-        delayMicroseconds(230);
+        vscan_gap(230);
     }
   
 	_pos = (E_INK_HEIGHT * E_INK_WIDTH / 8) - 1;
@@ -739,26 +1392,37 @@ void Inkplate::display1b()
       GPIO.out_w1tc = DATA | CL;
 	  vscan_end();
     }
-    delayMicroseconds(230);
+    vscan_gap(230);
   cleanFast(2, 2);
   cleanFast(3, 1);
   vscan_start();
-  einkOff();
+  panelEnd();
   _blockPartial = 0;
+  _rowSumValid = _fullSumValid = true;
+  statsRefreshEnd();
 }
 
 //Display content from RAM to display (3 bit per pixel,. 8 level of grayscale, STILL IN PROGRESSS, we need correct wavefrom to get good picture, use it only for pictures not for GFX).
-void Inkplate::display3b() {
-  einkOn();
+void Inkplate::display3b(uint8_t *_fb) {
+  if (_fb == NULL) _fb = D_memory4Bit;
+  if (rowSumUpdate(_fb, E_INK_WIDTH / 2, 0, E_INK_HEIGHT - 1) == 0 && _skipUnchanged && _fullSumValid)
+  {
+      _refreshesSkipped++;
+      return;
+  }
+  statsRefreshBegin(1);
+  if (_energyOn) _energyStats.drivenPixels += energyPixels(1, _fb, 0, E_INK_HEIGHT - 1);
+  panelBegin();
   cleanFast(0, 1);
   cleanFast(1, 15);
   cleanFast(2, 1);
   cleanFast(0, 5);
   cleanFast(2, 1);
   cleanFast(1, 15);
+  statsPhase(REFRESH_PHASE_DATA);
   
   for (int k = 0; k < 9; k++) {
-      uint8_t *dp = D_memory4Bit + (E_INK_HEIGHT * E_INK_WIDTH/2);
+      uint8_t *dp = _fb + (E_INK_HEIGHT * E_INK_WIDTH/2);
       uint32_t _send;
       uint8_t pix1;
       uint8_t pix2;
@@ -784,11 +1448,13 @@ void Inkplate::display3b() {
         GPIO.out_w1tc = DATA | CL;
 	    vscan_end();
       }
-      delayMicroseconds(230);
+      vscan_gap(230);
   }
   cleanFast(3, 1);
   vscan_start();
-  einkOff();
+  panelEnd();
+  _rowSumValid = _fullSumValid = true;
+  statsRefreshEnd();
 }
 
 uint32_t Inkplate::read32(uint8_t* c) {
@@ -799,10 +1465,11 @@ uint16_t Inkplate::read16(uint8_t* c) {
   return (*(c) | (*(c + 1) << 8));
 }
 
-void Inkplate::readBmpHeader(SdFile *_f, struct bitmapHeader *_h) {
-  uint8_t header[100];
-  _f->rewind();
-  _f->read(header, 100);
+// Reads only BITMAPFILEHEADER and BITMAPINFOHEADER, so it works with sources that can't go back.
+bool Inkplate::readBmpHeader(ImageSource *_s, struct bitmapHeader *_h) {
+  uint8_t header[54];
+  _s->seek(0);
+  if (_s->read(header, 54) != 54) return false;
   _h->signature = read16(header + 0);
   _h->fileSize = read32(header + 2);
   _h->startRAW = read32(header + 10);
@@ -811,40 +1478,63 @@ void Inkplate::readBmpHeader(SdFile *_f, struct bitmapHeader *_h) {
   _h->height = read32(header + 22);
   _h->color = read16(header + 28);
   _h->compression = read32(header + 30);
-  return;
+  return true;
 }
 
-int Inkplate::drawMonochromeBitmap(SdFile *f, struct bitmapHeader bmpHeader, int x, int y) {
-  int w = bmpHeader.width;
-  int h = bmpHeader.height;
+//If _changeMode is false, bitmap is drawn only if it has the same color depth as current display mode.
+int Inkplate::drawBitmap(ImageSource *_s, int x, int y, bool _changeMode) {
+	struct bitmapHeader bmpHeader;
+	if (!readBmpHeader(_s, &bmpHeader)) return 0;
+	if (bmpHeader.signature != 0x4D42 || bmpHeader.compression != 0 || !(bmpHeader.color == 1 || bmpHeader.color == 24)) return 0;
+
+	if (!_changeMode && (bmpHeader.color == 1) != (getDisplayMode() == INKPLATE_1BIT)) return 0;
+
+	if ((bmpHeader.color == 24 || bmpHeader.color == 32) && getDisplayMode() != INKPLATE_3BIT) {
+		selectDisplayMode(INKPLATE_3BIT);
+	}
+
+	if (bmpHeader.color == 1 && getDisplayMode() != INKPLATE_1BIT) {
+		selectDisplayMode(INKPLATE_1BIT);
+	}
+
+	if (bmpHeader.color == 1) return drawMonochromeBitmap(_s, bmpHeader, x, y);
+	return drawGrayscaleBitmap24(_s, bmpHeader, x, y);
+}
+
+int Inkplate::drawMonochromeBitmap(ImageSource *s, struct bitmapHeader bmpHeader, int x, int y) {
+  int w = bmpHeader.width;
+  int h = bmpHeader.height;
   uint8_t paddingBits = w % 32;
+  uint8_t b[4];
   w /= 32;
 
-  f->seekSet(bmpHeader.startRAW);
+  if (!s->skipTo(bmpHeader.startRAW)) return 0;
   int i, j;
   for (j = 0; j < h; j++) {
     for (i = 0; i < w; i++) {
-      uint32_t pixelRow = f->read() << 24 | f->read() << 16 | f->read() << 8 | f->read();
+      if (s->read(b, 4) != 4) return 0;
+      uint32_t pixelRow = b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
       for (int n = 0; n < 32; n++) {
         drawPixel((i * 32) + n + x, h - j + y, !(pixelRow & (1ULL << (31 - n))));
       }
     }
     if (paddingBits) {
-      uint32_t pixelRow = f->read() << 24 | f->read() << 16 | f->read() << 8 | f->read();
+      if (s->read(b, 4) != 4) return 0;
+      uint32_t pixelRow = b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
       for (int n = 0; n < paddingBits; n++) {
         drawPixel((i * 32) + n + x, h - j + y, !(pixelRow & (1ULL << (31 - n))));
       }
     }
   }
-  f->close();
   return 1;
 }
 
-int Inkplate::drawGrayscaleBitmap24(SdFile *f, struct bitmapHeader bmpHeader, int x, int y) {
+int Inkplate::drawGrayscaleBitmap24(ImageSource *s, struct bitmapHeader bmpHeader, int x, int y) {
   int w = bmpHeader.width;
   int h = bmpHeader.height;
   char padding = w % 4;
-  f->seekSet(bmpHeader.startRAW);
+  uint8_t b[3];
+  if (!s->skipTo(bmpHeader.startRAW)) return 0;
   int i, j;
   for (j = 0; j < h; j++) {
     for (i = 0; i < w; i++) {
@@ -854,25 +1544,262 @@ int Inkplate::drawGrayscaleBitmap24(SdFile *f, struct bitmapHeader bmpHeader, in
       //display.drawPixel(i + x, h - j + y, (uint8_t)(px*7));
 
       //So then, we are convertng it to grayscale using good old average and gamma correction (from LUT). With this metod, it is still slow (full size image takes 4 seconds), but much beter than prev mentioned method.
-      uint8_t px = (f->read() * 2126 / 10000) + (f->read() * 7152 / 10000) + (f->read() * 722 / 10000);
+      if (s->read(b, 3) != 3) return 0;
+      uint8_t px = (b[0] * 2126 / 10000) + (b[1] * 7152 / 10000) + (b[2] * 722 / 10000);
 	  drawPixel(i + x, h - j + y, px>>5);
 	  //drawPixel(i + x, h - j + y, px/32);
     }
     if (padding) {
-      for (int p = 0; p < padding; p++) {
-        f->read();
-      }
+      if (s->read(b, padding) != padding) return 0;
     }
   }
-  f->close();
   return 1;
 }
 
+//----------------------------Image sources----------------------------
+bool ImageSource::skipTo(uint32_t _p) {
+  uint8_t _trash[32];
+  if (_p == position()) return true;
+  if (seek(_p)) return true;
+  if (_p < position()) return false;
+  while (position() < _p) {
+    uint32_t _n = _p - position();
+    if (_n > sizeof(_trash)) _n = sizeof(_trash);
+    if (read(_trash, _n) <= 0) return false;
+  }
+  return true;
+}
+
+StreamSource::StreamSource(Stream &_s) {
+  _stream = &_s;
+}
+
+int StreamSource::read(uint8_t *_b, uint32_t _n) {
+  int _k = _stream->readBytes(_b, _n);
+  _pos += _k;
+  return _k;
+}
+
+uint32_t StreamSource::position() {
+  return _pos;
+}
+
+MemorySource::MemorySource(const uint8_t *_p, uint32_t _s) {
+  _data = _p;
+  _size = _s;
+}
+
+int MemorySource::read(uint8_t *_b, uint32_t _n) {
+  if (_n > _size - _pos) _n = _size - _pos;
+  memcpy(_b, _data + _pos, _n);
+  _pos += _n;
+  return _n;
+}
+
+int MemorySource::read() {
+  return _pos < _size ? _data[_pos++] : -1;
+}
+
+bool MemorySource::seek(uint32_t _p) {
+  if (_p > _size) return false;
+  _pos = _p;
+  return true;
+}
+
+uint32_t MemorySource::position() {
+  return _pos;
+}
+
+//----------------------------SD card raw reader----------------------------
+SdRawReader::SdRawReader(SdFile *_f, uint8_t *_b, uint8_t *_m) {
+  _file = _f;
+  _mhz = _m;
+  _size = _f->fileSize();
+  // If big DMA capable buffer couldn't be allocated, one block buffer on the stack is used.
+  _buf = _b != NULL ? _b : _local;
+  _maxBlocks = _b != NULL ? SD_RAW_BLOCKS : 1;
+  _contiguous = _f->contiguousRange(&_bgnBlock, &_endBlock);
+}
+
+uint32_t SdRawReader::position() {
+  return _pos;
+}
+
+bool SdRawReader::seek(uint32_t _p) {
+  if (_p > _size) return false;
+  if (_p < _bufPos || _p >= _bufPos + _bufLen) {
+    _bufPos = _p;
+    _bufLen = 0;
+  }
+  _pos = _p;
+  return true;
+}
+
+int SdRawReader::read(uint8_t *_b, uint32_t _n) {
+  uint32_t _done = 0;
+  while (_done < _n) {
+    if (_pos >= _bufPos + _bufLen && !fill()) break;
+    uint32_t _k = (_bufPos + _bufLen) - _pos;
+    if (_k > _n - _done) _k = _n - _done;
+    memcpy(_b + _done, _buf + (_pos - _bufPos), _k);
+    _pos += _k;
+    _done += _k;
+  }
+  return _done;
+}
+
+// Loads up to SD_RAW_BLOCKS blocks starting at block that holds current position.
+bool SdRawReader::fill() {
+  if (_pos >= _size) return false;
+  _bufPos = _pos & ~511UL;
+  uint32_t _blocks = ((_size - _bufPos) + 511) / 512;
+  if (_blocks > _maxBlocks) _blocks = _maxBlocks;
+  Inkplate::traceWrite(TRACE_SD, 'B', _blocks);
+
+  if (_contiguous) {
+    uint32_t _block = _bgnBlock + (_bufPos / 512);
+    if (_block + _blocks - 1 > _endBlock) _blocks = _endBlock - _block + 1;
+    // If reading fails (CRC error is reported only if USE_SD_CRC is enabled in SdFatConfig.h), lower SPI clock and retry.
+    // Card is initialized again for new clock, if that fails even at SD_MIN_MHZ, read error is reported.
+    while (!sd.card()->readBlocks(_block, _buf, _blocks)) {
+      if (*_mhz <= SD_MIN_MHZ) {
+        _contiguous = false;
+        break;
+      }
+      *_mhz = *_mhz > SD_DEFAULT_MHZ ? SD_DEFAULT_MHZ : *_mhz / 2;
+      if (*_mhz < SD_MIN_MHZ) *_mhz = SD_MIN_MHZ;
+      _reinit = true;
+      if (!sd.cardBegin(SD_CS, SD_SCK_MHZ(*_mhz)) && *_mhz <= SD_MIN_MHZ) {
+        Inkplate::traceWrite(TRACE_SD, 'E', 0);
+        return false;
+      }
+    }
+    if (_contiguous) {
+      _bufLen = _blocks * 512;
+      if (_bufPos + _bufLen > _size) _bufLen = _size - _bufPos;
+      Inkplate::traceWrite(TRACE_SD, 'E', _blocks);
+      return true;
+    }
+  }
+
+  // File is fragmented (or raw read failed), so read it through FAT layer, but still in big chunks. After the card was
+  // initialized again, file position is set from the start of the file (not from cached cluster) and checked.
+  _bufLen = 0;
+  if (_reinit) {
+    _file->rewind();
+    _reinit = false;
+  }
+  bool _at = _file->seekSet(_bufPos) && _file->curPosition() == _bufPos;
+  int _n = _at ? _file->read(_buf, _blocks * 512) : -1;
+  Inkplate::traceWrite(TRACE_SD, 'E', _blocks);
+  if (_n <= 0) return false;
+  _bufLen = _n;
+  return _pos < _bufPos + _bufLen;
+}
+
+// ---------------------I2C bus functions----------------------------
+// All I2C devices on the board (I/O expanders, TPS65186, touchscreen, backlight) share one bus, so every transaction
+// goes through these functions. Bus can be locked for longer sequences (locks are recursive). High priority task (panel
+// refresh) holds the gate while it waits for the bus, so normal priority ones that come meanwhile block on the gate and
+// get the bus only after it.
+bool Inkplate::i2cLock(uint8_t _prio, uint32_t _timeout)
+{
+    if (_i2cMutex == NULL) return true;
+    if (xSemaphoreGetMutexHolder(_i2cMutex) == xTaskGetCurrentTaskHandle())
+        return xSemaphoreTakeRecursive(_i2cMutex, 0) == pdTRUE;
+    if (xSemaphoreTake(_i2cGate, _timeout) != pdTRUE) return false;
+    if (_prio != I2C_PRIO_HIGH) xSemaphoreGive(_i2cGate);
+    bool _ok = xSemaphoreTakeRecursive(_i2cMutex, _timeout) == pdTRUE;
+    if (_prio == I2C_PRIO_HIGH) xSemaphoreGive(_i2cGate);
+    return _ok;
+}
+
+void Inkplate::i2cUnlock()
+{
+    if (_i2cMutex != NULL) xSemaphoreGiveRecursive(_i2cMutex);
+}
+
+// Returns 0 on success or Wire error code (4 if bus can't be locked or not all bytes are received).
+uint8_t Inkplate::i2cWrite(uint8_t _addr, const uint8_t *_d, uint8_t _n, uint8_t _prio)
+{
+    if (!i2cLock(_prio)) return 4;
+    traceWrite(TRACE_I2C, 'B', _addr);
+    i2cSelectClock(_addr);
+    Wire.beginTransmission(_addr);
+    if (_n) Wire.write(_d, _n);
+    uint8_t _err = Wire.endTransmission();
+    _i2cTransactions++;
+    traceWrite(TRACE_I2C, 'E', _addr);
+    i2cUnlock();
+    return _err;
+}
+
+uint8_t Inkplate::i2cRead(uint8_t _addr, uint8_t *_d, uint8_t _n, uint8_t _prio)
+{
+    if (!i2cLock(_prio)) return 4;
+    traceWrite(TRACE_I2C, 'B', _addr);
+    i2cSelectClock(_addr);
+    uint8_t _got = Wire.requestFrom(_addr, _n);
+    for (int i = 0; i < _got; i++)
+    {
+        _d[i] = Wire.read();
+    }
+    _i2cTransactions++;
+    traceWrite(TRACE_I2C, 'E', _addr);
+    i2cUnlock();
+    return _got == _n ? 0 : 4;
+}
+
+// Write (usually register address) followed by read, bus is not released between them.
+uint8_t Inkplate::i2cWriteRead(uint8_t _addr, const uint8_t *_w, uint8_t _wn, uint8_t *_r, uint8_t _rn, uint8_t _prio)
+{
+    if (!i2cLock(_prio)) return 4;
+    uint8_t _err = i2cWrite(_addr, _w, _wn, _prio);
+    if (_err == 0) _err = i2cRead(_addr, _r, _rn, _prio);
+    i2cUnlock();
+    return _err;
+}
+
+void Inkplate::i2cSetClock(uint8_t _addr, uint32_t _clock)
+{
+    for (int i = 0; i < _i2cDevices; i++)
+    {
+        if (_i2cDevAddr[i] == _addr)
+        {
+            _i2cDevClock[i] = _clock;
+            return;
+        }
+    }
+    if (_i2cDevices >= I2C_MAX_DEVICES) return;
+    _i2cDevAddr[_i2cDevices] = _addr;
+    _i2cDevClock[_i2cDevices++] = _clock;
+}
+
+uint32_t Inkplate::i2cGetClock(uint8_t _addr)
+{
+    for (int i = 0; i < _i2cDevices; i++)
+    {
+        if (_i2cDevAddr[i] == _addr) return _i2cDevClock[i];
+    }
+    return I2C_BUS_CLOCK;
+}
+
+uint32_t Inkplate::i2cGetTransactions()
+{
+    return _i2cTransactions;
+}
+
+void Inkplate::i2cSelectClock(uint8_t _addr)
+{
+    uint32_t _c = i2cGetClock(_addr);
+    if (_c == _i2cClock) return;
+    Wire.setClock(_c);
+    _i2cClock = _c;
+}
 
 //----------------------------MCP23017 functions----------------------------
 bool Inkplate::mcpBegin(uint8_t _addr, uint8_t* _r) {
-  Wire.beginTransmission(_addr);
-  int error = Wire.endTransmission();
+  int error = i2cWrite(_addr, NULL, 0);
   if (error) return false;
   readMCPRegisters(_addr, _r);
   _r[0] = 0xff;
@@ -882,63 +1809,119 @@ bool Inkplate::mcpBegin(uint8_t _addr, uint8_t* _r) {
 }
 
 void Inkplate::readMCPRegisters(uint8_t _addr, uint8_t *k) {
-  Wire.beginTransmission(_addr);
-  Wire.write(0x00);
-  Wire.endTransmission();
-  Wire.requestFrom(_addr, (uint8_t)22);
-  for (int i = 0; i < 22; i++) {
-    k[i] = Wire.read();
-  }
+  readMCPRegisters(_addr, 0x00, k, 22);
 }
 
 void Inkplate::readMCPRegisters(uint8_t _addr, uint8_t _regName, uint8_t *k, uint8_t _n) {
-  Wire.beginTransmission(_addr);
-  Wire.write(_regName);
-  Wire.endTransmission();
-
-  Wire.requestFrom(_addr, _n);
-  for (int i = 0; i < _n; i++) {
-    k[_regName + i] = Wire.read();
-  }
+  i2cWriteRead(_addr, &_regName, 1, k + _regName, _n);
 }
 
 void Inkplate::readMCPRegister(uint8_t _addr, uint8_t _regName, uint8_t *k) {
-  Wire.beginTransmission(_addr);
-  Wire.write(_regName);
-  Wire.endTransmission();
-  Wire.requestFrom(_addr, (uint8_t)1);
-  k[_regName] = Wire.read();
+  i2cWriteRead(_addr, &_regName, 1, k + _regName, 1);
 }
 
 void Inkplate::updateAllRegisters(uint8_t _addr, uint8_t *k) {
-  Wire.beginTransmission(_addr);
-  Wire.write(0x00);
-  for (int i = 0; i < 22; i++) {
-    Wire.write(k[i]);
+  if (_mcpBatch) {
+    mcpMarkDirty(_addr, 0, 22);
+    return;
   }
-  Wire.endTransmission();
+  updateRegister(_addr, 0x00, k, 22);
 }
 
 void Inkplate::updateRegister(uint8_t _addr, uint8_t _regName, uint8_t _d) {
-  Wire.beginTransmission(_addr);
-  Wire.write(_regName);
-  Wire.write(_d);
-  Wire.endTransmission();
+  if (_mcpBatch) {
+    (_addr == MCP23017_INT_ADDR ? mcpRegsInt : mcpRegsEx)[_regName] = _d;
+    mcpMarkDirty(_addr, _regName, 1);
+    return;
+  }
+  const uint8_t _b[] = {_regName, _d};
+  i2cWrite(_addr, _b, 2);
+  (_addr == MCP23017_INT_ADDR ? _mcpSentInt : _mcpSentEx)[_regName] = _d;
 }
 
 void Inkplate::updateRegister(uint8_t _addr, uint8_t _regName, uint8_t *k, uint8_t _n) {
-  Wire.beginTransmission(_addr);
-  Wire.write(_regName);
-  for (int i = 0; i < _n; i++) {
-    Wire.write(k[_regName + i]);
+  if (_mcpBatch) {
+    mcpMarkDirty(_addr, _regName, _n);
+    return;
+  }
+  uint8_t _b[23];
+  _b[0] = _regName;
+  memcpy(_b + 1, k + _regName, _n);
+  i2cWrite(_addr, _b, _n + 1);
+  memcpy((_addr == MCP23017_INT_ADDR ? _mcpSentInt : _mcpSentEx) + _regName, k + _regName, _n);
+}
+
+void Inkplate::mcpMarkDirty(uint8_t _addr, uint8_t _regName, uint8_t _n) {
+  uint32_t _m = ((1UL << _n) - 1) << _regName;
+  if (_addr == MCP23017_INT_ADDR)
+    _mcpDirtyInt |= _m;
+  else
+    _mcpDirtyEx |= _m;
+}
+
+// Batch mode: while in batch mode, pinMode/digitalWrite/... functions of I/O expanders only change shadow copies of
+// registers. On commit, only registers that really changed are sent, using sequential writes. Batches can be nested,
+// registers are sent when the outermost batch is commited. I2C bus is locked for the whole batch, so other tasks can't
+// change shadow registers in the meantime.
+void Inkplate::mcpBatchBegin() {
+  i2cLock();
+  _mcpBatch++;
+}
+
+void Inkplate::mcpBatchCommit() {
+  if (_mcpBatch == 0) return;
+  if (--_mcpBatch == 0) {
+    mcpFlush(MCP23017_INT_ADDR, mcpRegsInt, _mcpSentInt, &_mcpDirtyInt);
+    mcpFlush(MCP23017_EXT_ADDR, mcpRegsEx, _mcpSentEx, &_mcpDirtyEx);
+  }
+  i2cUnlock();
+}
+
+// Two changed registers that have at most MCP23017_MAX_GAP unchanged registers between them are sent in one sequential
+// write (unchanged ones are sent again with the same value). OLAT registers are never updated in shadow copy
+// (outputs are set through GPIO registers), so they can't be used as a gap.
+#define MCP23017_MAX_GAP    2
+#define MCP23017_GAP_SAFE   (0x3FFFFFUL & ~((1UL << MCP23017_OLATA) | (1UL << MCP23017_OLATB)))
+
+void Inkplate::mcpFlush(uint8_t _addr, uint8_t* _r, uint8_t* _sent, uint32_t* _dirty) {
+  uint32_t _d = 0;
+  for (int i = 0; i < 22; i++) {
+    if ((*_dirty & (1UL << i)) && _r[i] != _sent[i]) _d |= 1UL << i;
+  }
+  *_dirty = 0;
+
+  int i = 0;
+  while (_d >> i) {
+    if (!(_d & (1UL << i))) {
+      i++;
+      continue;
+    }
+    int _last = i;
+    int _next = _last + 1;
+    while (_next < 22) {
+      while (_next < 22 && !(_d & (1UL << _next))) _next++;
+      if (_next >= 22 || (_next - _last - 1) > MCP23017_MAX_GAP) break;
+      uint32_t _gap = ((1UL << (_next - _last - 1)) - 1) << (_last + 1);
+      if ((_gap & MCP23017_GAP_SAFE) != _gap) break;
+      _last = _next++;
+    }
+    uint8_t _b[23];
+    _b[0] = i;
+    for (int j = i; j <= _last; j++) {
+      _b[j - i + 1] = _r[j];
+      _sent[j] = _r[j];
+    }
+    i2cWrite(_addr, _b, _last - i + 2);
+    i = _last + 1;
   }
-  Wire.endTransmission();
 }
 
 void Inkplate::pinModeInternal(uint8_t _addr, uint8_t* _r, uint8_t _pin, uint8_t _mode) {
   uint8_t _port = (_pin / 8) & 1;
   uint8_t _p = _pin % 8;
 
+  // Bus is locked while shadow registers are changed, so two tasks can't overwrite each other's changes.
+  i2cLock();
   switch (_mode) {
     case INPUT:
       _r[MCP23017_IODIRA + _port] |= 1 << _p;   //Set it to input
@@ -961,6 +1944,7 @@ void Inkplate::pinModeInternal(uint8_t _addr, uint8_t* _r, uint8_t _pin, uint8_t
       updateRegister(_addr, MCP23017_GPPUA + _port, _r[MCP23017_GPPUA + _port]);
       break;
   }
+  i2cUnlock();
 }
 
 void Inkplate::digitalWriteInternal(uint8_t _addr, uint8_t* _r, uint8_t _pin, uint8_t _state) {
@@ -968,8 +1952,10 @@ void Inkplate::digitalWriteInternal(uint8_t _addr, uint8_t* _r, uint8_t _pin, ui
   uint8_t _p = _pin % 8;
 
   if (_r[MCP23017_IODIRA + _port] & (1 << _p)) return; //Check if the pin is set as an output
+  i2cLock();
   _state ? (_r[MCP23017_GPIOA + _port] |= (1 << _p)) : (_r[MCP23017_GPIOA + _port] &= ~(1 << _p));
   updateRegister(_addr, MCP23017_GPIOA + _port, _r[MCP23017_GPIOA + _port]);
+  i2cUnlock();
 }
 
 uint8_t Inkplate::digitalReadInternal(uint8_t _addr, uint8_t* _r, uint8_t _pin) {
@@ -1083,18 +2069,667 @@ uint16_t Inkplate::getPorts() {
 }
 
 
+// ---------------------Refresh statistics functions----------------------------
+// Statistics are collected only while enabled, otherwise every instrumented place costs one flag check.
+void Inkplate::setRefreshStats(bool _on)
+{
+    if (!_on) statsPhase(REFRESH_PHASE_IDLE);
+    _statsOn = _on;
+}
+
+bool Inkplate::getRefreshStatsEnabled()
+{
+    return _statsOn;
+}
+
+void Inkplate::resetRefreshStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+refreshStats Inkplate::getRefreshStats()
+{
+    return _stats;
+}
+
+// Prints totals and time of each phase (milliseconds and share of all refresh time).
+void Inkplate::printRefreshStats(Print &_p)
+{
+    static const char *_names[REFRESH_PHASES] = {"other", "prepare", "power on", "clean", "data", "gap", "power off"};
+    refreshStats _s = _stats;
+    uint64_t _total = 0;
+    for (int i = 0; i < REFRESH_PHASES; i++) _total += _s.cycles[i];
+    uint32_t _mhz = ESP.getCpuFreqMHz();
+    _p.printf("Refreshes: %u, frames: %u, rows: %u (%u loaded), I2C transactions: %u, last refresh: %u ms\r\n",
+              (unsigned)_s.refreshes, (unsigned)_s.frames, (unsigned)_s.rows, (unsigned)_s.loadedRows,
+              (unsigned)_s.i2cTransactions, (unsigned)(_s.lastCycles / _mhz / 1000));
+    for (int i = 0; i < REFRESH_PHASES; i++)
+    {
+        _p.printf("  %-10s %10.1f ms %5.1f %%\r\n", _names[i], _s.cycles[i] / (double)_mhz / 1000.0,
+                  _total ? _s.cycles[i] * 100.0 / _total : 0.0);
+    }
+}
+
+// Switches statistics to phase _p. Time since the last switch goes to the phase that ran until now. Returns that phase,
+// so the caller can switch back to it. Leaving and entering REFRESH_PHASE_IDLE counts I2C transactions in between.
+// Phase changes are also traced as end and begin events.
+uint8_t Inkplate::statsPhase(uint8_t _p)
+{
+    if (!_statsOn && _traceBuf == NULL) return REFRESH_PHASE_IDLE;
+    uint32_t _now = ESP.getCycleCount();
+    uint8_t _prev = _statsPhase;
+    if (_statsOn)
+    {
+        if (_prev != REFRESH_PHASE_IDLE)
+            _stats.cycles[_prev] += _now - _statsStamp;
+        else
+            _statsI2c = _i2cTransactions;
+        if (_p == REFRESH_PHASE_IDLE && _prev != REFRESH_PHASE_IDLE) _stats.i2cTransactions += _i2cTransactions - _statsI2c;
+    }
+    if (_prev != REFRESH_PHASE_IDLE) traceWrite(TRACE_PHASE + _prev, 'E');
+    if (_p != REFRESH_PHASE_IDLE) traceWrite(TRACE_PHASE + _p, 'B');
+    _statsStamp = _now;
+    _statsPhase = _p;
+    return _prev;
+}
+
+// _kind: 0 display1b, 1 display3b, 2 partialUpdate
+void Inkplate::statsRefreshBegin(uint8_t _kind)
+{
+    traceWrite(TRACE_REFRESH, 'B', _kind);
+    _statsKind = _kind;
+    if (_energyOn)
+    {
+        _energyRefPixels = _energyStats.drivenPixels;
+        _energyRefFrames = _energyStats.frames;
+        _energyRefStart = micros();
+    }
+    if (_statsOn) _stats.refreshes++;
+    statsPhase(REFRESH_PHASE_PREPARE);
+    _statsStart = _statsStamp;
+}
+
+void Inkplate::statsRefreshEnd()
+{
+    statsPhase(REFRESH_PHASE_IDLE);
+    traceWrite(TRACE_REFRESH, 'E', _statsKind);
+    if (_statsOn) _stats.lastCycles = _statsStamp - _statsStart;
+    if (_energyOn)
+    {
+        uint32_t _us = micros() - _energyRefStart;
+        uint64_t _bl = _backlightOn ? (uint64_t)_us * _backlightLevel / 63 : 0;
+        _energyTime[_statsKind] = _us;
+        _energyStats.refreshes++;
+        _energyStats.backlightUs += _bl;
+        _energyStats.last = energyOf(_energyStats.drivenPixels - _energyRefPixels,
+                                     _energyStats.frames - _energyRefFrames, _us, _bl);
+    }
+}
+
+// ---------------------Event tracer functions----------------------------
+// Events go into ring buffer (when it's full, the oldest ones are overwritten). Writing an event is a short critical
+// section, so events can come from tasks on both cores. With tracer off, every traced place costs one pointer check.
+// Time is 64 bit esp_timer time, common to both cores and without wrap-around, however long the gaps between events are.
+traceEvent *Inkplate::_traceBuf = NULL;
+uint16_t Inkplate::_traceMask = 0;
+uint32_t Inkplate::_traceCount = 0;
+uint32_t Inkplate::_traceDropped = 0;
+portMUX_TYPE Inkplate::_traceMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Starts tracer with ring buffer of _events events (power of 2).
+bool Inkplate::traceBegin(uint16_t _events)
+{
+    traceEnd();
+    if (_events < 2 || (_events & (_events - 1))) return false;
+    traceEvent *_b = (traceEvent *)malloc(sizeof(traceEvent) * _events);
+    if (_b == NULL) return false;
+    portENTER_CRITICAL(&_traceMux);
+    _traceMask = _events - 1;
+    _traceCount = 0;
+    _traceDropped = 0;
+    _traceBuf = _b;
+    portEXIT_CRITICAL(&_traceMux);
+    return true;
+}
+
+void Inkplate::traceEnd()
+{
+    portENTER_CRITICAL(&_traceMux);
+    traceEvent *_b = _traceBuf;
+    _traceBuf = NULL;
+    portEXIT_CRITICAL(&_traceMux);
+    free(_b);
+}
+
+void Inkplate::traceWrite(uint8_t _id, char _ph, uint8_t _arg)
+{
+    if (_traceBuf == NULL) return;
+    uint8_t _core = xPortGetCoreID() & 1;
+    uint64_t _now = esp_timer_get_time();
+    portENTER_CRITICAL(&_traceMux);
+    if (_traceBuf != NULL)
+    {
+        traceEvent *_e = &_traceBuf[_traceCount & _traceMask];
+        _e->timeLow = _now;
+        _e->timeHigh = _now >> 32;
+        _e->id = _id;
+        _e->ph = _ph;
+        _e->core = _core;
+        _e->arg = _arg;
+        if (_traceCount > _traceMask) _traceDropped++;
+        _traceCount++;
+    }
+    portEXIT_CRITICAL(&_traceMux);
+}
+
+// Events overwritten because ring buffer was full (since traceBegin()).
+uint32_t Inkplate::getTraceDropped()
+{
+    return _traceDropped;
+}
+
+// Writes events in Chrome trace event format (JSON, opens in chrome://tracing and Perfetto UI). Cores are shown as
+// threads, time is in microseconds since boot. Tracing is stopped while dumping and the buffer is empty afterwards.
+// Returns the number of events written.
+uint32_t Inkplate::traceDump(Print &_p)
+{
+    static const char *_phases[REFRESH_PHASES] = {"other", "prepare", "power on", "clean", "data", "gap", "power off"};
+    portENTER_CRITICAL(&_traceMux);
+    traceEvent *_b = _traceBuf;
+    _traceBuf = NULL;
+    uint32_t _count = _traceCount;
+    portEXIT_CRITICAL(&_traceMux);
+    if (_b == NULL) return 0;
+
+    uint32_t _n = _count > (uint32_t)_traceMask + 1 ? _traceMask + 1 : _count;
+    _p.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\r\n");
+    _p.print("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"core 0\"}},\r\n");
+    _p.print("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"core 1\"}}");
+    for (uint32_t i = _count - _n; i != _count; i++)
+    {
+        traceEvent *_e = &_b[i & _traceMask];
+        double _us = ((uint64_t)_e->timeHigh << 32) | _e->timeLow;
+        const char *_cat = "user";
+        char _name[16];
+        if (_e->id == TRACE_REFRESH)
+        {
+            _cat = "refresh";
+            strcpy(_name, _e->arg == 0 ? "display1b" : (_e->arg == 1 ? "display3b" : "partialUpdate"));
+        }
+        else if (_e->id >= TRACE_PHASE && _e->id < TRACE_PHASE + REFRESH_PHASES)
+        {
+            _cat = "refresh";
+            strcpy(_name, _phases[_e->id - TRACE_PHASE]);
+        }
+        else if (_e->id == TRACE_I2C)
+        {
+            _cat = "i2c";
+            sprintf(_name, "i2c 0x%02X", _e->arg);
+        }
+        else if (_e->id == TRACE_TOUCH)
+        {
+            _cat = "touch";
+            strcpy(_name, "touch read");
+        }
+        else if (_e->id == TRACE_SD)
+        {
+            _cat = "sd";
+            strcpy(_name, "sd read");
+        }
+        else
+        {
+            sprintf(_name, "event %d", _e->id);
+        }
+        _p.printf(",\r\n{\"ph\":\"%c\",\"name\":\"%s\",\"cat\":\"%s\",\"ts\":%.0f,\"pid\":0,\"tid\":%d,\"args\":{\"arg\":%d}}",
+                  _e->ph, _name, _cat, _us, _e->core, _e->arg);
+    }
+    _p.print("\r\n]}\r\n");
+
+    portENTER_CRITICAL(&_traceMux);
+    _traceCount = 0;
+    _traceBuf = _b;
+    portEXIT_CRITICAL(&_traceMux);
+    return _n;
+}
+
+// ---------------------Energy accounting functions----------------------------
+// Energy is not measured, it's estimated from what the refresh does (see energyModel). Pixel counts come from one
+// pass over framebuffer per refresh, and only while accounting is enabled.
+void Inkplate::setEnergyAccounting(bool _on)
+{
+    if (_on && !_energyOn) _energyRailsOn = micros();
+    if (!_on && _energyOn && getPanelState() == 1) _energyStats.railsUs += micros() - _energyRailsOn;
+    _energyOn = _on;
+}
+
+void Inkplate::resetEnergyStats()
+{
+    memset(&_energyStats, 0, sizeof(_energyStats));
+    _energyRailsOn = micros();
+}
+
+// Counters with total energy computed with current model (rails that are on now are counted up to this moment).
+energyStats Inkplate::getEnergyStats()
+{
+    energyStats _s = _energyStats;
+    if (_energyOn && getPanelState() == 1) _s.railsUs += micros() - _energyRailsOn;
+    _s.total = energyOf(_s.drivenPixels, _s.frames, 0, _s.backlightUs) + _s.railsUs * _energyModel.railsMw / 1e6;
+    return _s;
+}
+
+void Inkplate::setEnergyModel(const energyModel &_m)
+{
+    _energyModel = _m;
+}
+
+energyModel Inkplate::getEnergyModel()
+{
+    return _energyModel;
+}
+
+// Scales the model so the total of current counters equals measured energy (in mJ, e.g. from battery current logged
+// over the same refreshes). Reset counters, refresh a few times, measure, then call this.
+bool Inkplate::calibrateEnergy(float _measuredMj)
+{
+    float _estimate = getEnergyStats().total;
+    if (_estimate <= 0 || _measuredMj <= 0) return false;
+    float _k = _measuredMj / _estimate;
+    _energyModel.pixelNj *= _k;
+    _energyModel.frameUj *= _k;
+    _energyModel.railsMw *= _k;
+    _energyModel.backlightMw *= _k;
+    return true;
+}
+
+// Estimated energy (mJ) of display() (or partialUpdate(_y1, _y2) if _partialRefresh is set) of current framebuffer. Refresh
+// time is taken from the last refresh of the same kind (or ENERGY_FRAME_US per frame if there wasn't any), so the
+// application can pick cheaper update before doing it.
+float Inkplate::estimateRefreshEnergy(bool _partialRefresh, int16_t _y1, int16_t _y2)
+{
+    if (_partialRefresh && _displayMode == INKPLATE_3BIT) return 0;
+    uint8_t _kind = _partialRefresh && !_blockPartial ? 2 : _displayMode;
+    if (_y1 < 0) _y1 = 0;
+    if (_y2 > E_INK_HEIGHT - 1) _y2 = E_INK_HEIGHT - 1;
+    if (_kind == 2 && _y1 > _y2) return 0;
+    if (_kind != 2)
+    {
+        _y1 = 0;
+        _y2 = E_INK_HEIGHT - 1;
+    }
+    // Clean frames: 36 of them drive all pixels in full refresh, none in partial update
+    const uint32_t _frames[3] = {46, 48, 6};
+    uint8_t *_fb = _kind == 1 ? D_memory4Bit : _partial;
+    uint64_t _pixels = energyPixels(_kind, _fb, _y1, _y2) + (_kind == 2 ? 0 : 36ULL * E_INK_WIDTH * E_INK_HEIGHT);
+    uint32_t _us = _energyTime[_kind] ? _energyTime[_kind] : _frames[_kind] * ENERGY_FRAME_US;
+    return energyOf(_pixels, _frames[_kind], _us, _backlightOn ? (uint64_t)_us * _backlightLevel / 63 : 0);
+}
+
+// Pixels driven by data frames of refresh of framebuffer _fb: 0 display1b (4 white frames, 1 black frame), 1 display3b
+// (9 frames of waveform), 2 partial update of rows _y1 to _y2 (3 frames of pixels that differ from D_memory_new).
+uint64_t Inkplate::energyPixels(uint8_t _kind, const uint8_t *_fb, int16_t _y1, int16_t _y2)
+{
+    const uint32_t _all = E_INK_WIDTH * E_INK_HEIGHT;
+    if (_kind == 0)
+    {
+        uint32_t _black = energyCountBits(_fb, NULL, _all / 8);
+        return 4ULL * (_all - _black) + _black;
+    }
+    if (_kind == 2)
+    {
+        uint32_t _o = E_INK_WIDTH / 8 * _y1;
+        return 3ULL * energyCountBits(D_memory_new + _o, _fb + _o, E_INK_WIDTH / 8 * (_y2 - _y1 + 1));
+    }
+    uint32_t _hist[8] = {0};
+    for (uint32_t i = 0; i < _all / 2; i++)
+    {
+        _hist[_fb[i] & 7]++;
+        _hist[(_fb[i] >> 4) & 7]++;
+    }
+    uint64_t _n = 0;
+    for (int l = 0; l < 8; l++)
+        for (int k = 0; k < 9; k++)
+            if (waveform3Bit[l][k]) _n += _hist[l];
+    return _n;
+}
+
+// Number of set bits in _p (or in _p XOR _x).
+uint32_t Inkplate::energyCountBits(const uint8_t *_p, const uint8_t *_x, uint32_t _n)
+{
+    uint32_t _c = 0;
+    uint32_t i = 0;
+    if (((uintptr_t)_p & 3) == 0 && (_x == NULL || ((uintptr_t)_x & 3) == 0))
+    {
+        for (; i + 4 <= _n; i += 4)
+        {
+            uint32_t _w = *(const uint32_t *)(_p + i);
+            if (_x != NULL) _w ^= *(const uint32_t *)(_x + i);
+            _c += __builtin_popcount(_w);
+        }
+    }
+    for (; i < _n; i++) _c += __builtin_popcount(_x != NULL ? _p[i] ^ _x[i] : _p[i]);
+    return _c;
+}
+
+float Inkplate::energyOf(uint64_t _pixels, uint32_t _frames, uint32_t _us, uint64_t _backlightUs)
+{
+    return _pixels * _energyModel.pixelNj / 1e6 + _frames * _energyModel.frameUj / 1e3 +
+           _us * _energyModel.railsMw / 1e6 + _backlightUs * _energyModel.backlightMw / 1e6;
+}
+
+// ---------------------Flash image store functions----------------------------
+// Images are kept in flash partition as raw framebuffer content (same layout as _partial or D_memory4Bit), so showing them
+// is just a copy from memory mapped flash into framebuffer. First two sectors of partition hold two copies of directory of
+// stored images, the one with valid checksum and higher sequence number is current. New directory is always written over
+// the older copy and image data always goes into free space, so the current directory and images it points to stay intact
+// until the new directory is completely written. Reset or failed write at any point leaves the previous state.
+#define FLASH_STORE_MAGIC 0x53465049 // "IPFS"
+#define FLASH_STORE_DATA  (2 * FLASH_STORE_SECTOR)
+
+bool Inkplate::flashStoreBegin()
+{
+    if (_flashStore != NULL) return true;
+    const esp_partition_t *_part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, FLASH_STORE_LABEL);
+    if (_part == NULL || _part->size < FLASH_STORE_DATA + FLASH_STORE_SECTOR) return false;
+    if (_flashDir == NULL) _flashDir = (flashStoreDirectory*)malloc(sizeof(flashStoreDirectory));
+    flashStoreDirectory *_other = (flashStoreDirectory*)malloc(sizeof(flashStoreDirectory));
+    if (_flashDir == NULL || _other == NULL)
+    {
+        free(_other);
+        return false;
+    }
+    _flashStore = _part;
+    bool _a = flashStoreReadDirectory(0, _flashDir);
+    bool _b = flashStoreReadDirectory(1, _other);
+    _flashDirSector = 0;
+    if (_b && (!_a || (int32_t)(_other->seq - _flashDir->seq) > 0))
+    {
+        memcpy(_flashDir, _other, sizeof(flashStoreDirectory));
+        _flashDirSector = 1;
+    }
+    free(_other);
+    if (!_a && !_b)
+    {
+        _flashDir->seq = 0;
+        return flashStoreFormat();
+    }
+    return true;
+}
+
+// Removes all images from the store.
+bool Inkplate::flashStoreFormat()
+{
+    if (_flashStore == NULL && !flashStoreBegin()) return false;
+    uint32_t _seq = _flashDir->seq;
+    memset(_flashDir, 0xFF, sizeof(flashStoreDirectory));
+    _flashDir->magic = FLASH_STORE_MAGIC;
+    _flashDir->version = 2;
+    _flashDir->count = 0;
+    _flashDir->seq = _seq;
+    return flashStoreWriteDirectory();
+}
+
+// Reads directory copy from _sector, returns false if it's not a valid directory (erased, torn or old version).
+bool Inkplate::flashStoreReadDirectory(uint8_t _sector, flashStoreDirectory *_d)
+{
+    if (esp_partition_read(_flashStore, _sector * FLASH_STORE_SECTOR, _d, sizeof(flashStoreDirectory)) != ESP_OK)
+        return false;
+    if (_d->magic != FLASH_STORE_MAGIC || _d->version != 2 || _d->count > FLASH_STORE_MAX_IMAGES) return false;
+    uint32_t _check = _d->check;
+    _d->check = 0;
+    bool _ok = rowChecksum((const uint8_t*)_d, sizeof(flashStoreDirectory)) == _check;
+    _d->check = _check;
+    return _ok;
+}
+
+// Writes directory in RAM over the older copy with the next sequence number. If that fails, directory in RAM goes back
+// to the current copy in flash.
+bool Inkplate::flashStoreWriteDirectory()
+{
+    uint8_t _to = !_flashDirSector;
+    _flashDir->seq++;
+    _flashDir->check = 0;
+    _flashDir->check = rowChecksum((const uint8_t*)_flashDir, sizeof(flashStoreDirectory));
+    if (esp_partition_erase_range(_flashStore, _to * FLASH_STORE_SECTOR, FLASH_STORE_SECTOR) != ESP_OK ||
+        esp_partition_write(_flashStore, _to * FLASH_STORE_SECTOR, _flashDir, sizeof(flashStoreDirectory)) != ESP_OK)
+    {
+        if (!flashStoreReadDirectory(_flashDirSector, _flashDir)) _flashDir->count = 0;
+        return false;
+    }
+    _flashDirSector = _to;
+    return true;
+}
+
+uint8_t Inkplate::flashStoreCount()
+{
+    return _flashStore == NULL ? 0 : _flashDir->count;
+}
+
+const char* Inkplate::flashStoreName(uint8_t _n)
+{
+    if (_flashStore == NULL || _n >= _flashDir->count) return NULL;
+    return _flashDir->entry[_n].name;
+}
+
+int Inkplate::flashStoreFind(const char* _name)
+{
+    if (_flashStore == NULL) return -1;
+    for (int i = 0; i < _flashDir->count; i++)
+    {
+        if (strncmp(_flashDir->entry[i].name, _name, FLASH_STORE_NAME_LEN) == 0) return i;
+    }
+    return -1;
+}
+
+// Copies stored image straight from memory mapped flash into framebuffer (display mode is changed if needed).
+bool Inkplate::flashStoreDraw(const char* _name)
+{
+    int _n = flashStoreFind(_name);
+    if (_n < 0) return false;
+    flashStoreEntry *e = &_flashDir->entry[_n];
+    const void *_p;
+    spi_flash_mmap_handle_t _h;
+    if (esp_partition_mmap(_flashStore, e->offset, e->size, SPI_FLASH_MMAP_DATA, &_p, &_h) != ESP_OK) return false;
+    if (getDisplayMode() != e->mode) selectDisplayMode(e->mode);
+    memcpy(e->mode == INKPLATE_1BIT ? _partial : D_memory4Bit, _p, e->size);
+    spi_flash_munmap(_h);
+    return true;
+}
+
+// First fit: lowest offset where _slot bytes don't overlap any image in directory (including the old version of the image
+// that is being replaced). Space of removed and replaced images is used again this way. Returns 0 if there is no space.
+uint32_t Inkplate::flashStoreAlloc(uint32_t _slot)
+{
+    for (int i = -1; i < _flashDir->count; i++)
+    {
+        uint32_t _at = i < 0 ? FLASH_STORE_DATA : _flashDir->entry[i].offset + _flashDir->entry[i].slot;
+        if (_at + _slot > _flashStore->size) continue;
+        bool _free = true;
+        for (int j = 0; j < _flashDir->count && _free; j++)
+        {
+            flashStoreEntry *e = &_flashDir->entry[j];
+            if (_at < e->offset + e->slot && e->offset < _at + _slot) _free = false;
+        }
+        if (_free) return _at;
+    }
+    return 0;
+}
+
+// Fills new directory entry _e for the image and erases free space for it. Directory isn't changed until
+// flashStoreCommit(), so old image with the same name is still there if writing of the new one fails.
+bool Inkplate::flashStorePrepare(const char* _name, uint8_t _mode, flashStoreEntry *_e)
+{
+    if (_flashStore == NULL && !flashStoreBegin()) return false;
+    if (flashStoreFind(_name) < 0 && _flashDir->count >= FLASH_STORE_MAX_IMAGES) return false;
+    memset(_e, 0, sizeof(flashStoreEntry));
+    strncpy(_e->name, _name, FLASH_STORE_NAME_LEN - 1);
+    _e->mode = _mode;
+    _e->size = _mode == INKPLATE_1BIT ? (E_INK_WIDTH * E_INK_HEIGHT / 8) : (E_INK_WIDTH * E_INK_HEIGHT / 2);
+    _e->slot = (_e->size + FLASH_STORE_SECTOR - 1) & ~(FLASH_STORE_SECTOR - 1);
+    _e->offset = flashStoreAlloc(_e->slot);
+    return _e->offset != 0 && esp_partition_erase_range(_flashStore, _e->offset, _e->slot) == ESP_OK;
+}
+
+// Puts written image into directory (in place of old image with the same name) and writes directory.
+bool Inkplate::flashStoreCommit(flashStoreEntry *_e)
+{
+    int _n = flashStoreFind(_e->name);
+    if (_n < 0) _n = _flashDir->count++;
+    _flashDir->entry[_n] = *_e;
+    return flashStoreWriteDirectory();
+}
+
+// Saves current framebuffer content into flash store. Replacing an image needs free space for the new copy.
+bool Inkplate::flashStoreSave(const char* _name)
+{
+    flashStoreEntry e;
+    if (!flashStorePrepare(_name, _displayMode, &e)) return false;
+    if (esp_partition_write(_flashStore, e.offset, _displayMode == INKPLATE_1BIT ? _partial : D_memory4Bit, e.size) != ESP_OK)
+        return false;
+    return flashStoreCommit(&e);
+}
+
+// Writes already packed framebuffer data (e.g. file from SD card or data from Serial) into flash store.
+bool Inkplate::flashStoreWrite(const char* _name, uint8_t _mode, ImageSource* _s)
+{
+    flashStoreEntry e;
+    if (!flashStorePrepare(_name, _mode & 1, &e)) return false;
+    uint8_t *_buf = (uint8_t*)malloc(FLASH_STORE_SECTOR);
+    if (_buf == NULL) return false;
+    uint32_t _done = 0;
+    while (_done < e.size)
+    {
+        uint32_t _k = e.size - _done > FLASH_STORE_SECTOR ? FLASH_STORE_SECTOR : e.size - _done;
+        if (_s->read(_buf, _k) != (int)_k || esp_partition_write(_flashStore, e.offset + _done, _buf, _k) != ESP_OK) break;
+        _done += _k;
+    }
+    free(_buf);
+    if (_done != e.size) return false;
+    return flashStoreCommit(&e);
+}
+
+bool Inkplate::flashStoreRemove(const char* _name)
+{
+    int _n = flashStoreFind(_name);
+    if (_n < 0) return false;
+    memmove(&_flashDir->entry[_n], &_flashDir->entry[_n + 1], (_flashDir->count - _n - 1) * sizeof(flashStoreEntry));
+    _flashDir->count--;
+    return flashStoreWriteDirectory();
+}
+
+
+// ---------------------Framebuffer upload functions----------------------------
+// Uploads raw framebuffer content into rectangular region of the current framebuffer, in its own layout (1 bit mode: 1 bit
+// per pixel, first pixel in LSB, 1 is black; 3 bit mode: 4 bits per pixel, first pixel in high nibble, 7 is white).
+// Region is given in panel coordinates (without rotation), x and w have to be multiples of 8 pixels in 1 bit mode and
+// 2 pixels in 3 bit mode. Data is sent row by row and can come in any number of uploadWrite() calls.
+bool Inkplate::uploadBegin(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _flags)
+{
+    uint8_t _ppb = _displayMode == INKPLATE_1BIT ? 8 : 2;
+    _upLeft = 0;
+    _upH = 0;
+    if (_x < 0 || _y < 0 || _w <= 0 || _h <= 0 || _x + _w > E_INK_WIDTH || _y + _h > E_INK_HEIGHT || _x % _ppb || _w % _ppb)
+        return false;
+    uint8_t *_fb = _displayMode == INKPLATE_1BIT ? _partial : D_memory4Bit;
+    _upRow = _fb + (uint32_t)_y * (E_INK_WIDTH / _ppb) + _x / _ppb;
+    _upStride = _w / _ppb;
+    _upCol = 0;
+    _upLeft = (uint32_t)_upStride * _h;
+    _upY = _y;
+    _upH = _h;
+    _upFlags = _flags;
+    _upState = 0;
+    _upOverflow = 0;
+    return true;
+}
+
+void Inkplate::uploadPut(uint8_t _b)
+{
+    if (_upLeft == 0)
+    {
+        _upOverflow = 1;
+        return;
+    }
+    if (_upFlags & UPLOAD_XOR)
+        _upRow[_upCol] ^= _b;
+    else
+        _upRow[_upCol] = _b;
+    if (++_upCol == _upStride)
+    {
+        _upCol = 0;
+        _upRow += _displayMode == INKPLATE_1BIT ? E_INK_WIDTH / 8 : E_INK_WIDTH / 2;
+    }
+    _upLeft--;
+}
+
+// Returns false if there is more data than the region can hold (extra data is dropped).
+bool Inkplate::uploadWrite(const uint8_t *_d, uint32_t _n)
+{
+    if (!(_upFlags & UPLOAD_RLE))
+    {
+        while (_n--)
+            uploadPut(*_d++);
+        return !_upOverflow;
+    }
+
+    // PackBits: header 0-127 is followed by 1-128 literal bytes, header 129-255 by one byte that is repeated 2-128 times
+    while (_n--)
+    {
+        uint8_t _b = *_d++;
+        if (_upState == 0)
+        {
+            if (_b < 128)
+            {
+                _upState = 1;
+                _upCount = _b + 1;
+            }
+            else if (_b > 128)
+            {
+                _upState = 2;
+                _upCount = 257 - _b;
+            }
+        }
+        else if (_upState == 1)
+        {
+            uploadPut(_b);
+            if (--_upCount == 0) _upState = 0;
+        }
+        else
+        {
+            while (_upCount--)
+                uploadPut(_b);
+            _upState = 0;
+        }
+    }
+    return !_upOverflow;
+}
+
+// Finishes the upload. If _update is set, uploaded rows are refreshed with partial update (or whole screen in 3 bit mode).
+// Returns true if exactly the whole region was received.
+bool Inkplate::uploadEnd(bool _update)
+{
+    bool _ok = _upLeft == 0 && !_upOverflow && _upState == 0;
+    if (_update && _upH)
+    {
+        if (_displayMode == INKPLATE_1BIT)
+            partialUpdate(_upY, _upY + _upH - 1);
+        else
+            display();
+    }
+    _upLeft = 0;
+    _upH = 0;
+    return _ok;
+}
+
 // ---------------------Touchscreen functions----------------------------
 uint8_t Inkplate::tsWriteRegs(uint8_t _addr, const uint8_t *_buff, uint8_t _size)
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(_buff, _size);
-  return Wire.endTransmission();
+  return i2cWrite(_addr, _buff, _size);
 }
 
 void Inkplate::tsReadRegs(uint8_t _addr, uint8_t *_buff, uint8_t _size)
 {
-  Wire.requestFrom(_addr, _size);
-  Wire.readBytes(_buff, _size);
+  i2cRead(_addr, _buff, _size);
 }
 
 void Inkplate::tsHardwareReset()
@@ -1118,8 +2753,7 @@ bool Inkplate::tsSoftwareReset()
       timeout--;
     }
     if (timeout > 0) _tsFlag = true;
-    Wire.requestFrom(0x15, 4);
-    Wire.readBytes(rb, 4);
+    tsReadRegs(TS_ADDR, rb, 4);
     _tsFlag = false;
     if (!memcmp(rb, hello_packet, 4))
     {
@@ -1149,6 +2783,7 @@ bool Inkplate::tsInit(uint8_t _pwrState)
     return false;
   }
   tsGetResolution(&_tsXResolution, &_tsYResolution);
+  tsUpdateMatrix();
   tsSetPowerState(_pwrState);
   return true;
 }
@@ -1160,8 +2795,9 @@ void Inkplate::tsShutdown()
 
 void Inkplate::tsGetRawData(uint8_t *b)
 {
-  Wire.requestFrom(TS_ADDR, 8);
-  Wire.readBytes(b, 8);
+  traceWrite(TRACE_TOUCH, 'B');
+  i2cRead(TS_ADDR, b, 8);
+  traceWrite(TRACE_TOUCH, 'E');
 }
 
 void Inkplate::tsGetXY(uint8_t *_d, uint16_t *x, uint16_t *y)
@@ -1175,41 +2811,172 @@ void Inkplate::tsGetXY(uint8_t *_d, uint16_t *x, uint16_t *y)
   *y |= _d[2];
 }
 
+// If touch events are running, oldest event from the queue is returned (0 fingers if queue is empty).
 uint8_t Inkplate::tsGetData(uint16_t *xPos, uint16_t *yPos) {
+  if (_tsTaskHandle != NULL)
+  {
+    touchEvent _e;
+    if (tsGetEvents(&_e, 1) == 0) return 0;
+    for (int i = 0; i < 2; i++)
+    {
+      xPos[i] = _e.x[i];
+      yPos[i] = _e.y[i];
+    }
+    return _e.fingers;
+  }
   uint8_t _raw[8];
-  uint16_t xRaw[2], yRaw[2];
-  uint8_t fingers = 0;
   _tsFlag = false;
   tsGetRawData(_raw);
-  for (int i = 0; i < 8; i++)
+  return tsConvert(_raw, xPos, yPos);
+}
+
+// Number of fingers and screen coordinates from raw touchscreen controller data.
+uint8_t Inkplate::tsConvert(uint8_t *_raw, uint16_t *xPos, uint16_t *yPos) {
+  uint16_t xRaw, yRaw;
+  uint8_t fingers = __builtin_popcount(_raw[7]);
+  uint8_t n = fingers < 2 ? fingers : 2;
+
+  for (int i = 0; i < n; i++)
+  {
+    tsGetXY((_raw + 1) + (i * 3), &xRaw, &yRaw);
+    int32_t x = (_tsMatrix[0] * xRaw + _tsMatrix[1] * yRaw + _tsMatrix[2]) >> 16;
+    int32_t y = (_tsMatrix[3] * xRaw + _tsMatrix[4] * yRaw + _tsMatrix[5]) >> 16;
+    xPos[i] = x < 0 ? 0 : (x >= width() ? width() - 1 : x);
+    yPos[i] = y < 0 ? 0 : (y >= height() ? height() - 1 : y);
+  }
+  for (int i = n; i < 2; i++)
   {
-    if (_raw[7] & (1 << i)) fingers++;
+    xPos[i] = yPos[i] = 0;
   }
+  return fingers;
+}
 
+// Raw touchscreen coordinates are converted into screen coordinates with one affine transformation (Q16 fixed point):
+//   x = (m0 * xRaw + m1 * yRaw + m2) >> 16
+//   y = (m3 * xRaw + m4 * yRaw + m5) >> 16
+// Matrix is made from touchscreen resolution, screen rotation and calibration (if it's set), every time one of them
+// changes.
+void Inkplate::tsUpdateMatrix()
+{
+  if (_tsXResolution == 0 || _tsYResolution == 0) return;
+  double sx = (double)E_INK_HEIGHT / _tsXResolution;
+  double sy = (double)E_INK_WIDTH / _tsYResolution;
+  double r[6];
+  switch (rotation)
+  {
+  case 0:
+    r[0] = 0; r[1] = -sy; r[2] = E_INK_WIDTH - 1;
+    r[3] = sx; r[4] = 0; r[5] = 0;
+    break;
+  case 1:
+    r[0] = sx; r[1] = 0; r[2] = 0;
+    r[3] = 0; r[4] = sy; r[5] = 0;
+    break;
+  case 2:
+    r[0] = 0; r[1] = sy; r[2] = 0;
+    r[3] = -sx; r[4] = 0; r[5] = E_INK_HEIGHT - 1;
+    break;
+  default:
+    r[0] = -sx; r[1] = 0; r[2] = E_INK_HEIGHT - 1;
+    r[3] = 0; r[4] = -sy; r[5] = E_INK_WIDTH - 1;
+    break;
+  }
+  // Calibration corrects raw coordinates first, so it's the same for every rotation.
+  const float *k = _tsCal;
   for (int i = 0; i < 2; i++)
   {
-    tsGetXY((_raw + 1) + (i * 3), &xRaw[i], &yRaw[i]);
-    switch (rotation)
+    double a = r[i * 3], b = r[i * 3 + 1], c = r[i * 3 + 2];
+    _tsMatrix[i * 3] = lround((a * k[0] + b * k[3]) * 65536.0);
+    _tsMatrix[i * 3 + 1] = lround((a * k[1] + b * k[4]) * 65536.0);
+    _tsMatrix[i * 3 + 2] = lround((a * k[2] + b * k[5] + c) * 65536.0);
+  }
+}
+
+// Sets calibration of the touchscreen as affine transformation of raw coordinates:
+//   xRaw' = k[0] * xRaw + k[1] * yRaw + k[2]
+//   yRaw' = k[3] * xRaw + k[4] * yRaw + k[5]
+// Send NULL to remove calibration.
+void Inkplate::tsSetCalibration(const float *_k)
+{
+  const float _identity[6] = {1, 0, 0, 0, 1, 0};
+  memcpy(_tsCal, _k == NULL ? _identity : _k, sizeof(_tsCal));
+  tsUpdateMatrix();
+}
+
+// Starts touch task: touchscreen interrupt wakes the task, which reads the controller and puts the sample into queue,
+// so samples are not lost while application is busy (for example during refresh).
+bool Inkplate::tsEventsBegin()
+{
+  if (_tsTaskHandle != NULL) return true;
+  _tsHead = _tsTail = 0;
+  _tsDropped = 0;
+  _tsStop = 0;
+  TaskHandle_t _t;
+  // Stack: I2C read through Wire (with bus lock and trace), float calibration math and FreeRTOS overhead don't fit
+  // safely in 2 KB, 4 KB leaves margin for the Wire driver's error paths (logging on I2C errors).
+  if (xTaskCreatePinnedToCore(tsTask, "touch", 4096, this, 5, &_t, tskNO_AFFINITY) != pdPASS) return false;
+  _tsTaskHandle = _t;
+  // Interrupt that came before the task was started would be lost otherwise.
+  if (_tsFlag) xTaskNotifyGive(_t);
+  return true;
+}
+
+void Inkplate::tsEventsEnd()
+{
+  if (_tsTaskHandle == NULL) return;
+  _tsStop = 1;
+  xTaskNotifyGive(_tsTaskHandle);
+  while (_tsStop) delay(1);
+}
+
+// Copies up to _max oldest events into _e and removes them from the queue. Returns number of copied events.
+uint16_t Inkplate::tsGetEvents(touchEvent *_e, uint16_t _max)
+{
+  uint16_t _n = 0;
+  uint16_t _tail = _tsTail;
+  while (_n < _max && _tail != _tsHead)
+  {
+    _e[_n++] = _tsQueue[_tail];
+    _tail = (_tail + 1) & (TS_QUEUE_SIZE - 1);
+  }
+  __sync_synchronize();
+  _tsTail = _tail;
+  if (_tail == _tsHead) _tsFlag = false;
+  return _n;
+}
+
+// Number of events that were dropped because the queue was full.
+uint32_t Inkplate::tsGetDroppedEvents()
+{
+  return _tsDropped;
+}
+
+void Inkplate::tsTask(void *_p)
+{
+  Inkplate *_d = (Inkplate *)_p;
+  uint8_t _raw[8];
+  while (true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (_d->_tsStop) break;
+    uint32_t _time = _tsIntTime;
+    _d->tsGetRawData(_raw);
+    uint16_t _next = (_d->_tsHead + 1) & (TS_QUEUE_SIZE - 1);
+    if (_next == _d->_tsTail)
     {
-    case 0:
-        yPos[i] = ((xRaw[i] * E_INK_HEIGHT - 1) / _tsXResolution);
-        xPos[i] = E_INK_WIDTH - 1 - ((yRaw[i] * E_INK_WIDTH - 1) / _tsYResolution);
-        break;
-    case 1:
-        xPos[i] = ((xRaw[i] * E_INK_HEIGHT - 1) / _tsXResolution);
-        yPos[i] = ((yRaw[i] * E_INK_WIDTH - 1) / _tsYResolution);
-        break;
-    case 2:
-        yPos[i] = E_INK_HEIGHT - 1 - ((xRaw[i] * E_INK_HEIGHT - 1) / _tsXResolution);
-        xPos[i] = ((yRaw[i] * E_INK_WIDTH - 1) / _tsYResolution);
-        break;
-    case 3:
-        xPos[i] = E_INK_HEIGHT - 1 - ((xRaw[i] * E_INK_HEIGHT - 1) / _tsXResolution);
-        yPos[i] = E_INK_WIDTH - 1 - ((yRaw[i] * E_INK_WIDTH - 1) / _tsYResolution);
-        break;
+      _d->_tsDropped++;
+      continue;
     }
+    touchEvent *_e = &_d->_tsQueue[_d->_tsHead];
+    _e->time = _time;
+    _e->fingers = _d->tsConvert(_raw, _e->x, _e->y);
+    __sync_synchronize();
+    _d->_tsHead = _next;
+    _tsFlag = true;
   }
-  return fingers;
+  _tsTaskHandle = NULL;
+  _d->_tsStop = 0;
+  vTaskDelete(NULL);
 }
 
 void Inkplate::tsGetResolution(uint16_t *xRes, uint16_t *yRes)
@@ -1246,19 +3013,20 @@ uint8_t Inkplate::tsGetPowerState()
 
 bool Inkplate::tsAvailable()
 {
+  if (_tsTaskHandle != NULL) return _tsHead != _tsTail;
   return _tsFlag;
 }
 
 void Inkplate::setBacklight(uint8_t _v)
 {
-    Wire.beginTransmission(0x5C >> 1);
-    Wire.write(0);
-    Wire.write(63 - (_v & 0b00111111));
-    Wire.endTransmission();
+    const uint8_t _b[] = {0, (uint8_t)(63 - (_v & 0b00111111))};
+    i2cWrite(0x5C >> 1, _b, 2);
+    _backlightLevel = _v & 0b00111111;
 }
 
 void Inkplate::backlight(bool _e)
 {
+    _backlightOn = _e;
     if (_e)
     {
         pinModeInternal(MCP23017_INT_ADDR, mcpRegsInt, BACKLIGHT_EN, OUTPUT);
@@ -18,7 +18,8 @@ NOTE: This library is still heavily in progress, so there is still some bugs. Us
 #include "WProgram.h"
 #endif
 
-#ifndef ARDUINO_ESP32_DEV
+// INKPLATE_HOST is defined by host (Linux) builds against the simulated board in extras/host/sim
+#if !defined(ARDUINO_ESP32_DEV) && !defined(INKPLATE_HOST)
 #error "Wrong board selected! Select ESP32 Wrover from board menu!"
 #endif
 
@@ -26,6 +27,12 @@ NOTE: This library is still heavily in progress, so there is still some bugs. Us
 #include "Wire.h"
 #include "SPI.h"
 #include "SdFat.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "driver/adc.h"
+#include "esp_adc_cal.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #define MCP23017_INT_ADDR		0x20
 #define MCP23017_EXT_ADDR		0x22
@@ -72,6 +79,22 @@ NOTE: This library is still heavily in progress, so there is still some bugs. Us
 #define INKPLATE_3BIT 		1
 #define BACKLIGHT_EN        11
 #define PWR_GOOD_OK   0b11111010
+// Power good register of TPS65186 is polled every PWR_GOOD_POLL_MS. If TPS65186 PWRGOOD output is connected to internal
+// I/O expander (TPS_PWRGOOD) and interrupt output of I/O expander (INTA) to ESP32, define MCP23017_INT_PIN as that ESP32
+// pin to wait on the interrupt instead. Register is then read only when the pin changes, or every PWR_GOOD_INT_POLL_MS
+// in case an edge is missed. This wiring isn't confirmed yet, so it's off by default.
+#define TPS_PWRGOOD         6   //GPIOA6
+#ifndef MCP23017_INT_PIN
+#define MCP23017_INT_PIN    -1
+#endif
+#define PWR_GOOD_TIMEOUT    250
+#define PWR_GOOD_POLL_MS    1
+#define PWR_GOOD_INT_POLL_MS 25
+
+#define BATTERY_ADC_PIN     35
+#define BATTERY_SAMPLES     64
+#define BATTERY_PERIOD_MS   10000
+#define BATTERY_FILTER      0.25
 
 #define DATA    		0x0E8C0030   //D0-D7 = GPIO4 GPIO5 GPIO18 GPIO19 GPIO23 GPIO25 GPIO26 GPIO27
 
@@ -104,6 +127,29 @@ NOTE: This library is still heavily in progress, so there is still some bugs. Us
 #define SPV_SET     	{digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, SPV, HIGH);}
 #define SPV_CLEAR   	{digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, SPV, LOW);}
 
+// I2C clock is selected for every transaction by device address (i2cSetClock()), everything runs at I2C_BUS_CLOCK by
+// default. TPS65186, touchscreen and backlight on the same bus are rated for 400 kHz, so faster clock for I/O expanders
+// (MCP23017 supports 1.7 MHz) is opt-in: define MCP23017_FAST_CLOCK as e.g. 1000000. Bus clock is then switched before
+// every transaction to a device with other clock.
+#ifndef I2C_BUS_CLOCK
+#define I2C_BUS_CLOCK       400000
+#endif
+#ifndef MCP23017_FAST_CLOCK
+#define MCP23017_FAST_CLOCK I2C_BUS_CLOCK
+#endif
+// Default for setFrameStartStaging(). With staging, first CKV pulse and SPV low write of the frame start are done in the
+// last part of the gap between frames, so the gap with the frame start is shorter by the time of that I2C write. CKV and
+// SPV sequence is the same, only the idle time before it is shorter. SPV high write can't be moved out of the frame start:
+// it has to come between the first and the second CKV pulse, and SPV is only reachable over I2C. So one synchronous
+// I2C write stays in the frame start either way. Staging is off by default because the shorter gap (230 us minus the
+// write time) hasn't been verified on panels yet; the original sequence (full gap, then frame start) is kept.
+#ifndef VSCAN_STAGE_SPV
+#define VSCAN_STAGE_SPV     0
+#endif
+#define I2C_MAX_DEVICES     8
+#define I2C_PRIO_NORMAL     0
+#define I2C_PRIO_HIGH       1
+
 #define WAKEUP         	3   //GPIOA3
 #define WAKEUP_SET     	{digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, WAKEUP, HIGH);}
 #define WAKEUP_CLEAR   	{digitalWriteInternal(MCP23017_INT_ADDR, mcpRegsInt, WAKEUP, LOW);}
@@ -125,16 +171,206 @@ NOTE: This library is still heavily in progress, so there is still some bugs. Us
 #define     TS_RTS              10
 #define     TS_INT              36
 #define     TS_ADDR             0x15
+#define     TS_QUEUE_SIZE       64  // Must be power of 2
+
+
+// SD card defines
+#define     SD_CS               15
+#define     SD_DEFAULT_MHZ      25
+#define     SD_MIN_MHZ          4
+#define     SD_RAW_BLOCKS       16   // Size of DMA capable read buffer in 512 byte blocks
 
+// Flash image store defines
+#define     FLASH_STORE_LABEL       "images"    // Label of data partition (subtype 0x40) that holds images
+#define     FLASH_STORE_MAX_IMAGES  32
+#define     FLASH_STORE_NAME_LEN    32
+#define     FLASH_STORE_SECTOR      4096
+
+// Refresh statistics phases (index into refreshStats.cycles)
+#define     REFRESH_PHASE_OTHER     0   // Refresh time outside of other phases (waiting for panel, keep-alive timer)
+#define     REFRESH_PHASE_PREPARE   1   // Framebuffer copy and partial update diff
+#define     REFRESH_PHASE_POWER_ON  2   // einkOn(), mostly waiting for power good
+#define     REFRESH_PHASE_CLEAN     3   // cleanFast() frames
+#define     REFRESH_PHASE_DATA      4   // Frames with framebuffer data
+#define     REFRESH_PHASE_GAP       5   // vscan_gap() between frames
+#define     REFRESH_PHASE_POWER_OFF 6   // einkOff()
+#define     REFRESH_PHASES          7
+#define     REFRESH_PHASE_IDLE      0xFF
+
+// Event tracer defines. Event ids are used as names in traceDump(), ids from TRACE_USER up are free for the application.
+#define     TRACE_DEFAULT_SIZE  1024    // Events in ring buffer, must be power of 2
+#define     TRACE_REFRESH       0       // Whole refresh, arg: 0 display1b, 1 display3b, 2 partialUpdate
+#define     TRACE_PHASE         1       // TRACE_PHASE + REFRESH_PHASE_... (phases of refresh and power functions)
+#define     TRACE_I2C           (TRACE_PHASE + REFRESH_PHASES)  // I2C transaction, arg: device address
+#define     TRACE_TOUCH         (TRACE_I2C + 1)                 // Touchscreen data read
+#define     TRACE_SD            (TRACE_I2C + 2)                 // SD card read, arg: 512 byte blocks
+#define     TRACE_USER          32
+
+// Energy model defaults. These are rough values, calibrate them against measurement with calibrateEnergy().
+#define     ENERGY_PIXEL_NJ     2.0     // Driving one pixel black or white for one frame (nJ)
+#define     ENERGY_FRAME_UJ     500.0   // One frame scan, gate and source drivers (uJ)
+#define     ENERGY_RAILS_MW     150.0   // Panel supply while rails are on (mW)
+#define     ENERGY_BACKLIGHT_MW 300.0   // Backlight at full brightness (mW)
+#define     ENERGY_FRAME_US     10000   // Frame time used by estimateRefreshEnergy() before the first measured refresh
+
+// Framebuffer upload defines
+#define     UPLOAD_RLE          1   // Uploaded data is PackBits compressed
+#define     UPLOAD_XOR          2   // Uploaded data is XORed with current framebuffer content (delta from previous frame)
 
 extern SPIClass spi2;
 extern SdFat sd;
+
+// Source of image data for bitmap decoders. Every source has to support bulk reads, seeking is optional
+// (if source can't seek, like Serial, decoders just read and drop bytes until they reach wanted position).
+class ImageSource {
+  public:
+    virtual int read(uint8_t *_b, uint32_t _n) = 0;
+    virtual int read()
+    {
+        uint8_t c;
+        return read(&c, 1) == 1 ? c : -1;
+    }
+    virtual bool seek(uint32_t _pos)
+    {
+        return false;
+    }
+    virtual uint32_t position() = 0;
+    bool skipTo(uint32_t _pos);
+};
+
+// Image data from any Arduino Stream (Serial, WiFiClient, ...). Read waits for data until stream timeout expires.
+class StreamSource : public ImageSource {
+  public:
+    StreamSource(Stream &_s);
+    using ImageSource::read;
+    int read(uint8_t *_b, uint32_t _n);
+    uint32_t position();
+
+  private:
+    Stream *_stream;
+    uint32_t _pos = 0;
+};
+
+// Image data that is already in memory (RAM, PSRAM or memory mapped flash).
+class MemorySource : public ImageSource {
+  public:
+    MemorySource(const uint8_t *_p, uint32_t _size);
+    int read(uint8_t *_b, uint32_t _n);
+    int read();
+    bool seek(uint32_t _p);
+    uint32_t position();
+
+  private:
+    const uint8_t *_data;
+    uint32_t _size;
+    uint32_t _pos = 0;
+};
+
+// Buffered reader for image files on SD card. If the file is stored in contiguous blocks, it reads multiple blocks at once
+// straight from the card (bypassing FAT layer) into DMA capable buffer. On read error SPI clock is lowered, card is
+// initialized again and the read is retried. If that doesn't help, it falls back to reading through SdFat file functions
+// (file position is set again from the start of the file). If card can't be initialized even at SD_MIN_MHZ, read fails.
+// File stays open, it's closed by its owner.
+class SdRawReader : public ImageSource {
+  public:
+    SdRawReader(SdFile *_f, uint8_t *_buf, uint8_t *_mhz);
+    bool seek(uint32_t _pos);
+    int read(uint8_t *_b, uint32_t _n);
+    int read()
+    {
+        if (_pos >= _bufPos + _bufLen && !fill()) return -1;
+        return _buf[(_pos++) - _bufPos];
+    }
+    uint32_t position();
+
+  private:
+    SdFile *_file;
+    uint8_t *_buf;
+    uint8_t *_mhz;
+    uint8_t _local[512];
+    uint8_t _maxBlocks;
+    uint32_t _bgnBlock, _endBlock;
+    bool _contiguous;
+    bool _reinit = false;   // Card was initialized again (lower clock), file position has to be set again
+    uint32_t _size;
+    uint32_t _pos = 0;
+    uint32_t _bufPos = 0;
+    uint32_t _bufLen = 0;
+    bool fill();
+};
 static volatile bool _tsFlag = false;
+static volatile uint32_t _tsIntTime = 0;
+static TaskHandle_t _tsTaskHandle = NULL;
 static void IRAM_ATTR tsInt()
 {
   _tsFlag = true;
+  _tsIntTime = millis();
+  if (_tsTaskHandle != NULL)
+  {
+    BaseType_t _woken = pdFALSE;
+    vTaskNotifyGiveFromISR(_tsTaskHandle, &_woken);
+    if (_woken) portYIELD_FROM_ISR();
+  }
 }
 
+// One sample from touchscreen controller: time of the interrupt (millis()), number of fingers and position of first two
+// fingers (in screen coordinates, with current rotation). Sample with 0 fingers means all fingers are released.
+struct touchEvent
+{
+  uint32_t time;
+  uint8_t fingers;
+  uint16_t x[2];
+  uint16_t y[2];
+};
+
+// Refresh statistics, collected while enabled with setRefreshStats(true). Time is in CPU cycles (ESP.getCycleCount()).
+// Power phases are counted also when einkOn() or einkOff() are called outside of refresh (e.g. by keep-alive timer).
+struct refreshStats
+{
+  uint32_t refreshes;                 // display() and partialUpdate() calls
+  uint32_t frames;                    // Frames, clean and data
+  uint32_t rows;                      // Rows latched into panel
+  uint32_t loadedRows;                // Rows with new data shifted into source driver
+  uint32_t i2cTransactions;           // I2C transactions during refreshes and power changes
+  uint32_t lastCycles;                // Duration of the last refresh
+  uint64_t cycles[REFRESH_PHASES];    // Time spent in each phase (REFRESH_PHASE_...)
+};
+
+// Coefficients of the energy model. Energy of refresh = driven pixels * pixelNj + frames * frameUj + refresh time *
+// (railsMw + backlightMw * brightness / 63, if backlight is on).
+struct energyModel
+{
+  float pixelNj;
+  float frameUj;
+  float railsMw;
+  float backlightMw;
+};
+
+// Energy counters, collected while enabled with setEnergyAccounting(true). Driven pixels are pixels driven black or
+// white in a frame (discharge and skip codes don't swing source outputs). Rail time includes keep-alive time.
+struct energyStats
+{
+  uint32_t refreshes;
+  uint32_t frames;
+  uint64_t drivenPixels;
+  uint64_t railsUs;         // Time panel rails were on (einkOn() to einkOff())
+  uint64_t backlightUs;     // Refresh time with backlight on, scaled to full brightness
+  float last;               // Estimated energy of the last refresh (mJ)
+  float total;              // Estimated energy of all counted activity with current model (mJ)
+};
+
+// One event in tracer ring buffer. Time is esp_timer time (us since boot, the same on both cores), 48 bits of it are
+// kept (enough for 8 years), so the event takes 12 bytes.
+struct traceEvent
+{
+  uint32_t timeLow;
+  uint16_t timeHigh;
+  uint8_t id;     // TRACE_...
+  char ph;        // 'B' begin, 'E' end, 'i' instant
+  uint8_t core;
+  uint8_t arg;
+};
+
 class Inkplate : public Adafruit_GFX {
   public:
     uint8_t* D_memory_new;
@@ -172,6 +408,8 @@ class Inkplate : public Adafruit_GFX {
     void clearDisplay();
     void display();
     void partialUpdate();
+    void partialUpdate(int16_t _y1, int16_t _y2);
+    void partialDiff(int16_t _y1, int16_t _y2);
 	void drawBitmap3Bit(int16_t _x, int16_t _y, const unsigned char* _p, int16_t _w, int16_t _h);
 	void setRotation(uint8_t);
     void einkOff(void);
@@ -181,17 +419,43 @@ class Inkplate : public Adafruit_GFX {
 	uint8_t getDisplayMode();
 	int drawBitmapFromSD(SdFile* p, int x, int y);
 	int drawBitmapFromSD(char* fileName, int x, int y);
-	int sdCardInit();
+	int drawBitmapFromSource(ImageSource* s, int x, int y);
+	int drawBitmapFromStream(Stream* s, int x, int y);
+	int drawBitmapFromBuffer(const uint8_t* p, uint32_t size, int x, int y);
+	bool slideshowBegin();
+	void slideshowEnd();
+	int displayAndPrefetch(char* fileName, int x, int y);
+	int sdCardInit(uint8_t _mhz = SD_DEFAULT_MHZ);
+	uint8_t getSdClock();
 	SdFat getSdFat();
 	SPIClass getSPI();
 	uint8_t getPanelState();
     void setPanelState(uint8_t);
+    void setPowerKeepAlive(uint32_t _ms);
+    uint32_t getPowerKeepAlive();
+    uint32_t getPowerCycles();
+    uint32_t getPowerCyclesAvoided();
+    void setSkipUnchanged(bool _on);
+    bool getSkipUnchanged();
+    uint32_t getRefreshesSkipped();
     int8_t readTemperature();
+    bool startTemperature();
+    bool collectTemperature();
+    int8_t getTemperature();
+    uint32_t getTemperatureTime();
     double readBattery();
+    bool batteryMonitorBegin(uint32_t _period = BATTERY_PERIOD_MS);
+    void batteryMonitorEnd();
+    uint32_t getBatteryTime();
 	void vscan_start();
 	void vscan_write();
 	void hscan_start(uint32_t _d = 0);
 	void vscan_end();
+	void skipRow();
+	void vscan_gap(uint16_t _us);
+	uint32_t getFrameStartTime();
+	void setFrameStartStaging(bool _on);
+	bool getFrameStartStaging();
     void cleanFast(uint8_t c, uint8_t rep);
     void pinsZstate();
     void pinsAsOutputs();
@@ -206,7 +470,35 @@ class Inkplate : public Adafruit_GFX {
 	uint16_t getINTstate();
 	void setPorts(uint16_t _d);
 	uint16_t getPorts();
+	void mcpBatchBegin();
+	void mcpBatchCommit();
     
+    // I2C bus manager public functions
+    bool i2cLock(uint8_t _prio = I2C_PRIO_NORMAL, uint32_t _timeout = portMAX_DELAY);
+    void i2cUnlock();
+    uint8_t i2cWrite(uint8_t _addr, const uint8_t *_d, uint8_t _n, uint8_t _prio = I2C_PRIO_NORMAL);
+    uint8_t i2cRead(uint8_t _addr, uint8_t *_d, uint8_t _n, uint8_t _prio = I2C_PRIO_NORMAL);
+    uint8_t i2cWriteRead(uint8_t _addr, const uint8_t *_w, uint8_t _wn, uint8_t *_r, uint8_t _rn, uint8_t _prio = I2C_PRIO_NORMAL);
+    void i2cSetClock(uint8_t _addr, uint32_t _clock);
+    uint32_t i2cGetClock(uint8_t _addr);
+    uint32_t i2cGetTransactions();
+
+    // Flash image store public functions
+    bool flashStoreBegin();
+    bool flashStoreFormat();
+    uint8_t flashStoreCount();
+    const char* flashStoreName(uint8_t _n);
+    int flashStoreFind(const char* _name);
+    bool flashStoreDraw(const char* _name);
+    bool flashStoreSave(const char* _name);
+    bool flashStoreWrite(const char* _name, uint8_t _mode, ImageSource* _s);
+    bool flashStoreRemove(const char* _name);
+
+    // Framebuffer upload public functions
+    bool uploadBegin(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _flags);
+    bool uploadWrite(const uint8_t *_d, uint32_t _n);
+    bool uploadEnd(bool _update);
+
     // Touchscreen public functions
     bool tsInit(uint8_t _pwrState);
     void tsShutdown();
@@ -214,33 +506,199 @@ class Inkplate : public Adafruit_GFX {
     void tsSetPowerState(uint8_t _s);
     uint8_t tsGetPowerState();
     uint8_t tsGetData(uint16_t *xPos, uint16_t *yPos);
+    bool tsEventsBegin();
+    void tsEventsEnd();
+    uint16_t tsGetEvents(touchEvent *_e, uint16_t _max);
+    uint32_t tsGetDroppedEvents();
+    void tsSetCalibration(const float *_k);
     
+    // Refresh statistics public functions
+    void setRefreshStats(bool _on);
+    bool getRefreshStatsEnabled();
+    void resetRefreshStats();
+    refreshStats getRefreshStats();
+    void printRefreshStats(Print &_p);
+
+    // Event tracer public functions
+    bool traceBegin(uint16_t _events = TRACE_DEFAULT_SIZE);
+    void traceEnd();
+    uint32_t traceDump(Print &_p);
+    uint32_t getTraceDropped();
+    static void traceWrite(uint8_t _id, char _ph, uint8_t _arg = 0);
+
+    // Energy accounting public functions
+    void setEnergyAccounting(bool _on);
+    void resetEnergyStats();
+    energyStats getEnergyStats();
+    void setEnergyModel(const energyModel &_m);
+    energyModel getEnergyModel();
+    bool calibrateEnergy(float _measuredMj);
+    float estimateRefreshEnergy(bool _partialRefresh, int16_t _y1 = 0, int16_t _y2 = E_INK_HEIGHT - 1);
+
     // Backlight public functions
     void setBacklight(uint8_t _v);
     void backlight(bool _e);
 
   private:
 	uint8_t mcpRegsInt[22], mcpRegsEx[22];
-    int8_t _temperature;
+	uint8_t _mcpSentInt[22], _mcpSentEx[22];  // Register values that are really written into I/O expanders
+	uint32_t _mcpDirtyInt = 0, _mcpDirtyEx = 0; // Registers changed while in batch mode (one bit per register)
+	uint8_t _mcpBatch = 0;
+    int8_t _temperature = 0;
+    uint32_t _temperatureTime = 0;
+    uint32_t _tempTimer = 0;
+    uint8_t _tempState = 0;     // 0 - idle, 1 - waiting for TPS65186 to wake up, 2 - conversion in progress
     uint8_t _panelOn = 0;
     uint8_t _rotation = 0;
     uint8_t _displayMode = 0; //By default, 1 bit mode is used
 	int sdCardOk = 0;
+	uint8_t _sdClock = SD_DEFAULT_MHZ;
+	uint8_t *_sdRawBuffer = NULL;
 	uint8_t _blockPartial = 1;
+	// Checksums of framebuffer rows shown on the panel, valid only after display() (cleanFast() with black or white
+	// clears it). Rows of current refresh that differ from them are marked in _rowChanged. _fullSumValid is set only
+	// while the panel shows what the last display() drove (no partialUpdate() since), display() skipping needs it.
+	uint32_t _rowSum[E_INK_HEIGHT];
+	uint8_t _rowChanged[(E_INK_HEIGHT + 7) / 8];
+	bool _rowSumValid = false;
+	bool _fullSumValid = false;
+	bool _skipUnchanged = false;
+	uint32_t _refreshesSkipped = 0;
+	bool _spvStage = VSCAN_STAGE_SPV;
+	uint8_t _spvStaged = 0;
+	uint16_t _spvLead = 0;     // Time of CKV set and SPV low write in the last staged frame start (us)
+	uint8_t _frameLock = 0;    // I2C bus is held from staged frame start in the gap until the end of vscan_start()
+	SemaphoreHandle_t _i2cMutex = NULL;
+	SemaphoreHandle_t _i2cGate = NULL;  // Held by high priority task while it waits for the bus
+	uint32_t _i2cClock = 0;
+	uint8_t _i2cDevAddr[I2C_MAX_DEVICES];
+	uint32_t _i2cDevClock[I2C_MAX_DEVICES];
+	uint8_t _i2cDevices = 0;
+	uint32_t _i2cTransactions = 0;
+	uint32_t _frameStartTime = 0;
+	uint32_t _frameStarts = 0;
 	uint8_t _beginDone = 0;
+
+	// Battery monitor
+	esp_adc_cal_characteristics_t _adcChars;
+	uint8_t _adcReady = 0;
+	TaskHandle_t _batteryTask = NULL;
+	volatile uint8_t _batteryStop = 0;
+	uint32_t _batteryPeriod = BATTERY_PERIOD_MS;
+	volatile uint32_t _batteryUv = 0;    // Filtered voltage in uV (32 bit, so it's read and written in one access)
+	volatile uint32_t _batteryTime = 0;
+
+	// Panel power keep-alive (rails stay up for a while after refresh, so next refresh doesn't have to power them up again)
+	SemaphoreHandle_t _panelMutex = NULL;
+	esp_timer_handle_t _keepAliveTimer = NULL;
+	TaskHandle_t _keepAliveTask = NULL;    // Turns the panel off when timer expires (timer callback only notifies it)
+	volatile bool _keepAliveExpired = false;
+	uint32_t _keepAlive = 0;
+	uint32_t _powerCycles = 0;
+	uint32_t _powerCyclesAvoided = 0;
+
+	// Refresh statistics (phase that runs now, when it started and when the refresh started)
+	refreshStats _stats = {};
+	bool _statsOn = false;
+	uint8_t _statsPhase = REFRESH_PHASE_IDLE;
+	uint8_t _statsKind = 0;
+	uint32_t _statsStamp = 0;
+	uint32_t _statsStart = 0;
+	uint32_t _statsI2c = 0;
+
+	// Energy accounting (counters at the start of current refresh, time rails were turned on, backlight state)
+	energyStats _energyStats = {};
+	energyModel _energyModel = {ENERGY_PIXEL_NJ, ENERGY_FRAME_UJ, ENERGY_RAILS_MW, ENERGY_BACKLIGHT_MW};
+	bool _energyOn = false;
+	uint64_t _energyRefPixels = 0;
+	uint32_t _energyRefFrames = 0;
+	uint32_t _energyRefStart = 0;
+	uint32_t _energyRailsOn = 0;
+	uint32_t _energyTime[3] = {0, 0, 0};   // Duration of the last refresh of each kind (us)
+	uint8_t _backlightOn = 0;
+	uint8_t _backlightLevel = 0;
+
+	// Event tracer (static, so it can be used by image sources too)
+	static traceEvent *_traceBuf;
+	static uint16_t _traceMask;
+	static uint32_t _traceCount;
+	static uint32_t _traceDropped;
+	static portMUX_TYPE _traceMux;
+
+	// Framebuffer upload (destination region, position inside it and state of PackBits decoder)
+	uint8_t *_upRow = NULL;
+	uint16_t _upStride = 0;
+	uint16_t _upCol = 0;
+	uint32_t _upLeft = 0;
+	int16_t _upY = 0, _upH = 0;
+	uint8_t _upFlags = 0;
+	uint8_t _upState = 0;   // 0 - run header, 1 - literal bytes, 2 - byte to repeat
+	uint8_t _upCount = 0;
+	uint8_t _upOverflow = 0;
+
+	// Slideshow prefetch (decoding next image on the other core while current one is refreshed)
+	uint8_t *_spareBuffer = NULL;
+	uint8_t _spareMode = 0;
+	TaskHandle_t _prefetchTask = NULL;
+	SemaphoreHandle_t _prefetchStart = NULL;
+	SemaphoreHandle_t _prefetchDone = NULL;
+	char _prefetchName[256];
+	int _prefetchX, _prefetchY;
+	volatile int _prefetchResult = 0;
+	volatile bool _prefetchExit = false;
+	volatile bool _prefetchExited = false;
     
+    // Flash image store private variables
+    struct flashStoreEntry {
+        char name[FLASH_STORE_NAME_LEN];
+        uint32_t offset;
+        uint32_t size;
+        uint32_t slot;
+        uint8_t mode;
+        uint8_t reserved[3];
+    };
+    struct flashStoreDirectory {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;
+        uint32_t seq;       // Copy with higher sequence number is the current one
+        uint32_t check;     // Checksum of the directory (computed with check set to 0)
+        flashStoreEntry entry[FLASH_STORE_MAX_IMAGES];
+    };
+    const esp_partition_t *_flashStore = NULL;
+    flashStoreDirectory *_flashDir = NULL;
+    uint8_t _flashDirSector = 0;    // Sector (0 or 1) that holds the current directory
+
     // Touchscreen private variables
     const char hello_packet[4] = {0x55, 0x55, 0x55, 0x55};
-    uint16_t _tsXResolution;
-    uint16_t _tsYResolution;
+    uint16_t _tsXResolution = 0;
+    uint16_t _tsYResolution = 0;
+    int32_t _tsMatrix[6] = {0};
+    float _tsCal[6] = {1, 0, 0, 0, 1, 0};
+    // Touch events ring buffer, written only by touch task and read only by the application (no locks needed)
+    touchEvent _tsQueue[TS_QUEUE_SIZE];
+    volatile uint16_t _tsHead = 0;
+    volatile uint16_t _tsTail = 0;
+    volatile uint8_t _tsStop = 0;
+    uint32_t _tsDropped = 0;
 	
-	void display1b();
-    void display3b();
+	void display1b(uint8_t *_fb = NULL);
+    void display3b(uint8_t *_fb = NULL);
+    static void prefetchTask(void *_p);
+    static void keepAliveCallback(void *_p);
+    static void keepAliveTask(void *_p);
+    void keepAliveOff();
+    static void batteryTask(void *_p);
+    double sampleBattery();
+    void panelBegin();
+    void panelEnd();
+    int prefetchImage();
 	uint32_t read32(uint8_t* c);
 	uint16_t read16(uint8_t* c);
-	void readBmpHeader(SdFile *_f, struct bitmapHeader *_h);
-	int drawMonochromeBitmap(SdFile *f, struct bitmapHeader bmpHeader, int x, int y);
-	int drawGrayscaleBitmap24(SdFile *f, struct bitmapHeader bmpHeader, int x, int y);
+	bool readBmpHeader(ImageSource *_s, struct bitmapHeader *_h);
+	int drawBitmap(ImageSource *_s, int x, int y, bool _changeMode);
+	int drawMonochromeBitmap(ImageSource *s, struct bitmapHeader bmpHeader, int x, int y);
+	int drawGrayscaleBitmap24(ImageSource *s, struct bitmapHeader bmpHeader, int x, int y);
 	
 	bool mcpBegin(uint8_t _addr, uint8_t* _r);
 	void readMCPRegisters(uint8_t _addr, uint8_t *k);
@@ -259,7 +717,31 @@ class Inkplate : public Adafruit_GFX {
 	uint16_t getINTstateInternal(uint8_t _addr, uint8_t* _r);
 	void setPortsInternal(uint8_t _addr, uint8_t* _r, uint16_t _d);
 	uint16_t getPortsInternal(uint8_t _addr, uint8_t* _r);
+	void mcpFlush(uint8_t _addr, uint8_t* _r, uint8_t* _sent, uint32_t* _dirty);
+	void mcpMarkDirty(uint8_t _addr, uint8_t _regName, uint8_t _n);
+	void spvWrite(uint8_t _state);
+	void i2cSelectClock(uint8_t _addr);
+	bool waitPowerGood(uint8_t _pg);
+	uint32_t rowChecksum(const uint8_t *_p, uint16_t _n);
+	uint16_t rowSumUpdate(const uint8_t *_fb, uint16_t _rowBytes, int16_t _y1, int16_t _y2);
+	bool rowChanged(int16_t _y);
+	uint8_t statsPhase(uint8_t _p);
+	void statsRefreshBegin(uint8_t _kind);
+	void statsRefreshEnd();
+	uint32_t energyCountBits(const uint8_t *_p, const uint8_t *_x, uint32_t _n);
+	uint64_t energyPixels(uint8_t _kind, const uint8_t *_fb, int16_t _y1, int16_t _y2);
+	float energyOf(uint64_t _pixels, uint32_t _frames, uint32_t _us, uint64_t _backlightUs);
     
+    // Flash image store private functions
+    bool flashStoreReadDirectory(uint8_t _sector, flashStoreDirectory *_d);
+    bool flashStoreWriteDirectory();
+    uint32_t flashStoreAlloc(uint32_t _slot);
+    bool flashStorePrepare(const char* _name, uint8_t _mode, flashStoreEntry *_e);
+    bool flashStoreCommit(flashStoreEntry *_e);
+
+    // Framebuffer upload private functions
+    void uploadPut(uint8_t _b);
+
     // Touchscreen private functions
     uint8_t tsWriteRegs(uint8_t _addr, const uint8_t *_buff, uint8_t _size);
     void tsReadRegs(uint8_t _addr, uint8_t *_buff, uint8_t _size);
@@ -267,6 +749,9 @@ class Inkplate : public Adafruit_GFX {
     bool tsSoftwareReset();
     void tsGetRawData(uint8_t *b);
     void tsGetXY(uint8_t *_d, uint16_t *x, uint16_t *y);
+    uint8_t tsConvert(uint8_t *_raw, uint16_t *xPos, uint16_t *yPos);
+    void tsUpdateMatrix();
+    static void tsTask(void *_p);
     void tsGetResolution(uint16_t *xRes, uint16_t *yRes);
 };
 
@@ -0,0 +1,204 @@
+/***************************************************
+Touch gesture recognizer for Inkplate6Plus.
+See InkplateGesture.h for description.
+ ****************************************************/
+
+#include "InkplateGesture.h"
+
+// States of the recognizer
+#define STATE_IDLE   0
+#define STATE_DOWN   1 // One finger down, not moved yet (tap or long press)
+#define STATE_MOVING 2 // One finger down and moved (swipe)
+#define STATE_HELD   3 // Long press already reported, wait for release
+#define STATE_PINCH  4 // Two fingers down, wait for release of all fingers after that
+
+InkplateGesture::InkplateGesture()
+{
+    reset();
+}
+
+void InkplateGesture::reset()
+{
+    _state = STATE_IDLE;
+    _tapPending = 0;
+    _queued = 0;
+}
+
+void InkplateGesture::setTap(uint16_t _move, uint16_t _time)
+{
+    _tapMove = _move;
+    _tapMaxTime = _time;
+}
+
+// Time in which second tap has to come to make double tap. 0 disables double tap (tap is reported right away).
+void InkplateGesture::setDoubleTapTime(uint16_t _time)
+{
+    _doubleTapTime = _time;
+}
+
+void InkplateGesture::setLongPressTime(uint16_t _time)
+{
+    _longPressTime = _time;
+}
+
+void InkplateGesture::setSwipe(uint16_t _distance, uint16_t _time)
+{
+    _swipeDistance = _distance;
+    _swipeTime = _time;
+}
+
+// Relative change of distance between fingers that is reported as one pinch step (0.2 = 20%).
+void InkplateGesture::setPinchStep(float _step)
+{
+    _pinchStep = _step;
+}
+
+uint32_t InkplateGesture::dist2(int32_t _dx, int32_t _dy)
+{
+    return (uint32_t)(_dx * _dx) + (uint32_t)(_dy * _dy);
+}
+
+void InkplateGesture::emit(gestureEvent *_g, uint8_t _type, uint16_t _x, uint16_t _y, uint32_t _time)
+{
+    _g->type = _type;
+    _g->x = _x;
+    _g->y = _y;
+    _g->dx = 0;
+    _g->dy = 0;
+    _g->scale = 1.0;
+    _g->time = _time;
+}
+
+// Single tap is reported only when double tap time expires without second tap.
+bool InkplateGesture::pendingTap(uint32_t _now, gestureEvent *_g)
+{
+    if (!_tapPending || (_now - _tapTime) < _doubleTapTime) return false;
+    _tapPending = 0;
+    emit(_g, GESTURE_TAP, _tapX, _tapY, _tapTime);
+    return true;
+}
+
+// Feeds one touch sample. Returns true and fills _g if the sample completed a gesture. If the sample completes a gesture
+// and also ends the wait for double tap, tap is returned first and the other gesture on the next feed() or update().
+bool InkplateGesture::feed(const touchEvent &_e, gestureEvent *_g)
+{
+    if (_queued)
+    {
+        // Gesture from the previous sample is returned now, gesture from this one is queued in its place.
+        *_g = _queue;
+        _queued = recognize(_e, &_queue);
+        return true;
+    }
+    if (!pendingTap(_e.time, _g)) return recognize(_e, _g);
+    _queued = recognize(_e, &_queue);
+    return true;
+}
+
+// Runs the state machine for one sample (pending tap is already handled).
+bool InkplateGesture::recognize(const touchEvent &_e, gestureEvent *_g)
+{
+    if (_e.fingers >= 2)
+    {
+        uint32_t _d = dist2(_e.x[1] - _e.x[0], _e.y[1] - _e.y[0]);
+        if (_state != STATE_PINCH)
+        {
+            _state = STATE_PINCH;
+            _pinchRef = _d;
+            return false;
+        }
+        if (_pinchRef == 0) return false;
+        float _scale = sqrtf((float)_d / _pinchRef);
+        if (_scale < 1.0 - _pinchStep || _scale > 1.0 + _pinchStep)
+        {
+            emit(_g, _scale > 1.0 ? GESTURE_PINCH_OUT : GESTURE_PINCH_IN, (_e.x[0] + _e.x[1]) / 2, (_e.y[0] + _e.y[1]) / 2, _e.time);
+            _g->scale = _scale;
+            _pinchRef = _d;
+            return true;
+        }
+        return false;
+    }
+
+    if (_e.fingers == 1)
+    {
+        _lastX = _e.x[0];
+        _lastY = _e.y[0];
+        if (_state == STATE_IDLE)
+        {
+            _state = STATE_DOWN;
+            _startX = _lastX;
+            _startY = _lastY;
+            _startTime = _e.time;
+        }
+        else if (_state == STATE_DOWN && dist2(_lastX - _startX, _lastY - _startY) > (uint32_t)_tapMove * _tapMove)
+        {
+            _state = STATE_MOVING;
+        }
+        return longPress(_e.time, _g);
+    }
+
+    // All fingers released
+    uint8_t _last = _state;
+    _state = STATE_IDLE;
+    uint32_t _duration = _e.time - _startTime;
+
+    if (_last == STATE_DOWN && _duration <= _tapMaxTime)
+    {
+        if (_tapPending && dist2(_startX - _tapX, _startY - _tapY) <= (uint32_t)_tapMove * _tapMove * 4)
+        {
+            _tapPending = 0;
+            emit(_g, GESTURE_DOUBLE_TAP, _startX, _startY, _e.time);
+            return true;
+        }
+        if (_doubleTapTime == 0)
+        {
+            emit(_g, GESTURE_TAP, _startX, _startY, _e.time);
+            return true;
+        }
+        _tapPending = 1;
+        _tapX = _startX;
+        _tapY = _startY;
+        _tapTime = _e.time;
+        return false;
+    }
+
+    if (_last == STATE_MOVING && _duration <= _swipeTime)
+    {
+        int16_t _dx = _lastX - _startX;
+        int16_t _dy = _lastY - _startY;
+        if (dist2(_dx, _dy) < (uint32_t)_swipeDistance * _swipeDistance) return false;
+        uint8_t _type;
+        if (abs(_dx) > abs(_dy))
+            _type = _dx > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT;
+        else
+            _type = _dy > 0 ? GESTURE_SWIPE_DOWN : GESTURE_SWIPE_UP;
+        emit(_g, _type, _startX, _startY, _e.time);
+        _g->dx = _dx;
+        _g->dy = _dy;
+        return true;
+    }
+    return false;
+}
+
+// Reports gestures that depend only on time (long press, single tap). _now is current millis().
+bool InkplateGesture::update(uint32_t _now, gestureEvent *_g)
+{
+    if (_queued)
+    {
+        _queued = 0;
+        *_g = _queue;
+        return true;
+    }
+    if (pendingTap(_now, _g)) return true;
+    return longPress(_now, _g);
+}
+
+bool InkplateGesture::longPress(uint32_t _now, gestureEvent *_g)
+{
+    if (_state == STATE_DOWN && (_now - _startTime) >= _longPressTime)
+    {
+        _state = STATE_HELD;
+        emit(_g, GESTURE_LONG_PRESS, _startX, _startY, _now);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,88 @@
+/***************************************************
+Touch gesture recognizer for Inkplate6Plus.
+
+Incremental state machine that is fed with touch samples (touchEvent, see tsGetEvents()) and turns them into gestures:
+tap, double tap, long press, swipe (left, right, up, down) and two finger pinch (in, out). It doesn't allocate memory
+or wait for anything, time is taken from the samples themselves. Some gestures are recognized only after some time
+without new samples (long press while finger still holds the screen, single tap when double tap time expires), so
+update() should be called from loop() as well.
+ ****************************************************/
+
+#ifndef __INKPLATEGESTURE_H__
+#define __INKPLATEGESTURE_H__
+
+#include "Inkplate6Plus.h"
+
+#define GESTURE_NONE        0
+#define GESTURE_TAP         1
+#define GESTURE_DOUBLE_TAP  2
+#define GESTURE_LONG_PRESS  3
+#define GESTURE_SWIPE_LEFT  4
+#define GESTURE_SWIPE_RIGHT 5
+#define GESTURE_SWIPE_UP    6
+#define GESTURE_SWIPE_DOWN  7
+#define GESTURE_PINCH_IN    8
+#define GESTURE_PINCH_OUT   9
+
+// Default thresholds (distances in pixels, times in milliseconds)
+#define GESTURE_TAP_MOVE        20
+#define GESTURE_TAP_TIME        300
+#define GESTURE_DOUBLE_TAP_TIME 350
+#define GESTURE_LONG_PRESS_TIME 800
+#define GESTURE_SWIPE_DISTANCE  120
+#define GESTURE_SWIPE_TIME      1000
+#define GESTURE_PINCH_STEP      0.2
+
+// Recognized gesture. x and y are position where gesture started (center between fingers for pinch), dx and dy movement
+// for swipe and scale is change of distance between fingers for pinch (>1 for pinch out).
+struct gestureEvent
+{
+    uint8_t type;
+    uint16_t x;
+    uint16_t y;
+    int16_t dx;
+    int16_t dy;
+    float scale;
+    uint32_t time;
+};
+
+class InkplateGesture {
+  public:
+    InkplateGesture();
+    void reset();
+    bool feed(const touchEvent &_e, gestureEvent *_g);
+    bool update(uint32_t _now, gestureEvent *_g);
+    void setTap(uint16_t _move, uint16_t _time);
+    void setDoubleTapTime(uint16_t _time);
+    void setLongPressTime(uint16_t _time);
+    void setSwipe(uint16_t _distance, uint16_t _time);
+    void setPinchStep(float _step);
+
+  private:
+    uint8_t _state;
+    uint16_t _startX, _startY;
+    uint16_t _lastX, _lastY;
+    uint32_t _startTime;
+    uint32_t _pinchRef;
+    uint8_t _tapPending;
+    uint16_t _tapX, _tapY;
+    uint32_t _tapTime;
+    uint8_t _queued;            // Gesture completed by the same sample that reported pending tap, returned next time
+    gestureEvent _queue;
+
+    uint16_t _tapMove = GESTURE_TAP_MOVE;
+    uint16_t _tapMaxTime = GESTURE_TAP_TIME;
+    uint16_t _doubleTapTime = GESTURE_DOUBLE_TAP_TIME;
+    uint16_t _longPressTime = GESTURE_LONG_PRESS_TIME;
+    uint16_t _swipeDistance = GESTURE_SWIPE_DISTANCE;
+    uint16_t _swipeTime = GESTURE_SWIPE_TIME;
+    float _pinchStep = GESTURE_PINCH_STEP;
+
+    void emit(gestureEvent *_g, uint8_t _type, uint16_t _x, uint16_t _y, uint32_t _time);
+    bool pendingTap(uint32_t _now, gestureEvent *_g);
+    bool recognize(const touchEvent &_e, gestureEvent *_g);
+    bool longPress(uint32_t _now, gestureEvent *_g);
+    static uint32_t dist2(int32_t _dx, int32_t _dy);
+};
+
+#endif
@@ -0,0 +1,352 @@
+/***************************************************
+Binary slave mode protocol for Inkplate6Plus.
+See InkplateSlaveProtocol.h for frame format and list of commands.
+ ****************************************************/
+
+#include "InkplateSlave.h"
+
+// Size of arguments of every command (0xFF for commands with string argument, size of fixed part is checked separately)
+static const uint8_t argSize[] = {
+    0,  5,  9,  7,  7,  9,  7,  13, 11, 9,  7,  13, 11, // echo ... fillRoundRect
+    0xFF, 1, 4, 1, 1, 0xFF,                            // print, setTextSize, setCursor, setTextWrap, setRotation, drawBitmap
+    1,  0,  0,  0,  0,  0,  0,  1,  0,                 // setDisplayMode ... getPanelState
+    9,  0xFF, 1, 4,                                    // uploadBegin, uploadData, uploadEnd, partialUpdate(y1, y2)
+};
+
+InkplateSlave::InkplateSlave(Inkplate &_display, Stream &_s)
+{
+    _ink = &_display;
+    _stream = &_s;
+}
+
+uint32_t InkplateSlave::getFrames()
+{
+    return _frames;
+}
+
+// Number of frames with wrong CRC or length and bytes dropped while looking for the sync byte.
+uint32_t InkplateSlave::getErrors()
+{
+    return _errors;
+}
+
+uint16_t InkplateSlave::used()
+{
+    return (_head - _tail) & (SLAVE_RING_SIZE - 1);
+}
+
+uint8_t InkplateSlave::at(uint16_t _off)
+{
+    return _ring[(_tail + _off) & (SLAVE_RING_SIZE - 1)];
+}
+
+void InkplateSlave::drop(uint16_t _n)
+{
+    _tail = (_tail + _n) & (SLAVE_RING_SIZE - 1);
+}
+
+uint16_t InkplateSlave::crc16(uint16_t _crc, uint8_t _b)
+{
+    _crc ^= (uint16_t)_b << 8;
+    for (int i = 0; i < 8; i++)
+        _crc = (_crc & 0x8000) ? (_crc << 1) ^ 0x1021 : (_crc << 1);
+    return _crc;
+}
+
+// Reads everything that is available from the stream into the ring buffer and runs all complete frames in it.
+// Call it from loop() as often as possible.
+void InkplateSlave::poll()
+{
+    while (true)
+    {
+        int _avail = _stream->available();
+        uint16_t _free = SLAVE_RING_SIZE - 1 - used();
+        if (_avail <= 0 || _free == 0) break;
+        uint16_t _n = _free < _avail ? _free : _avail;
+        if (_n > SLAVE_RING_SIZE - _head) _n = SLAVE_RING_SIZE - _head;
+        _n = _stream->readBytes(&_ring[_head], _n);
+        if (_n == 0) break;
+        _head = (_head + _n) & (SLAVE_RING_SIZE - 1);
+    }
+
+    while (true)
+    {
+        while (used() && at(0) != SLAVE_SYNC)
+        {
+            drop(1);
+            _errors++;
+        }
+        if (used() < 3) return;
+        uint16_t _len = at(1) | (at(2) << 8);
+        if (_len > SLAVE_MAX_PAYLOAD)
+        {
+            drop(1);
+            _errors++;
+            continue;
+        }
+        if (used() < _len + 5) return;
+
+        uint16_t _crc = 0xFFFF;
+        for (int i = 1; i < _len + 3; i++)
+            _crc = crc16(_crc, at(i));
+        if (_crc != (at(_len + 3) | (at(_len + 4) << 8)))
+        {
+            const uint8_t _nak[] = {SLAVE_NAK, SLAVE_ERR_CRC};
+            sendFrame(_nak, 2);
+            drop(1);
+            _errors++;
+            continue;
+        }
+
+        _pos = (_tail + 3) & (SLAVE_RING_SIZE - 1);
+        _left = _len;
+        _respLen = 0;
+        runFrame();
+        if (_respLen) sendFrame(_resp, _respLen);
+        drop(_len + 5);
+        _frames++;
+    }
+}
+
+uint8_t InkplateSlave::get8()
+{
+    uint8_t _b = _ring[_pos];
+    _pos = (_pos + 1) & (SLAVE_RING_SIZE - 1);
+    _left--;
+    return _b;
+}
+
+int16_t InkplateSlave::get16()
+{
+    uint8_t _l = get8();
+    return (int16_t)(_l | (get8() << 8));
+}
+
+bool InkplateSlave::need(uint16_t _n)
+{
+    return _left >= _n;
+}
+
+void InkplateSlave::skip(uint16_t _n)
+{
+    _pos = (_pos + _n) & (SLAVE_RING_SIZE - 1);
+    _left -= _n;
+}
+
+bool InkplateSlave::runFrame()
+{
+    while (_left)
+    {
+        uint8_t _op = get8();
+        uint8_t _err = 0;
+        if (_op >= sizeof(argSize))
+            _err = SLAVE_ERR_OPCODE;
+        else if (!need(argSize[_op] == 0xFF ? 2 : argSize[_op]) || !runCommand(_op))
+            _err = SLAVE_ERR_LENGTH;
+        if (_err)
+        {
+            const uint8_t _d[] = {_err, _op};
+            respond(SLAVE_NAK & ~SLAVE_RESPONSE, _d, 2);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs one command, its fixed size arguments are already checked. Returns false if string argument doesn't fit into
+// the frame.
+bool InkplateSlave::runCommand(uint8_t _op)
+{
+    int16_t a[7];
+    uint8_t _r[2];
+    switch (_op)
+    {
+    case SLAVE_ECHO:
+        respond(_op, NULL, 0);
+        break;
+
+    case SLAVE_DRAW_PIXEL:
+        a[0] = get16();
+        a[1] = get16();
+        _ink->drawPixel(a[0], a[1], get8());
+        break;
+
+    case SLAVE_DRAW_LINE:
+    case SLAVE_DRAW_RECT:
+    case SLAVE_FILL_RECT:
+        for (int i = 0; i < 4; i++) a[i] = get16();
+        if (_op == SLAVE_DRAW_LINE) _ink->drawLine(a[0], a[1], a[2], a[3], get8());
+        if (_op == SLAVE_DRAW_RECT) _ink->drawRect(a[0], a[1], a[2], a[3], get8());
+        if (_op == SLAVE_FILL_RECT) _ink->fillRect(a[0], a[1], a[2], a[3], get8());
+        break;
+
+    case SLAVE_DRAW_FAST_VLINE:
+    case SLAVE_DRAW_FAST_HLINE:
+    case SLAVE_DRAW_CIRCLE:
+    case SLAVE_FILL_CIRCLE:
+        for (int i = 0; i < 3; i++) a[i] = get16();
+        if (_op == SLAVE_DRAW_FAST_VLINE) _ink->drawFastVLine(a[0], a[1], a[2], get8());
+        if (_op == SLAVE_DRAW_FAST_HLINE) _ink->drawFastHLine(a[0], a[1], a[2], get8());
+        if (_op == SLAVE_DRAW_CIRCLE) _ink->drawCircle(a[0], a[1], a[2], get8());
+        if (_op == SLAVE_FILL_CIRCLE) _ink->fillCircle(a[0], a[1], a[2], get8());
+        break;
+
+    case SLAVE_DRAW_TRIANGLE:
+    case SLAVE_FILL_TRIANGLE:
+        for (int i = 0; i < 6; i++) a[i] = get16();
+        if (_op == SLAVE_DRAW_TRIANGLE) _ink->drawTriangle(a[0], a[1], a[2], a[3], a[4], a[5], get8());
+        if (_op == SLAVE_FILL_TRIANGLE) _ink->fillTriangle(a[0], a[1], a[2], a[3], a[4], a[5], get8());
+        break;
+
+    case SLAVE_DRAW_ROUND_RECT:
+    case SLAVE_FILL_ROUND_RECT:
+        for (int i = 0; i < 5; i++) a[i] = get16();
+        if (_op == SLAVE_DRAW_ROUND_RECT) _ink->drawRoundRect(a[0], a[1], a[2], a[3], a[4], get8());
+        if (_op == SLAVE_FILL_ROUND_RECT) _ink->fillRoundRect(a[0], a[1], a[2], a[3], a[4], get8());
+        break;
+
+    case SLAVE_PRINT:
+        a[0] = get16();
+        if (!need((uint16_t)a[0])) return false;
+        // Characters are printed straight from the ring buffer
+        for (int i = 0; i < (uint16_t)a[0]; i++) _ink->write(get8());
+        break;
+
+    case SLAVE_SET_TEXT_SIZE:
+        _ink->setTextSize(get8());
+        break;
+
+    case SLAVE_SET_CURSOR:
+        a[0] = get16();
+        _ink->setCursor(a[0], get16());
+        break;
+
+    case SLAVE_SET_TEXT_WRAP:
+        _ink->setTextWrap(get8() != 0);
+        break;
+
+    case SLAVE_SET_ROTATION:
+        _ink->setRotation(get8() & 3);
+        break;
+
+    case SLAVE_DRAW_BITMAP:
+    {
+        if (!need(6)) return false;
+        a[0] = get16();
+        a[1] = get16();
+        a[2] = get16();
+        char _path[128];
+        if ((uint16_t)a[2] >= sizeof(_path) || !need(a[2])) return false;
+        for (int i = 0; i < a[2]; i++) _path[i] = get8();
+        _path[a[2]] = 0;
+        int8_t _res = _ink->sdCardInit() ? _ink->drawBitmapFromSD(_path, a[0], a[1]) : -1;
+        respond(_op, (uint8_t *)&_res, 1);
+        break;
+    }
+
+    case SLAVE_SET_DISPLAY_MODE:
+        _ink->selectDisplayMode(get8() ? INKPLATE_3BIT : INKPLATE_1BIT);
+        break;
+
+    case SLAVE_GET_DISPLAY_MODE:
+        _r[0] = _ink->getDisplayMode();
+        respond(_op, _r, 1);
+        break;
+
+    case SLAVE_CLEAR_DISPLAY:
+        _ink->clearDisplay();
+        break;
+
+    case SLAVE_DISPLAY:
+        _ink->display();
+        break;
+
+    case SLAVE_PARTIAL_UPDATE:
+        _ink->partialUpdate();
+        break;
+
+    case SLAVE_READ_TEMPERATURE:
+        _r[0] = _ink->readTemperature();
+        respond(_op, _r, 1);
+        break;
+
+    case SLAVE_READ_BATTERY:
+    {
+        uint16_t _mv = _ink->readBattery() * 1000;
+        _r[0] = _mv & 0xFF;
+        _r[1] = _mv >> 8;
+        respond(_op, _r, 2);
+        break;
+    }
+
+    case SLAVE_PANEL_SUPPLY:
+        if (get8())
+            _ink->einkOn();
+        else
+            _ink->einkOff();
+        break;
+
+    case SLAVE_GET_PANEL_STATE:
+        _r[0] = _ink->getPanelState();
+        respond(_op, _r, 1);
+        break;
+
+    case SLAVE_UPLOAD_BEGIN:
+        for (int i = 0; i < 4; i++) a[i] = get16();
+        _r[0] = _ink->uploadBegin(a[0], a[1], a[2], a[3], get8());
+        respond(_op, _r, 1);
+        break;
+
+    case SLAVE_UPLOAD_DATA:
+    {
+        uint16_t _n = get16();
+        if (!need(_n)) return false;
+        // Data goes straight from the ring buffer, in two parts if it wraps around the end of the buffer
+        uint16_t _first = SLAVE_RING_SIZE - _pos;
+        if (_first > _n) _first = _n;
+        _ink->uploadWrite(&_ring[_pos], _first);
+        _ink->uploadWrite(_ring, _n - _first);
+        skip(_n);
+        break;
+    }
+
+    case SLAVE_UPLOAD_END:
+        _r[0] = _ink->uploadEnd(get8() != 0);
+        respond(_op, _r, 1);
+        break;
+
+    case SLAVE_PARTIAL_ROWS:
+        a[0] = get16();
+        _ink->partialUpdate(a[0], get16());
+        break;
+    }
+    return true;
+}
+
+// Adds result of one command to the response frame. Full response frame is sent right away and new one is started.
+void InkplateSlave::respond(uint8_t _op, const uint8_t *_d, uint8_t _n)
+{
+    if (_respLen + 1 + _n > SLAVE_RESPONSE_SIZE)
+    {
+        sendFrame(_resp, _respLen);
+        _respLen = 0;
+    }
+    _resp[_respLen++] = _op | SLAVE_RESPONSE;
+    memcpy(_resp + _respLen, _d, _n);
+    _respLen += _n;
+}
+
+void InkplateSlave::sendFrame(const uint8_t *_d, uint16_t _n)
+{
+    uint8_t _h[3] = {SLAVE_SYNC, (uint8_t)(_n & 0xFF), (uint8_t)(_n >> 8)};
+    uint16_t _crc = 0xFFFF;
+    _crc = crc16(_crc, _h[1]);
+    _crc = crc16(_crc, _h[2]);
+    for (int i = 0; i < _n; i++)
+        _crc = crc16(_crc, _d[i]);
+    uint8_t _c[2] = {(uint8_t)(_crc & 0xFF), (uint8_t)(_crc >> 8)};
+    _stream->write(_h, 3);
+    _stream->write(_d, _n);
+    _stream->write(_c, 2);
+    _stream->flush();
+}
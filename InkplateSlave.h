@@ -0,0 +1,54 @@
+/***************************************************
+Binary slave mode protocol for Inkplate6Plus.
+
+Host sends frames over any Stream (usually Serial), received bytes are kept in a ring buffer and commands are run
+straight from it (no copying, no text parsing). Frame format and list of commands are in InkplateSlaveProtocol.h.
+Commands are only read from the Stream in poll(), so while a command runs (e.g. display refresh) the Stream has to buffer
+as many bytes as the host may send unconfirmed. With Serial, call Serial.setRxBufferSize(SLAVE_RING_SIZE) before
+Serial.begin(), or limit the window of the host (InkplateClient::setWindow()) to the RX buffer size.
+ ****************************************************/
+
+#ifndef __INKPLATESLAVE_H__
+#define __INKPLATESLAVE_H__
+
+#include "Inkplate6Plus.h"
+#include "InkplateSlaveProtocol.h"
+
+class InkplateSlave {
+  public:
+    InkplateSlave(Inkplate &_display, Stream &_s);
+    void poll();
+    uint32_t getFrames();
+    uint32_t getErrors();
+
+  private:
+    Inkplate *_ink;
+    Stream *_stream;
+    uint8_t _ring[SLAVE_RING_SIZE];
+    uint16_t _head = 0;
+    uint16_t _tail = 0;
+    uint32_t _frames = 0;
+    uint32_t _errors = 0;
+
+    // Position of the command parser inside the ring buffer and end of the current frame payload
+    uint16_t _pos;
+    uint16_t _left;
+
+    uint8_t _resp[SLAVE_RESPONSE_SIZE];
+    uint16_t _respLen;
+
+    uint16_t used();
+    uint8_t at(uint16_t _off);
+    void drop(uint16_t _n);
+    bool runFrame();
+    bool runCommand(uint8_t _op);
+    uint8_t get8();
+    int16_t get16();
+    bool need(uint16_t _n);
+    void skip(uint16_t _n);
+    void respond(uint8_t _op, const uint8_t *_d, uint8_t _n);
+    void sendFrame(const uint8_t *_d, uint16_t _n);
+    static uint16_t crc16(uint16_t _crc, uint8_t _b);
+};
+
+#endif
@@ -0,0 +1,109 @@
+/***************************************************
+Binary slave mode protocol for Inkplate6Plus (definitions shared by InkplateSlave and host side clients).
+
+Host sends frames over any Stream (usually Serial), received bytes are kept in a ring buffer and commands are run
+straight from it (no copying, no text parsing).
+
+Frame (all values are little endian):
+  0   uint8_t  sync byte 0xA5
+  1   uint16_t payload length (max SLAVE_MAX_PAYLOAD)
+  3   payload  one or more commands, one after another
+  n   uint16_t CRC16-CCITT (poly 0x1021, init 0xFFFF) of length and payload
+Every command is opcode (uint8_t) followed by its arguments. Coordinates and sizes are int16_t, colors and flags uint8_t,
+strings are uint16_t length followed by characters (not zero terminated).
+
+Commands that return something add opcode | 0x80 and result to the response frame (same format as request frame) that
+is sent when the whole request frame is done. If frame has wrong CRC, response is SLAVE_NAK with reason SLAVE_ERR_CRC,
+unknown opcode or command that doesn't fit into the frame stops the frame and responds with SLAVE_NAK, reason and opcode.
+
+  0x00 echo                                       -> 0x80
+  0x01 drawPixel       x, y, c
+  0x02 drawLine        x1, y1, x2, y2, c
+  0x03 drawFastVLine   x, y, l, c
+  0x04 drawFastHLine   x, y, l, c
+  0x05 drawRect        x, y, w, h, c
+  0x06 drawCircle      x, y, r, c
+  0x07 drawTriangle    x1, y1, x2, y2, x3, y3, c
+  0x08 drawRoundRect   x, y, w, h, r, c
+  0x09 fillRect        x, y, w, h, c
+  0x0A fillCircle      x, y, r, c
+  0x0B fillTriangle    x1, y1, x2, y2, x3, y3, c
+  0x0C fillRoundRect   x, y, w, h, r, c
+  0x0D print           string
+  0x0E setTextSize     uint8_t size
+  0x0F setCursor       x, y
+  0x10 setTextWrap     uint8_t wrap
+  0x11 setRotation     uint8_t rotation
+  0x12 drawBitmap      x, y, string path          -> 0x92 int8_t result (1 ok, 0 error, -1 SD card error)
+  0x13 setDisplayMode  uint8_t mode
+  0x14 getDisplayMode                             -> 0x94 uint8_t mode
+  0x15 clearDisplay
+  0x16 display
+  0x17 partialUpdate
+  0x18 readTemperature                            -> 0x98 int8_t temperature
+  0x19 readBattery                                -> 0x99 uint16_t battery voltage in mV
+  0x1A panelSupply     uint8_t state
+  0x1B getPanelState                              -> 0x9B uint8_t state
+  0x1C uploadBegin     x, y, w, h, uint8_t flags  -> 0x9C uint8_t result (1 ok, 0 wrong region)
+  0x1D uploadData      string data
+  0x1E uploadEnd       uint8_t update             -> 0x9E uint8_t result (1 whole region received)
+  0x1F partialUpdate   y1, y2 (rows of the panel)
+
+Upload commands write raw framebuffer content into a region of the framebuffer (see Inkplate::uploadBegin() for its
+layout). Flags are SLAVE_UPLOAD_RLE (data is PackBits compressed) and SLAVE_UPLOAD_XOR (data is XORed with current
+content, so unchanged parts of a delta frame are zeros and compress well). Region can be larger than one frame, data is
+then sent in any number of uploadData commands. If update is set, uploadEnd refreshes only the rows of the region.
+ ****************************************************/
+
+#ifndef __INKPLATESLAVEPROTOCOL_H__
+#define __INKPLATESLAVEPROTOCOL_H__
+
+#define SLAVE_SYNC          0xA5
+#define SLAVE_RING_SIZE     4096    // Must be power of 2
+#define SLAVE_MAX_PAYLOAD   (SLAVE_RING_SIZE - 8)
+#define SLAVE_RESPONSE_SIZE 256
+
+#define SLAVE_ECHO              0x00
+#define SLAVE_DRAW_PIXEL        0x01
+#define SLAVE_DRAW_LINE         0x02
+#define SLAVE_DRAW_FAST_VLINE   0x03
+#define SLAVE_DRAW_FAST_HLINE   0x04
+#define SLAVE_DRAW_RECT         0x05
+#define SLAVE_DRAW_CIRCLE       0x06
+#define SLAVE_DRAW_TRIANGLE     0x07
+#define SLAVE_DRAW_ROUND_RECT   0x08
+#define SLAVE_FILL_RECT         0x09
+#define SLAVE_FILL_CIRCLE       0x0A
+#define SLAVE_FILL_TRIANGLE     0x0B
+#define SLAVE_FILL_ROUND_RECT   0x0C
+#define SLAVE_PRINT             0x0D
+#define SLAVE_SET_TEXT_SIZE     0x0E
+#define SLAVE_SET_CURSOR        0x0F
+#define SLAVE_SET_TEXT_WRAP     0x10
+#define SLAVE_SET_ROTATION      0x11
+#define SLAVE_DRAW_BITMAP       0x12
+#define SLAVE_SET_DISPLAY_MODE  0x13
+#define SLAVE_GET_DISPLAY_MODE  0x14
+#define SLAVE_CLEAR_DISPLAY     0x15
+#define SLAVE_DISPLAY           0x16
+#define SLAVE_PARTIAL_UPDATE    0x17
+#define SLAVE_READ_TEMPERATURE  0x18
+#define SLAVE_READ_BATTERY      0x19
+#define SLAVE_PANEL_SUPPLY      0x1A
+#define SLAVE_GET_PANEL_STATE   0x1B
+#define SLAVE_UPLOAD_BEGIN      0x1C
+#define SLAVE_UPLOAD_DATA       0x1D
+#define SLAVE_UPLOAD_END        0x1E
+#define SLAVE_PARTIAL_ROWS      0x1F
+#define SLAVE_RESPONSE          0x80
+#define SLAVE_NAK               0xFF
+
+#define SLAVE_ERR_CRC           1
+#define SLAVE_ERR_OPCODE        2
+#define SLAVE_ERR_LENGTH        3
+
+// Flags of uploadBegin (same as UPLOAD_RLE and UPLOAD_XOR of Inkplate class)
+#define SLAVE_UPLOAD_RLE        1
+#define SLAVE_UPLOAD_XOR        2
+
+#endif
@@ -0,0 +1,546 @@
+/***************************************************
+VT100/ANSI terminal console for Inkplate6Plus.
+See InkplateTerminal.h for the list of supported sequences.
+ ****************************************************/
+
+#include "InkplateTerminal.h"
+
+// Parser states
+#define TERMINAL_NORMAL     0
+#define TERMINAL_ESC        1
+#define TERMINAL_CSI        2
+#define TERMINAL_CHARSET    3   // ESC ( and similar, one more character is ignored
+#define TERMINAL_OSC        4
+#define TERMINAL_OSC_ESC    5   // ESC inside OSC, string terminator if followed by backslash
+
+InkplateTerminal::InkplateTerminal(Inkplate &_display)
+{
+    _ink = &_display;
+}
+
+InkplateTerminal::~InkplateTerminal()
+{
+    end();
+}
+
+// Allocates cell grid for the whole panel and clears the screen. Display has to be in 1 bit mode.
+bool InkplateTerminal::begin(uint8_t _s)
+{
+    end();
+    if (_ink->getDisplayMode() != INKPLATE_1BIT) return false;
+    _scale = _s ? _s : 1;
+    _cellW = 6 * _scale;
+    _cellH = 8 * _scale;
+    _cols = E_INK_WIDTH / _cellW;
+    _rows = E_INK_HEIGHT / _cellH;
+    _dirtyStride = (_cols + 7) / 8;
+    _chars = (uint8_t *)ps_malloc(_cols * _rows);
+    _attrs = (uint8_t *)ps_malloc(_cols * _rows);
+    _dirty = (uint8_t *)malloc(_dirtyStride * _rows);
+    if (_chars == NULL || _attrs == NULL || _dirty == NULL)
+    {
+        end();
+        return false;
+    }
+    reset();
+    return true;
+}
+
+void InkplateTerminal::end()
+{
+    free(_chars);
+    free(_attrs);
+    free(_dirty);
+    _chars = _attrs = _dirty = NULL;
+    _cols = _rows = 0;
+}
+
+size_t InkplateTerminal::write(uint8_t _c)
+{
+    if (_chars == NULL) return 0;
+    put(_c);
+    return 1;
+}
+
+size_t InkplateTerminal::write(const uint8_t *_b, size_t _n)
+{
+    if (_chars == NULL) return 0;
+    for (size_t i = 0; i < _n; i++) put(_b[i]);
+    return _n;
+}
+
+// Clears the screen and moves cursor to the top left cell.
+void InkplateTerminal::clear()
+{
+    if (_chars == NULL) return;
+    eraseRows(0, _rows - 1);
+    _x = _y = 0;
+    _wrapPending = false;
+}
+
+// Draws dirty cells and refreshes the band of rows changed since the last refresh. Returns false if nothing changed.
+bool InkplateTerminal::refresh()
+{
+    if (_chars == NULL) return false;
+    drawDirty();
+    if (_changedTop > _changedBottom) return false;
+    _ink->partialUpdate(_changedTop * _cellH, (_changedBottom + 1) * _cellH - 1);
+    _changedTop = _rows;
+    _changedBottom = -1;
+    _lastRefresh = millis();
+    _refreshes++;
+    return true;
+}
+
+// Refreshes if something changed and refresh interval passed since the last refresh. Call it often from loop().
+bool InkplateTerminal::poll()
+{
+    if (millis() - _lastRefresh < _interval) return false;
+    return refresh();
+}
+
+void InkplateTerminal::setRefreshInterval(uint16_t _ms)
+{
+    _interval = _ms;
+}
+
+// With newline mode on (default), LF also returns cursor to the first column, so output with only "\n" works.
+void InkplateTerminal::setNewlineMode(bool _on)
+{
+    _newline = _on;
+}
+
+uint16_t InkplateTerminal::getColumns()
+{
+    return _cols;
+}
+
+uint16_t InkplateTerminal::getRows()
+{
+    return _rows;
+}
+
+uint16_t InkplateTerminal::getCursorColumn()
+{
+    return _x;
+}
+
+uint16_t InkplateTerminal::getCursorRow()
+{
+    return _y;
+}
+
+uint32_t InkplateTerminal::getRefreshes()
+{
+    return _refreshes;
+}
+
+//--------------------------PRIVATE FUNCTIONS--------------------------------------------
+void InkplateTerminal::put(uint8_t _c)
+{
+    if (_c == 0x1B && _state != TERMINAL_OSC)
+    {
+        _state = TERMINAL_ESC;
+        return;
+    }
+    switch (_state)
+    {
+    case TERMINAL_NORMAL:
+        if (_c < 0x20 || _c == 0x7F)
+        {
+            control(_c);
+            return;
+        }
+        if (_c >= 0x80 && _c < 0xC0) return; // UTF-8 continuation bytes, lead byte is shown as '?'
+        if (_c >= 0xC0) _c = '?';
+        if (_wrapPending)
+        {
+            _x = 0;
+            lineFeed();
+            _wrapPending = false;
+        }
+        setCell(_x, _y, _c, _attr);
+        if (_x + 1 < _cols)
+            _x++;
+        else
+            _wrapPending = true;
+        return;
+    case TERMINAL_ESC:
+        escape(_c);
+        return;
+    case TERMINAL_CSI:
+        if (_c >= '0' && _c <= '9')
+        {
+            if (_nParams == 0) _nParams = 1;
+            if (_params[_nParams - 1] < 1000) _params[_nParams - 1] = _params[_nParams - 1] * 10 + (_c - '0');
+        }
+        else if (_c == ';')
+        {
+            if (_nParams == 0) _nParams = 1;
+            if (_nParams < TERMINAL_MAX_PARAMS) _nParams++;
+        }
+        else if (_c == '?' || _c == '>' || _c == '=')
+        {
+            _private = true;
+        }
+        else if (_c >= 0x40 && _c <= 0x7E)
+        {
+            _state = TERMINAL_NORMAL;
+            csi(_c);
+        }
+        else if (_c < 0x20)
+        {
+            control(_c);
+        }
+        return;
+    case TERMINAL_CHARSET:
+        _state = TERMINAL_NORMAL;
+        return;
+    case TERMINAL_OSC:
+        if (_c == 0x07) _state = TERMINAL_NORMAL;
+        if (_c == 0x1B) _state = TERMINAL_OSC_ESC;
+        return;
+    case TERMINAL_OSC_ESC:
+        _state = _c == '\\' ? TERMINAL_NORMAL : TERMINAL_OSC;
+        return;
+    }
+}
+
+void InkplateTerminal::control(uint8_t _c)
+{
+    switch (_c)
+    {
+    case '\b':
+        if (_x) _x--;
+        break;
+    case '\t':
+        _x = (_x / 8 + 1) * 8 < _cols ? (_x / 8 + 1) * 8 : _cols - 1;
+        break;
+    case '\n':
+    case 0x0B:
+    case 0x0C:
+        lineFeed();
+        if (_newline) _x = 0;
+        break;
+    case '\r':
+        _x = 0;
+        break;
+    default:
+        return;
+    }
+    _wrapPending = false;
+}
+
+void InkplateTerminal::escape(uint8_t _c)
+{
+    _state = TERMINAL_NORMAL;
+    switch (_c)
+    {
+    case '[':
+        _state = TERMINAL_CSI;
+        memset(_params, 0, sizeof(_params));
+        _nParams = 0;
+        _private = false;
+        return;
+    case ']':
+        _state = TERMINAL_OSC;
+        return;
+    case '(':
+    case ')':
+    case '*':
+    case '+':
+        _state = TERMINAL_CHARSET;
+        return;
+    case '7':
+        _savedX = _x;
+        _savedY = _y;
+        _savedAttr = _attr;
+        return;
+    case '8':
+        _x = _savedX;
+        _y = _savedY;
+        _attr = _savedAttr;
+        break;
+    case 'D':
+        lineFeed();
+        break;
+    case 'E':
+        _x = 0;
+        lineFeed();
+        break;
+    case 'M':
+        reverseLineFeed();
+        break;
+    case 'c':
+        reset();
+        return;
+    default:
+        return;
+    }
+    _wrapPending = false;
+}
+
+void InkplateTerminal::csi(uint8_t _c)
+{
+    if (_private) return;
+    uint16_t n = param(0, 1);
+    uint16_t _lim;
+    if (_c != 'm') _wrapPending = false;
+    switch (_c)
+    {
+    case 'A':
+    case 'F':
+        // Cursor stops at the top of the scroll region if it is inside of it
+        _lim = _y >= _top ? _top : 0;
+        _y = _y - _lim > n ? _y - n : _lim;
+        if (_c == 'F') _x = 0;
+        break;
+    case 'B':
+    case 'E':
+        _lim = _y <= _bottom ? _bottom : _rows - 1;
+        _y = _lim - _y > n ? _y + n : _lim;
+        if (_c == 'E') _x = 0;
+        break;
+    case 'C':
+        _x = _x + n < _cols ? _x + n : _cols - 1;
+        break;
+    case 'D':
+        _x = _x > n ? _x - n : 0;
+        break;
+    case 'G':
+        _x = (n < _cols ? n : _cols) - 1;
+        break;
+    case 'd':
+        _y = (n < _rows ? n : _rows) - 1;
+        break;
+    case 'H':
+    case 'f':
+        _y = (n < _rows ? n : _rows) - 1;
+        _x = (param(1, 1) < _cols ? param(1, 1) : _cols) - 1;
+        break;
+    case 'J':
+        if (param(0, 0) == 0)
+        {
+            eraseCells(_y, _x, _cols - 1);
+            if (_y + 1 < _rows) eraseRows(_y + 1, _rows - 1);
+        }
+        else if (param(0, 0) == 1)
+        {
+            if (_y) eraseRows(0, _y - 1);
+            eraseCells(_y, 0, _x);
+        }
+        else
+        {
+            eraseRows(0, _rows - 1);
+        }
+        break;
+    case 'K':
+        if (param(0, 0) == 0) eraseCells(_y, _x, _cols - 1);
+        else if (param(0, 0) == 1) eraseCells(_y, 0, _x);
+        else eraseCells(_y, 0, _cols - 1);
+        break;
+    case 'X':
+        eraseCells(_y, _x, (_x + n < _cols ? _x + n : _cols) - 1);
+        break;
+    case '@':
+    case 'P':
+    {
+        // Characters right of the cursor move, cells that get the same character stay clean
+        uint32_t _row = (uint32_t)_y * _cols;
+        if (n > _cols - _x) n = _cols - _x;
+        if (_c == '@')
+        {
+            for (int i = _cols - 1; i >= _x + n; i--) setCell(i, _y, _chars[_row + i - n], _attrs[_row + i - n]);
+            eraseCells(_y, _x, _x + n - 1);
+        }
+        else
+        {
+            for (int i = _x; i < _cols - n; i++) setCell(i, _y, _chars[_row + i + n], _attrs[_row + i + n]);
+            eraseCells(_y, _cols - n, _cols - 1);
+        }
+        break;
+    }
+    case 'L':
+    case 'M':
+        if (_y < _top || _y > _bottom) break;
+        if (_c == 'L')
+            scrollDown(_y, _bottom, n);
+        else
+            scrollUp(_y, _bottom, n);
+        _x = 0;
+        break;
+    case 'S':
+        scrollUp(_top, _bottom, n);
+        break;
+    case 'T':
+        scrollDown(_top, _bottom, n);
+        break;
+    case 'r':
+    {
+        uint16_t _t = param(0, 1) - 1;
+        uint16_t _b = (param(1, _rows) < _rows ? param(1, _rows) : _rows) - 1;
+        if (_t >= _b) break;
+        _top = _t;
+        _bottom = _b;
+        _x = _y = 0;
+        break;
+    }
+    case 's':
+        _savedX = _x;
+        _savedY = _y;
+        _savedAttr = _attr;
+        break;
+    case 'u':
+        _x = _savedX;
+        _y = _savedY;
+        _attr = _savedAttr;
+        break;
+    case 'm':
+        for (uint8_t i = 0; i < (_nParams ? _nParams : 1); i++)
+        {
+            if (_params[i] == 0) _attr = 0;
+            else if (_params[i] == 4) _attr |= TERMINAL_ATTR_UNDERLINE;
+            else if (_params[i] == 24) _attr &= ~TERMINAL_ATTR_UNDERLINE;
+            else if (_params[i] == 7) _attr |= TERMINAL_ATTR_REVERSE;
+            else if (_params[i] == 27) _attr &= ~TERMINAL_ATTR_REVERSE;
+        }
+        break;
+    }
+}
+
+// Parameter _i of CSI sequence, _def if it's missing or 0.
+uint16_t InkplateTerminal::param(uint8_t _i, uint16_t _def)
+{
+    return _i < _nParams && _params[_i] ? _params[_i] : _def;
+}
+
+void InkplateTerminal::lineFeed()
+{
+    if (_y == _bottom)
+        scrollUp(_top, _bottom, 1);
+    else if (_y + 1 < _rows)
+        _y++;
+}
+
+void InkplateTerminal::reverseLineFeed()
+{
+    if (_y == _top)
+        scrollDown(_top, _bottom, 1);
+    else if (_y)
+        _y--;
+}
+
+// Marks cell dirty only if its content changes, so rewriting the same text doesn't draw anything.
+void InkplateTerminal::setCell(uint16_t _cx, uint16_t _cy, uint8_t _c, uint8_t _a)
+{
+    uint32_t i = (uint32_t)_cy * _cols + _cx;
+    if (_chars[i] == _c && _attrs[i] == _a) return;
+    _chars[i] = _c;
+    _attrs[i] = _a;
+    _dirty[_cy * _dirtyStride + (_cx >> 3)] |= 1 << (_cx & 7);
+}
+
+void InkplateTerminal::eraseCells(uint16_t _cy, uint16_t _x1, uint16_t _x2)
+{
+    for (uint16_t i = _x1; i <= _x2; i++) setCell(i, _cy, ' ', 0);
+}
+
+// Whole rows are cleared in the framebuffer right away, it's faster than drawing blank cells.
+void InkplateTerminal::eraseRows(uint16_t _y1, uint16_t _y2)
+{
+    uint16_t n = _y2 - _y1 + 1;
+    memset(_chars + (uint32_t)_y1 * _cols, ' ', (uint32_t)n * _cols);
+    memset(_attrs + (uint32_t)_y1 * _cols, 0, (uint32_t)n * _cols);
+    memset(_dirty + _y1 * _dirtyStride, 0, n * _dirtyStride);
+    memset(_ink->_partial + (uint32_t)_y1 * _cellH * (E_INK_WIDTH / 8), 0, (uint32_t)n * _cellH * (E_INK_WIDTH / 8));
+    markChanged(_y1, _y2);
+}
+
+// Scrolls rows _y1 to _y2 up by _n rows, new rows at the bottom are blank.
+void InkplateTerminal::scrollUp(uint16_t _y1, uint16_t _y2, uint16_t _n)
+{
+    uint16_t _h = _y2 - _y1 + 1;
+    if (_n > _h) _n = _h;
+    if (_n < _h) moveRows(_y1, _y1 + _n, _h - _n);
+    eraseRows(_y2 - _n + 1, _y2);
+    markChanged(_y1, _y2);
+}
+
+// Scrolls rows _y1 to _y2 down by _n rows, new rows at the top are blank.
+void InkplateTerminal::scrollDown(uint16_t _y1, uint16_t _y2, uint16_t _n)
+{
+    uint16_t _h = _y2 - _y1 + 1;
+    if (_n > _h) _n = _h;
+    if (_n < _h) moveRows(_y1 + _n, _y1, _h - _n);
+    eraseRows(_y1, _y1 + _n - 1);
+    markChanged(_y1, _y2);
+}
+
+// Moves _n cell rows with their framebuffer rows and dirty bits, cells that weren't drawn yet are drawn at the new place.
+void InkplateTerminal::moveRows(uint16_t _to, uint16_t _from, uint16_t _n)
+{
+    const uint32_t _fbRow = (uint32_t)_cellH * (E_INK_WIDTH / 8);
+    memmove(_chars + (uint32_t)_to * _cols, _chars + (uint32_t)_from * _cols, (uint32_t)_n * _cols);
+    memmove(_attrs + (uint32_t)_to * _cols, _attrs + (uint32_t)_from * _cols, (uint32_t)_n * _cols);
+    memmove(_dirty + _to * _dirtyStride, _dirty + _from * _dirtyStride, _n * _dirtyStride);
+    memmove(_ink->_partial + _to * _fbRow, _ink->_partial + _from * _fbRow, _n * _fbRow);
+}
+
+void InkplateTerminal::markChanged(uint16_t _y1, uint16_t _y2)
+{
+    if (_y1 < _changedTop) _changedTop = _y1;
+    if ((int16_t)_y2 > _changedBottom) _changedBottom = _y2;
+}
+
+// Draws dirty cells into the framebuffer (in panel coordinates, rotation is turned off for that time).
+void InkplateTerminal::drawDirty()
+{
+    uint8_t _rot = _ink->getRotation();
+    bool _rotated = false;
+    for (uint16_t y = 0; y < _rows; y++)
+    {
+        uint8_t *d = _dirty + y * _dirtyStride;
+        bool _any = false;
+        for (uint16_t b = 0; b < _dirtyStride; b++)
+        {
+            if (d[b] == 0) continue;
+            if (!_rotated && _rot)
+            {
+                _ink->setRotation(0);
+                _rotated = true;
+            }
+            for (uint8_t k = 0; k < 8; k++)
+            {
+                if (!(d[b] & (1 << k))) continue;
+                uint16_t x = b * 8 + k;
+                uint32_t i = (uint32_t)y * _cols + x;
+                int16_t _px = x * _cellW, _py = y * _cellH;
+                uint16_t _fg = _attrs[i] & TERMINAL_ATTR_REVERSE ? WHITE : BLACK;
+                _ink->fillRect(_px, _py, _cellW, _cellH, _fg == BLACK ? WHITE : BLACK);
+                if (_chars[i] != ' ') _ink->drawChar(_px, _py, _chars[i], _fg, _fg, _scale);
+                if (_attrs[i] & TERMINAL_ATTR_UNDERLINE) _ink->drawFastHLine(_px, _py + _cellH - 1, _cellW, _fg);
+            }
+            d[b] = 0;
+            _any = true;
+        }
+        if (_any) markChanged(y, y);
+    }
+    if (_rotated) _ink->setRotation(_rot);
+}
+
+// Clears the whole framebuffer and cell grid and sets cursor, scroll region, attributes and parser to defaults.
+void InkplateTerminal::reset()
+{
+    _x = _y = 0;
+    _wrapPending = false;
+    _top = 0;
+    _bottom = _rows - 1;
+    _attr = 0;
+    _savedX = _savedY = 0;
+    _savedAttr = 0;
+    _state = TERMINAL_NORMAL;
+    _changedTop = _rows;
+    _changedBottom = -1;
+    _ink->clearDisplay();
+    eraseRows(0, _rows - 1);
+}
@@ -0,0 +1,107 @@
+/***************************************************
+VT100/ANSI terminal console for Inkplate6Plus (1 bit mode).
+
+Screen is a grid of character cells (6x8 pixels of the built-in GFX font, times scale) in panel coordinates, rotation of
+the display is not used. Text written with print() or write() only goes into the cell grid and marks cells in a dirty
+bitmap, nothing is drawn and the panel isn't refreshed per character. refresh() draws dirty cells into the framebuffer
+and does one partial update of the band of pixel rows that changed; poll() does the same, but not more often than the
+refresh interval, so fast log output is batched into a few refreshes. Scrolling moves framebuffer rows, cells and dirty
+bits of the scroll region with memmove(), scrolled text isn't drawn again.
+
+Supported:
+  control characters  BS, HT (stops every 8 columns), LF, VT, FF (all three also do CR if newline mode is on), CR
+  ESC sequences       ESC 7, ESC 8, ESC D, ESC E, ESC M, ESC c, ESC ( x and ESC ) x (ignored)
+  CSI sequences       A B C D E F G H f d (cursor), J K X (erase), @ P (insert, delete characters), L M (insert, delete
+                      lines), S T (scroll), r (scroll region), s u (save, restore cursor), m (0, 4, 7, 24, 27, others are
+                      ignored, there are no colors), private modes (?...h/l) are ignored
+  OSC (ESC ] ... BEL or ESC \) is ignored. UTF-8 characters are shown as '?'. Cursor isn't drawn.
+ ****************************************************/
+
+#ifndef __INKPLATETERMINAL_H__
+#define __INKPLATETERMINAL_H__
+
+#include "Inkplate6Plus.h"
+
+#define TERMINAL_REFRESH_INTERVAL   1000    // Default minimal time between refreshes done by poll() (ms)
+#define TERMINAL_MAX_PARAMS         8       // Numeric parameters of one CSI sequence
+
+// Cell attributes
+#define TERMINAL_ATTR_UNDERLINE     1
+#define TERMINAL_ATTR_REVERSE       2
+
+class InkplateTerminal : public Print {
+  public:
+    InkplateTerminal(Inkplate &_display);
+    ~InkplateTerminal();
+    bool begin(uint8_t _scale = 1);
+    void end();
+    size_t write(uint8_t _c);
+    size_t write(const uint8_t *_b, size_t _n);
+    using Print::write;
+    void clear();
+    bool refresh();
+    bool poll();
+    void setRefreshInterval(uint16_t _ms);
+    void setNewlineMode(bool _on);
+    uint16_t getColumns();
+    uint16_t getRows();
+    uint16_t getCursorColumn();
+    uint16_t getCursorRow();
+    uint32_t getRefreshes();
+
+  private:
+    Inkplate *_ink;
+    uint8_t _scale = 1;
+    uint16_t _cols = 0;
+    uint16_t _rows = 0;
+    uint16_t _cellW;
+    uint16_t _cellH;
+    uint16_t _dirtyStride;      // Bytes of dirty bitmap per cell row
+    uint8_t *_chars = NULL;
+    uint8_t *_attrs = NULL;
+    uint8_t *_dirty = NULL;
+
+    // Cursor, scroll region and current attributes
+    uint16_t _x = 0;
+    uint16_t _y = 0;
+    bool _wrapPending = false;
+    uint16_t _top = 0;
+    uint16_t _bottom = 0;
+    uint8_t _attr = 0;
+    uint16_t _savedX = 0;
+    uint16_t _savedY = 0;
+    uint8_t _savedAttr = 0;
+    bool _newline = true;
+
+    // Escape sequence parser
+    uint8_t _state = 0;
+    uint16_t _params[TERMINAL_MAX_PARAMS];
+    uint8_t _nParams = 0;
+    bool _private = false;
+
+    // Cell rows changed since the last refresh (drawn or moved in the framebuffer), _changedTop > _changedBottom if none
+    int16_t _changedTop;
+    int16_t _changedBottom;
+    uint16_t _interval = TERMINAL_REFRESH_INTERVAL;
+    uint32_t _lastRefresh = 0;
+    uint32_t _refreshes = 0;
+
+    void put(uint8_t _c);
+    void control(uint8_t _c);
+    void escape(uint8_t _c);
+    void csi(uint8_t _c);
+    uint16_t param(uint8_t _i, uint16_t _def);
+    void lineFeed();
+    void reverseLineFeed();
+    void setCell(uint16_t _cx, uint16_t _cy, uint8_t _c, uint8_t _a);
+    void eraseCells(uint16_t _cy, uint16_t _x1, uint16_t _x2);
+    void eraseRows(uint16_t _y1, uint16_t _y2);
+    void scrollUp(uint16_t _y1, uint16_t _y2, uint16_t _n);
+    void scrollDown(uint16_t _y1, uint16_t _y2, uint16_t _n);
+    void moveRows(uint16_t _to, uint16_t _from, uint16_t _n);
+    void markChanged(uint16_t _y1, uint16_t _y2);
+    void drawDirty();
+    void reset();
+};
+
+#endif
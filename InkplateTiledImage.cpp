@@ -0,0 +1,264 @@
+/***************************************************
+Tiled, multi-resolution image viewer for Inkplate6Plus.
+See InkplateTiledImage.h for file format description.
+ ****************************************************/
+
+#include "InkplateTiledImage.h"
+
+InkplateTiledImage::InkplateTiledImage(Inkplate &_display)
+{
+    _ink = &_display;
+}
+
+InkplateTiledImage::~InkplateTiledImage()
+{
+    close();
+}
+
+bool InkplateTiledImage::open(const char *fileName, uint8_t _n)
+{
+    uint8_t header[20];
+    uint8_t lvl[16];
+    close();
+    if (!_file.open(fileName, O_RDONLY)) return false;
+    if (_file.read(header, 20) != 20 || memcmp(header, "IPTI", 4) != 0 || header[4] != 1)
+    {
+        _file.close();
+        return false;
+    }
+    _bpp = header[5];
+    _levels = header[6];
+    _tileSize = header[8] | (header[9] << 8);
+    if ((_bpp != 1 && _bpp != 3) || _levels == 0 || _levels > TILED_IMAGE_MAX_LEVELS || _tileSize == 0 || (_tileSize % 8) != 0)
+    {
+        _file.close();
+        return false;
+    }
+    _rowBytes = _bpp == 1 ? _tileSize / 8 : _tileSize / 2;
+    _tileBytes = _rowBytes * _tileSize;
+
+    // Read level table and tile index of every level, index is small so it's kept in PSRAM for whole time image is open.
+    bool ok = true;
+    memset(_level, 0, sizeof(_level));
+    for (int i = 0; i < _levels && ok; i++)
+    {
+        _file.seekSet(20 + (i * 16));
+        if (_file.read(lvl, 16) != 16)
+        {
+            ok = false;
+            break;
+        }
+        _level[i].width = lvl[0] | (lvl[1] << 8) | (lvl[2] << 16) | ((uint32_t)lvl[3] << 24);
+        _level[i].height = lvl[4] | (lvl[5] << 8) | (lvl[6] << 16) | ((uint32_t)lvl[7] << 24);
+        _level[i].tilesX = lvl[8] | (lvl[9] << 8);
+        _level[i].tilesY = lvl[10] | (lvl[11] << 8);
+        uint32_t indexOffset = lvl[12] | (lvl[13] << 8) | (lvl[14] << 16) | ((uint32_t)lvl[15] << 24);
+        uint32_t n = (uint32_t)_level[i].tilesX * _level[i].tilesY;
+        // Tiles have to cover the whole level and its index has to be inside the file, damaged table is rejected here,
+        // so draw() can rely on it.
+        if (_level[i].width == 0 || _level[i].height == 0 ||
+            _level[i].tilesX < _level[i].width / _tileSize + (_level[i].width % _tileSize != 0) ||
+            _level[i].tilesY < _level[i].height / _tileSize + (_level[i].height % _tileSize != 0) ||
+            indexOffset > _file.fileSize() || n > (_file.fileSize() - indexOffset) / sizeof(uint32_t))
+        {
+            ok = false;
+            break;
+        }
+        _level[i].index = (uint32_t *)ps_malloc(n * sizeof(uint32_t));
+        ok = _level[i].index != NULL && _file.seekSet(indexOffset) &&
+             _file.read(_level[i].index, n * sizeof(uint32_t)) == (int)(n * sizeof(uint32_t));
+    }
+
+    _cacheTiles = _n ? _n : 1;
+    _cache = ok ? (uint8_t *)ps_malloc(_cacheTiles * _tileBytes) : NULL;
+    _slots = ok ? (tileSlot *)malloc(_cacheTiles * sizeof(tileSlot)) : NULL;
+    _isOpen = 1;
+    if (_cache == NULL || _slots == NULL)
+    {
+        close();
+        return false;
+    }
+    memset(_slots, 0, _cacheTiles * sizeof(tileSlot));
+    _useCounter = _hits = _misses = 0;
+    return true;
+}
+
+void InkplateTiledImage::close()
+{
+    if (!_isOpen) return;
+    for (int i = 0; i < TILED_IMAGE_MAX_LEVELS; i++)
+    {
+        free(_level[i].index);
+        _level[i].index = NULL;
+    }
+    free(_cache);
+    free(_slots);
+    _cache = NULL;
+    _slots = NULL;
+    _cacheTiles = 0;
+    _file.close();
+    _isOpen = 0;
+}
+
+uint8_t InkplateTiledImage::getLevels()
+{
+    return _isOpen ? _levels : 0;
+}
+
+uint8_t InkplateTiledImage::getBitsPerPixel()
+{
+    return _bpp;
+}
+
+uint16_t InkplateTiledImage::getTileSize()
+{
+    return _tileSize;
+}
+
+uint32_t InkplateTiledImage::getWidth(uint8_t _l)
+{
+    return (_isOpen && _l < _levels) ? _level[_l].width : 0;
+}
+
+uint32_t InkplateTiledImage::getHeight(uint8_t _l)
+{
+    return (_isOpen && _l < _levels) ? _level[_l].height : 0;
+}
+
+// Returns the smallest level that still has at least requested zoom (1.0 = full resolution, 0.5 = half size, ...).
+uint8_t InkplateTiledImage::levelForZoom(float _zoom)
+{
+    uint8_t l = 0;
+    while ((l + 1) < _levels && (1.0 / (1 << (l + 1))) >= _zoom) l++;
+    return l;
+}
+
+uint32_t InkplateTiledImage::getCacheHits()
+{
+    return _hits;
+}
+
+uint32_t InkplateTiledImage::getCacheMisses()
+{
+    return _misses;
+}
+
+int InkplateTiledImage::draw(uint8_t _l, int32_t _srcX, int32_t _srcY)
+{
+    return draw(_l, _srcX, _srcY, 0, 0, _ink->width(), _ink->height());
+}
+
+// Draws part of the level _l starting at (_srcX, _srcY) of that level into screen rectangle (_x, _y, _w, _h).
+// Returns number of tiles that are drawn or -1 if image is not open or some tile can't be read.
+int InkplateTiledImage::draw(uint8_t _l, int32_t _srcX, int32_t _srcY, int16_t _x, int16_t _y, int16_t _w, int16_t _h)
+{
+    if (!_isOpen || _l >= _levels || _w <= 0 || _h <= 0) return -1;
+    tiledLevel *lv = &_level[_l];
+    uint8_t mode = _ink->getDisplayMode();
+
+    // Everything that is not covered by tile (outside of the image or blank tile) is white.
+    _ink->fillRect(_x, _y, _w, _h, mode == INKPLATE_1BIT ? WHITE : 7);
+
+    int32_t x0 = _srcX < 0 ? 0 : _srcX;
+    int32_t y0 = _srcY < 0 ? 0 : _srcY;
+    int32_t x1 = _srcX + _w > (int32_t)lv->width ? lv->width : _srcX + _w;
+    int32_t y1 = _srcY + _h > (int32_t)lv->height ? lv->height : _srcY + _h;
+    if (x0 >= x1 || y0 >= y1) return 0;
+
+    int n = 0;
+    for (int32_t ty = y0 / _tileSize; ty <= (y1 - 1) / _tileSize; ty++)
+    {
+        for (int32_t tx = x0 / _tileSize; tx <= (x1 - 1) / _tileSize; tx++)
+        {
+            if (lv->index[ty * lv->tilesX + tx] == 0) continue;
+            const uint8_t *t = getTile(_l, tx, ty);
+            if (t == NULL) return -1;
+            blitTile(t, lv, tx * _tileSize, ty * _tileSize, _srcX, _srcY, _x, _y, _w, _h);
+            n++;
+        }
+    }
+    return n;
+}
+
+// Finds tile in the cache or loads it from SD card into least recently used cache slot.
+const uint8_t *InkplateTiledImage::getTile(uint8_t _l, uint16_t _tx, uint16_t _ty)
+{
+    int lru = 0;
+    for (int i = 0; i < _cacheTiles; i++)
+    {
+        if (_slots[i].valid && _slots[i].level == _l && _slots[i].tx == _tx && _slots[i].ty == _ty)
+        {
+            _slots[i].lastUse = ++_useCounter;
+            _hits++;
+            return _cache + (i * _tileBytes);
+        }
+        if (!_slots[i].valid || (_slots[lru].valid && _slots[i].lastUse < _slots[lru].lastUse)) lru = i;
+    }
+
+    _misses++;
+    uint8_t *p = _cache + (lru * _tileBytes);
+    _slots[lru].valid = 0;
+    if (!_file.seekSet(_level[_l].index[_ty * _level[_l].tilesX + _tx])) return NULL;
+    if (_file.read(p, _tileBytes) != (int)_tileBytes) return NULL;
+    _slots[lru].level = _l;
+    _slots[lru].tx = _tx;
+    _slots[lru].ty = _ty;
+    _slots[lru].lastUse = ++_useCounter;
+    _slots[lru].valid = 1;
+    return p;
+}
+
+uint8_t InkplateTiledImage::tilePixel(const uint8_t *_t, uint16_t _px, uint16_t _py)
+{
+    const uint8_t *r = _t + (_py * _rowBytes);
+    if (_bpp == 1) return (r[_px >> 3] >> (_px & 7)) & 1;
+    return (_px & 1) ? (r[_px >> 1] & 0x0F) : (r[_px >> 1] >> 4);
+}
+
+void InkplateTiledImage::blitTile(const uint8_t *_t, tiledLevel *lv, int32_t _tileX, int32_t _tileY, int32_t _srcX, int32_t _srcY, int16_t _x, int16_t _y, int16_t _w, int16_t _h)
+{
+    int32_t ix0 = _tileX > _srcX ? _tileX : _srcX;
+    int32_t iy0 = _tileY > _srcY ? _tileY : _srcY;
+    int32_t ix1 = _tileX + _tileSize;
+    int32_t iy1 = _tileY + _tileSize;
+    if (ix1 > _srcX + _w) ix1 = _srcX + _w;
+    if (iy1 > _srcY + _h) iy1 = _srcY + _h;
+    // Padding of the edge tiles is never drawn.
+    if (ix1 > (int32_t)lv->width) ix1 = lv->width;
+    if (iy1 > (int32_t)lv->height) iy1 = lv->height;
+
+    uint8_t mode = _ink->getDisplayMode();
+    uint8_t ppb = _bpp == 1 ? 8 : 2;
+    int32_t dx0 = _x + (ix0 - _srcX);
+    int32_t span = ix1 - ix0;
+
+    // If there is no rotation and image has the same color depth as the display, tile rows can be copied straight into the
+    // framebuffer as long as source and destination are aligned to the byte boundary.
+    bool fast = (_ink->getRotation() == 0) && ((mode == INKPLATE_1BIT) == (_bpp == 1)) && ((dx0 % ppb) == 0) &&
+                (((ix0 - _tileX) % ppb) == 0) && dx0 >= 0 && (dx0 + span) <= E_INK_WIDTH;
+
+    for (int32_t py = iy0; py < iy1; py++)
+    {
+        int32_t dy = _y + (py - _srcY);
+        int32_t px = ix0;
+        if (fast && dy >= 0 && dy < E_INK_HEIGHT)
+        {
+            uint32_t n = span / ppb;
+            const uint8_t *src = _t + ((py - _tileY) * _rowBytes) + ((ix0 - _tileX) / ppb);
+            if (_bpp == 1)
+                memcpy(_ink->_partial + (E_INK_WIDTH / 8 * dy) + (dx0 / 8), src, n);
+            else
+                memcpy(_ink->D_memory4Bit + (E_INK_WIDTH / 2 * dy) + (dx0 / 2), src, n);
+            px += n * ppb;
+        }
+        for (; px < ix1; px++)
+        {
+            uint8_t v = tilePixel(_t, px - _tileX, py - _tileY);
+            if (mode == INKPLATE_1BIT)
+                v = _bpp == 1 ? v : (v < 4 ? BLACK : WHITE);
+            else
+                v = _bpp == 1 ? (v ? 0 : 7) : v;
+            _ink->drawPixel(_x + (px - _srcX), dy, v);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/***************************************************
+Tiled, multi-resolution image viewer for Inkplate6Plus.
+
+Images bigger than the panel are stored on SD card as a pyramid of fixed-size tiles (see extras/tools/tiled_image_encoder.cpp
+for the host-side encoder). Only tiles that intersect the viewport are read from SD card and recently used tiles are kept in a
+small cache in PSRAM, so panning over a big image does not re-read the whole file.
+
+File layout (all values are little endian):
+  0   char[4]  magic "IPTI"
+  4   uint8_t  version (1)
+  5   uint8_t  bits per pixel (1 or 3)
+  6   uint8_t  number of levels (level 0 is full resolution, every next level is half the size)
+  7   uint8_t  reserved
+  8   uint16_t tile size in pixels (tiles are square, multiple of 8)
+  10  uint16_t reserved
+  12  uint32_t width of level 0
+  16  uint32_t height of level 0
+  20  level table, 16 bytes per level: uint32_t width, uint32_t height, uint16_t tilesX, uint16_t tilesY, uint32_t index offset
+Index of every level is tilesX * tilesY uint32_t file offsets (row by row), offset 0 means blank (white) tile.
+Tile data is stored in the same layout as Inkplate framebuffer (1 bit: LSB is leftmost pixel, 1 = black;
+3 bit: two pixels per byte, high nibble is left pixel, 0 = black, 7 = white), edge tiles are padded to full tile size.
+ ****************************************************/
+
+#ifndef __INKPLATETILEDIMAGE_H__
+#define __INKPLATETILEDIMAGE_H__
+
+#include "Inkplate6Plus.h"
+
+#define TILED_IMAGE_MAX_LEVELS  8
+#define TILED_IMAGE_CACHE_TILES 16
+
+class InkplateTiledImage {
+  public:
+    InkplateTiledImage(Inkplate &_display);
+    ~InkplateTiledImage();
+    bool open(const char *fileName, uint8_t _cacheTiles = TILED_IMAGE_CACHE_TILES);
+    void close();
+    uint8_t getLevels();
+    uint8_t getBitsPerPixel();
+    uint16_t getTileSize();
+    uint32_t getWidth(uint8_t _level = 0);
+    uint32_t getHeight(uint8_t _level = 0);
+    uint8_t levelForZoom(float _zoom);
+    int draw(uint8_t _level, int32_t _srcX, int32_t _srcY);
+    int draw(uint8_t _level, int32_t _srcX, int32_t _srcY, int16_t _x, int16_t _y, int16_t _w, int16_t _h);
+    uint32_t getCacheHits();
+    uint32_t getCacheMisses();
+
+  private:
+    struct tiledLevel {
+        uint32_t width;
+        uint32_t height;
+        uint16_t tilesX;
+        uint16_t tilesY;
+        uint32_t *index;
+    };
+    struct tileSlot {
+        uint8_t level;
+        uint16_t tx;
+        uint16_t ty;
+        uint32_t lastUse;
+        uint8_t valid;
+    };
+
+    Inkplate *_ink;
+    SdFile _file;
+    uint8_t _isOpen = 0;
+    uint8_t _bpp;
+    uint8_t _levels;
+    uint16_t _tileSize;
+    uint32_t _tileBytes;
+    uint32_t _rowBytes;
+    tiledLevel _level[TILED_IMAGE_MAX_LEVELS];
+
+    uint8_t *_cache = NULL;
+    tileSlot *_slots = NULL;
+    uint8_t _cacheTiles = 0;
+    uint32_t _useCounter = 0;
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+
+    const uint8_t *getTile(uint8_t _l, uint16_t _tx, uint16_t _ty);
+    void blitTile(const uint8_t *_t, tiledLevel *lv, int32_t _tileX, int32_t _tileY, int32_t _srcX, int32_t _srcY, int16_t _x, int16_t _y, int16_t _w, int16_t _h);
+    uint8_t tilePixel(const uint8_t *_t, uint16_t _px, uint16_t _py);
+};
+
+#endif
@@ -0,0 +1,46 @@
+//This example shows a clock that lives on an energy budget. Every minute it estimates what a full refresh and a partial
+//update of the changed rows would cost (estimateRefreshEnergy()) and does the full refresh only while the budget allows it.
+//Counted energy of every refresh is printed to Serial Monitor.
+//If you measured the energy of the last refresh (e.g. with a power analyzer), type it into Serial Monitor in mJ and the model
+//will be scaled to match it.
+
+#include "Inkplate6Plus.h"
+Inkplate display(INKPLATE_1BIT);
+
+float budget = 2000;            // Energy left for refreshes (mJ)
+const float perMinute = 20;     // Energy added to the budget every minute (mJ)
+int minutes = 0;
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+  display.setEnergyAccounting(true);
+  display.setTextSize(10);
+  display.setTextColor(BLACK, WHITE);
+}
+
+void loop() {
+  display.fillRect(0, 300, E_INK_WIDTH, 100, WHITE);
+  display.setCursor(300, 300);
+  display.printf("%02d:%02d", minutes / 60, minutes % 60);
+
+  float full = display.estimateRefreshEnergy(false);
+  float partial = display.estimateRefreshEnergy(true, 300, 399);
+  display.resetEnergyStats(); // So total of the counters is only this refresh, calibrateEnergy() uses it
+  if (minutes % 10 == 0 && full < budget) display.display();
+  else display.partialUpdate(300, 399);
+
+  energyStats e = display.getEnergyStats();
+  budget += perMinute - e.last;
+  Serial.printf("Estimated: full %.1f mJ, partial %.1f mJ. Counted: %.1f mJ, budget %.1f mJ\n", full, partial,
+                e.last, budget);
+
+  if (Serial.available())
+  {
+    float measured = Serial.parseFloat();
+    if (display.calibrateEnergy(measured)) Serial.println("Energy model calibrated");
+  }
+
+  minutes++;
+  delay(60000);
+}
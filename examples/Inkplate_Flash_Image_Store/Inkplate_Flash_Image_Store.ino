@@ -0,0 +1,60 @@
+//This example shows how to keep fixed set of images (e.g. signage backgrounds) in ESP32 flash instead of on SD card.
+//Images are stored as ready framebuffer content, so showing them is just a copy from memory mapped flash, and SD card
+//doesn't have to be initialized on every wake up from deep sleep.
+//
+//For this example you will need:
+// - custom partition table with "images" data partition (partitions.csv from this folder, copy it next to your sketch)
+//   (it has room for 6 images in 3 bit mode; replacing an image needs room for one more, the old one is removed only
+//   after the new one is completely written)
+// - on first run only: SD card with 24 bit bitmap images named image1.bmp ... image3.bmp in root directory
+
+#include <Inkplate6Plus.h>          //Include Inkplate Library
+Inkplate display(INKPLATE_3BIT);    //Constructor on Inkplate object
+
+#define NUMBER_OF_IMAGES 3
+RTC_DATA_ATTR int current = 0;      //Keep index of image that is shown in RTC RAM, so it survives deep sleep
+
+void setup() {
+  char name[20];
+  Serial.begin(115200);
+  display.begin();
+
+  if (!display.flashStoreBegin()) {
+    display.println("No \"images\" partition! Check partition table.");
+    display.display();
+    while (true);
+  }
+
+  //If images are not in flash yet, load them once from SD card
+  if (display.flashStoreCount() < NUMBER_OF_IMAGES) {
+    if (!display.sdCardInit()) {
+      display.println("SD Card error!");
+      display.display();
+      while (true);
+    }
+    for (int i = 1; i <= NUMBER_OF_IMAGES; i++) {
+      sprintf(name, "image%d.bmp", i);
+      display.clearDisplay();
+      if (display.drawBitmapFromSD(name, 0, 0)) {
+        display.flashStoreSave(name);
+        Serial.printf("%s saved into flash\n", name);
+      }
+    }
+  }
+
+  //Show next image straight from flash
+  current = (current % NUMBER_OF_IMAGES) + 1;
+  sprintf(name, "image%d.bmp", current);
+  unsigned long t = micros();
+  if (display.flashStoreDraw(name)) {
+    Serial.printf("%s loaded from flash in %lu us\n", name, micros() - t);
+    display.display();
+  }
+
+  //Go to sleep for 30 seconds
+  esp_sleep_enable_timer_wakeup(30 * 1000000ULL);
+  esp_deep_sleep_start();
+}
+
+void loop() {
+}
@@ -0,0 +1,51 @@
+//This example measures how much time is spent at the start of every frame of the refresh.
+//Start of the frame needs SPV line of the panel, which is connected to I/O expander (I2C), so every change of it is I2C transaction.
+//The same full refresh is done three times and frame start time and refresh time are measured for each:
+// - original: I/O expander at 100 kHz (old default I2C speed), both SPV writes in the frame start
+// - fast I2C: I/O expander at MCP23017_FAST_CLOCK, both SPV writes in the frame start (it's I2C_BUS_CLOCK, 400 kHz, unless
+//   the library is built with e.g. MCP23017_FAST_CLOCK=1000000; other devices on the bus are only rated for 400 kHz)
+// - staged: fast I2C, and SPV low write is done at the end of the gap between frames (setFrameStartStaging())
+//Refresh statistics show where the rest of the refresh time goes (power up, clean frames, data frames, gaps, power down).
+//Results are printed on Serial Monitor (115200 baud).
+
+#include <Inkplate6Plus.h>          //Include Inkplate Library
+Inkplate display(INKPLATE_1BIT);    //Constructor on Inkplate object
+
+//Full refresh with internal I/O expander (SPV) at selected I2C clock, prints measured frame start and refresh time.
+void measure(const char *name, uint32_t clock, bool staging)
+{
+  display.i2cSetClock(MCP23017_INT_ADDR, clock);
+  display.setFrameStartStaging(staging);
+  display.resetRefreshStats();
+  unsigned long t = millis();
+  display.display();
+  t = millis() - t;
+  Serial.printf("%s: frame start %d us, full refresh %d ms\n", name, display.getFrameStartTime(), t);
+}
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+
+  display.clearDisplay();
+  display.setTextSize(4);
+  display.setCursor(100, 100);
+  display.print("Frame timing test");
+  display.setRefreshStats(true);
+  measure("Original", 100000, false);
+  measure("Fast I2C", MCP23017_FAST_CLOCK, false);
+  measure("Staged", MCP23017_FAST_CLOCK, true);
+  display.printRefreshStats(Serial);
+  display.setFrameStartStaging(VSCAN_STAGE_SPV);
+
+  display.resetRefreshStats();
+  display.setCursor(100, 200);
+  display.print("Partial update");
+  display.partialUpdate();
+  display.printRefreshStats(Serial);
+  display.setRefreshStats(false);
+}
+
+void loop() {
+  //Nothing...
+}
@@ -0,0 +1,44 @@
+//This example shows how to recognize touch gestures (tap, double tap, long press, swipe and pinch).
+//Touch samples are collected in the background (touch events), gesture recognizer is fed with them and screen is updated only
+//when the whole gesture is recognized.
+
+#include "Inkplate6Plus.h"          //Include Inkplate Library
+#include "InkplateGesture.h"        //Include gesture recognizer
+Inkplate display(INKPLATE_1BIT);    //Constructor on Inkplate object
+InkplateGesture gestures;           //Constructor on gesture recognizer
+
+const char *names[] = {"none", "tap", "double tap", "long press", "swipe left", "swipe right", "swipe up", "swipe down", "pinch in", "pinch out"};
+
+void showGesture(gestureEvent &g)
+{
+  display.clearDisplay();
+  display.setCursor(20, 20);
+  display.printf("%s at (%d, %d)", names[g.type], g.x, g.y);
+  if (g.type >= GESTURE_PINCH_IN) display.printf(", scale %.2f", g.scale);
+  display.fillCircle(g.x, g.y, 10, BLACK);
+  display.partialUpdate();
+}
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+  if (!display.tsInit(true) || !display.tsEventsBegin())
+  {
+    Serial.println("Touchscreen init fail");
+    while (true);
+  }
+  gestures.setSwipe(150, 800);    //Swipe has to be at least 150 pixels long and done in 800 ms
+  display.setTextSize(3);
+  display.display();
+}
+
+void loop()
+{
+  touchEvent e;
+  gestureEvent g;
+  while (display.tsGetEvents(&e, 1))
+  {
+    if (gestures.feed(e, &g)) showGesture(g);
+  }
+  if (gestures.update(millis(), &g)) showGesture(g);
+}
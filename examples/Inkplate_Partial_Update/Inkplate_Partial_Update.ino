@@ -34,6 +34,8 @@ void setup()
     display.display();                  // Put clear image on display
     display.setTextColor(BLACK, WHITE); // Set text color to be black and background color to be white
     display.setTextWrap(false);         // Disable text wraping
+    display.setPowerKeepAlive(1000);    // Keep panel power on for 1 second after each update, so fast successive
+                                        // partial updates don't have to power up the panel every time
 }
 
 void loop()
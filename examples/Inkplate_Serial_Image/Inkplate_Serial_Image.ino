@@ -0,0 +1,33 @@
+//This example shows how to draw bitmap image that is sent over UART, without storing it on SD card first.
+//Send 1 bit or 24 bit Windows Bitmap file (no compression) to Inkplate, for example on Linux:
+//  stty -F /dev/ttyUSB0 921600 raw && cat image.bmp > /dev/ttyUSB0
+//Image is decoded while it's being received, so no extra memory is needed for it.
+
+#include <Inkplate6Plus.h>          //Include Inkplate Library
+Inkplate display(INKPLATE_1BIT);    //Constructor on Inkplate object
+
+void setup() {
+  Serial.begin(921600);
+  Serial.setRxBufferSize(4096);     //Bigger RX buffer, so no data is lost while decoder draws pixels
+  display.begin();
+  display.clearDisplay();
+  display.setTextSize(3);
+  display.println("Send bitmap image over serial...");
+  display.display();
+}
+
+void loop() {
+  if (Serial.available()) {
+    //If no new data arrives for 2 seconds, transfer is considered as broken
+    Serial.setTimeout(2000);
+    display.clearDisplay();
+    if (display.drawBitmapFromStream(&Serial, 0, 0)) {
+      display.display();
+      Serial.println("OK");
+    } else {
+      Serial.println("Image error");
+    }
+    //Drop anything that is left from this transfer
+    while (Serial.available()) Serial.read();
+  }
+}
@@ -0,0 +1,33 @@
+//This example turns Inkplate into a serial log console. Everything received on UART is shown on a VT100/ANSI terminal
+//(cursor movement, erasing, scroll regions, underline and reverse text work, colors are ignored), for example on Linux:
+//  stty -F /dev/ttyUSB0 115200 raw && tail -f /var/log/syslog > /dev/ttyUSB0
+//Received text only goes into the character grid, the screen is refreshed at most once per second and only rows that
+//changed are refreshed, so fast output doesn't slow anything down.
+
+#include <Inkplate6Plus.h>          //Include Inkplate Library
+#include <InkplateTerminal.h>       //Include terminal console
+Inkplate display(INKPLATE_1BIT);    //Constructor on Inkplate object
+InkplateTerminal terminal(display); //Constructor on terminal object
+
+void setup() {
+  Serial.begin(115200);
+  Serial.setRxBufferSize(8192);     //Bigger RX buffer, so no data is lost during refresh
+  display.begin();
+  if (!terminal.begin(2)) {         //Scale 2: 12x16 pixel characters, 85 columns and 47 rows
+    Serial.println("Not enough memory for terminal");
+    while (true);
+  }
+  terminal.setRefreshInterval(1000);
+  terminal.printf("Inkplate terminal, %d x %d\n", terminal.getColumns(), terminal.getRows());
+  terminal.refresh();
+}
+
+void loop() {
+  uint8_t buf[256];
+  int n = Serial.available();
+  if (n > 0) {
+    n = Serial.readBytes(buf, n < (int)sizeof(buf) ? n : sizeof(buf));
+    terminal.write(buf, n);
+  }
+  terminal.poll();
+}
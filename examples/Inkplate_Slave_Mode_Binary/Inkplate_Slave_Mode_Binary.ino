@@ -0,0 +1,21 @@
+//This example shows binary slave mode. Host sends frames with one or more drawing commands over Serial and Inkplate
+//runs them. Frame format and list of commands are described in InkplateSlaveProtocol.h.
+//For example, frame that clears the screen, draws a line from (0, 0) to (100, 100) and updates the screen is:
+//A5 0C 00 15 02 00 00 00 00 64 00 64 00 01 16 <CRC16 low> <CRC16 high>
+
+#include "Inkplate6Plus.h"          //Include Inkplate Library
+#include "InkplateSlave.h"          //Include binary slave mode protocol
+Inkplate display(INKPLATE_1BIT);    //Constructor on Inkplate object
+InkplateSlave slave(display, Serial);
+
+void setup() {
+  //Host keeps up to SLAVE_RING_SIZE bytes unconfirmed and they pile up in Serial RX buffer while Inkplate refreshes the
+  //screen, so RX buffer has to be that big (default is 256 bytes). It has to be set before Serial.begin().
+  Serial.setRxBufferSize(SLAVE_RING_SIZE);
+  Serial.begin(115200);
+  display.begin();
+}
+
+void loop() {
+  slave.poll();   //Runs all frames that came over Serial
+}
@@ -0,0 +1,46 @@
+//This example shows how to make slideshow of images from SD card where loading of the next image is done while current image is being refreshed.
+//Loading and decoding of next image runs on the other core of ESP32, so one cycle takes as long as the longer of the two (refresh or loading), not both of them.
+//For this example you will need SD card with 24 bit bitmap images named image1.bmp, image2.bmp, ... image5.bmp in root directory.
+//All images must have the same color depth (1 bit or 24 bit), because display mode can't be changed while refresh is in progress.
+
+#include <Inkplate6Plus.h>          //Include Inkplate Library
+#include "SdFat.h"                  //Include modified SdFat library
+Inkplate display(INKPLATE_3BIT);    //Constructor on Inkplate object (3 bit mode for 24 bit bitmaps)
+
+#define NUMBER_OF_IMAGES 5
+int current = 1;
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+
+  if (!display.sdCardInit()) {
+    display.println("SD Card error!");
+    display.display();
+    while (true);
+  }
+
+  //Allocate spare framebuffer and start prefetch task
+  if (!display.slideshowBegin()) {
+    display.println("Not enough memory for slideshow!");
+    display.display();
+    while (true);
+  }
+
+  //First image is loaded the usual way
+  display.drawBitmapFromSD("image1.bmp", 0, 0);
+}
+
+void loop() {
+  char name[20];
+  current = (current % NUMBER_OF_IMAGES) + 1;
+  sprintf(name, "image%d.bmp", current);
+
+  //Show image that is in framebuffer and load next one in the background
+  unsigned long t = millis();
+  if (!display.displayAndPrefetch(name, 0, 0)) {
+    Serial.printf("Can't load %s\n", name);
+  }
+  Serial.printf("Cycle time: %lu ms\n", millis() - t);
+  delay(5000);
+}
@@ -0,0 +1,66 @@
+//This example shows how to pan and zoom over image that is much bigger than the screen.
+//Image has to be converted into tiled image format first using encoder from extras/tools folder of this library, for example:
+//  tiled_image_encoder -b 1 -t 128 map.pgm map.ipt
+//and copied into root directory of the SD card.
+//Touch left, right, top or bottom part of the screen to pan, touch the center of the screen with two fingers to zoom out, one finger to zoom in.
+
+#include <Inkplate6Plus.h>          //Include Inkplate Library
+#include <InkplateTiledImage.h>     //Include tiled image viewer
+Inkplate display(INKPLATE_1BIT);    //Constructor on Inkplate object
+InkplateTiledImage image(display);  //Constructor on tiled image viewer object
+
+uint8_t level = 0;
+int32_t posX = 0;
+int32_t posY = 0;
+
+void showView()
+{
+  display.clearDisplay();
+  int n = image.draw(level, posX, posY);
+  display.setCursor(10, 10);
+  display.printf("Level %d (%d, %d), %d tiles, cache %d/%d", level, posX, posY, n, image.getCacheHits(), image.getCacheMisses());
+  display.partialUpdate();
+}
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+  display.tsInit(true);
+  display.setTextSize(2);
+
+  //Init SD card and open tiled image.
+  if (!display.sdCardInit() || !image.open("map.ipt")) {
+    display.println("Can't open map.ipt");
+    display.display();
+    while (true);
+  }
+
+  display.display();
+  showView();
+}
+
+void loop() {
+  if (display.tsAvailable()) {
+    uint16_t x[2], y[2];
+    uint8_t n = display.tsGetData(x, y);
+    if (n == 0) return;
+
+    //Move for half of the screen in any direction or change zoom level if the center of the screen is touched.
+    int32_t w = display.width();
+    int32_t h = display.height();
+    if (x[0] < w / 4) posX -= w / 2;
+    else if (x[0] > w * 3 / 4) posX += w / 2;
+    else if (y[0] < h / 4) posY -= h / 2;
+    else if (y[0] > h * 3 / 4) posY += h / 2;
+    else if (n == 2 && level + 1 < image.getLevels()) {
+      level++;
+      posX /= 2;
+      posY /= 2;
+    } else if (n == 1 && level > 0) {
+      level--;
+      posX *= 2;
+      posY *= 2;
+    }
+    showView();
+  }
+}
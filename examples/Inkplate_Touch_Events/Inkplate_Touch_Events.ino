@@ -0,0 +1,43 @@
+//This example shows how to use touch events, so no touch is lost while display is refreshed.
+//Touchscreen interrupt wakes a small task that reads touchscreen and puts every sample (with time of the touch) into a queue.
+//Draw on the screen with one finger, every stroke is drawn with lines between samples and shown with partial update.
+//Samples that come in while partial update is in progress are not lost, they are drawn on next update.
+
+#include "Inkplate6Plus.h"
+Inkplate display(INKPLATE_1BIT);
+
+touchEvent events[32];
+bool penDown = false;
+uint16_t lastX, lastY;
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+  if (!display.tsInit(true) || !display.tsEventsBegin())
+  {
+    Serial.println("Touchscreen init fail");
+    while (true);
+  }
+  display.display();
+}
+
+void loop()
+{
+  uint16_t n = display.tsGetEvents(events, 32);
+  if (n == 0) return;
+
+  for (int i = 0; i < n; i++)
+  {
+    if (events[i].fingers == 0)
+    {
+      penDown = false;
+      continue;
+    }
+    if (penDown) display.drawLine(lastX, lastY, events[i].x[0], events[i].y[0], BLACK);
+    lastX = events[i].x[0];
+    lastY = events[i].y[0];
+    penDown = true;
+  }
+  Serial.printf("%d samples, last at %lu ms, %lu dropped\n", n, events[n - 1].time, display.tsGetDroppedEvents());
+  display.partialUpdate();
+}
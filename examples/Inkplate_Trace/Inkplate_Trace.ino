@@ -0,0 +1,48 @@
+//This example records what the library does while you draw on the touchscreen: refresh phases, I2C transactions and touch reads
+//(from the touch task, which can run on the other core). Draw for a few seconds, after 10 partial updates trace is written
+//to SD card as trace.json (and to Serial Monitor if there is no SD card).
+//Open the file in chrome://tracing or https://ui.perfetto.dev to see both cores on one time line.
+
+#include "Inkplate6Plus.h"
+Inkplate display(INKPLATE_1BIT);
+
+touchEvent events[32];
+int updates = 0;
+
+void setup() {
+  Serial.begin(115200);
+  display.begin();
+  if (!display.tsInit(true) || !display.tsEventsBegin())
+  {
+    Serial.println("Touchscreen init fail");
+    while (true);
+  }
+  display.display();
+  if (!display.traceBegin(4096)) Serial.println("Not enough memory for trace buffer");
+}
+
+void loop()
+{
+  uint16_t n = display.tsGetEvents(events, 32);
+  if (n == 0 || updates >= 10) return;
+
+  for (int i = 0; i < n; i++)
+  {
+    if (events[i].fingers) display.fillCircle(events[i].x[0], events[i].y[0], 5, BLACK);
+  }
+  display.partialUpdate();
+  if (++updates < 10) return;
+
+  SdFile file;
+  if (display.sdCardInit() && file.open("trace.json", O_CREAT | O_WRITE | O_TRUNC))
+  {
+    Serial.printf("%lu events written to trace.json\n", display.traceDump(file));
+    file.close();
+  }
+  else
+  {
+    display.traceDump(Serial);
+  }
+  Serial.printf("%lu events were dropped\n", display.getTraceDropped());
+  display.traceEnd();
+}
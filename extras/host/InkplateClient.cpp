@@ -0,0 +1,686 @@
+/***************************************************
+Host side client for Inkplate binary slave mode.
+See InkplateClient.h for description.
+ ****************************************************/
+
+#include "InkplateClient.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+InkplateClient::InkplateClient()
+{
+    memset(_hasResult, 0, sizeof(_hasResult));
+}
+
+InkplateClient::~InkplateClient()
+{
+    close();
+}
+
+static speed_t baudToSpeed(uint32_t _baud)
+{
+    switch (_baud)
+    {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+#ifdef B2000000
+    case 2000000: return B2000000;
+#endif
+    }
+    return B0;
+}
+
+// Opens serial port (or pseudo terminal) in raw mode.
+bool InkplateClient::open(const char *_dev, uint32_t _baud)
+{
+    close();
+    speed_t _speed = baudToSpeed(_baud);
+    if (_speed == B0) return false;
+    int _f = ::open(_dev, O_RDWR | O_NOCTTY);
+    if (_f < 0) return false;
+    struct termios _t;
+    if (tcgetattr(_f, &_t) != 0)
+    {
+        ::close(_f);
+        return false;
+    }
+    cfmakeraw(&_t);
+    cfsetispeed(&_t, _speed);
+    cfsetospeed(&_t, _speed);
+    _t.c_cflag |= CLOCAL | CREAD;
+    _t.c_cc[VMIN] = 0;
+    _t.c_cc[VTIME] = 0;
+    if (tcsetattr(_f, TCSANOW, &_t) != 0)
+    {
+        ::close(_f);
+        return false;
+    }
+    attach(_f);
+    _ownFd = true;
+    return true;
+}
+
+// Uses already opened file descriptor (socket, pipe, ...). It's not closed by close().
+void InkplateClient::attach(int _f)
+{
+    close();
+    _fd = _f;
+    _ownFd = false;
+}
+
+void InkplateClient::close()
+{
+    if (_fd >= 0 && _ownFd) ::close(_fd);
+    _fd = -1;
+    _frame.clear();
+    _inFlight.clear();
+    _inFlightBytes = 0;
+    _rx.clear();
+}
+
+// Max payload of one frame. Bigger frames have less overhead, smaller ones keep more of them in flight.
+void InkplateClient::setFrameSize(uint16_t _size)
+{
+    if (_size < 16) _size = 16;
+    if (_size > SLAVE_MAX_PAYLOAD) _size = SLAVE_MAX_PAYLOAD;
+    _frameSize = _size;
+}
+
+// Max number of bytes that are sent and not confirmed yet. It must not be bigger than receive buffers on Inkplate side
+// (ring buffer of InkplateSlave and serial receive buffer), or data is lost while Inkplate refreshes the screen.
+void InkplateClient::setWindow(uint32_t _bytes)
+{
+    _window = _bytes;
+}
+
+void InkplateClient::setTimeout(uint32_t _ms)
+{
+    _timeout = _ms;
+}
+
+uint32_t InkplateClient::getFramesSent()
+{
+    return _framesSent;
+}
+
+uint64_t InkplateClient::getBytesSent()
+{
+    return _bytesSent;
+}
+
+uint32_t InkplateClient::getCommands()
+{
+    return _commands;
+}
+
+// Number of frames or commands that Inkplate rejected (wrong CRC, unknown opcode, wrong length).
+uint32_t InkplateClient::getNaks()
+{
+    return _naks;
+}
+
+// Number of timeouts and broken response frames.
+uint32_t InkplateClient::getErrors()
+{
+    return _errors;
+}
+
+uint16_t InkplateClient::crc16(uint16_t _crc, uint8_t _b)
+{
+    _crc ^= (uint16_t)_b << 8;
+    for (int i = 0; i < 8; i++)
+        _crc = (_crc & 0x8000) ? (_crc << 1) ^ 0x1021 : (_crc << 1);
+    return _crc;
+}
+
+// PackBits compression (header 0-127: 1-128 literal bytes follow, header 129-255: next byte is repeated 2-128 times).
+void InkplateClient::packBits(const uint8_t *_in, size_t _n, std::vector<uint8_t> &_out)
+{
+    _out.clear();
+    size_t i = 0;
+    while (i < _n)
+    {
+        size_t _run = 1;
+        while (i + _run < _n && _run < 128 && _in[i + _run] == _in[i])
+            _run++;
+        if (_run >= 2)
+        {
+            _out.push_back(257 - _run);
+            _out.push_back(_in[i]);
+            i += _run;
+            continue;
+        }
+        size_t _start = i;
+        while (i < _n && i - _start < 128 && !(i + 1 < _n && _in[i] == _in[i + 1]))
+            i++;
+        _out.push_back(i - _start - 1);
+        _out.insert(_out.end(), _in + _start, _in + i);
+    }
+}
+
+// Starts new command, current frame is sent first if the command doesn't fit into it (one byte stays free for echo).
+void InkplateClient::begin(uint8_t _op, size_t _argSize)
+{
+    if (!_frame.empty() && _frame.size() + 1 + _argSize + 1 > _frameSize) sendFrame();
+    _frame.push_back(_op);
+    _commands++;
+}
+
+void InkplateClient::put8(uint8_t _b)
+{
+    _frame.push_back(_b);
+}
+
+void InkplateClient::put16(int16_t _v)
+{
+    _frame.push_back(_v & 0xFF);
+    _frame.push_back((uint16_t)_v >> 8);
+}
+
+void InkplateClient::putString(const char *_s, size_t _n)
+{
+    put16(_n);
+    _frame.insert(_frame.end(), (const uint8_t *)_s, (const uint8_t *)_s + _n);
+}
+
+// Adds any command (for opcodes that have no function here). _args are already encoded arguments.
+void InkplateClient::command(uint8_t _op, const uint8_t *_args, size_t _n)
+{
+    begin(_op, _n);
+    _frame.insert(_frame.end(), _args, _args + _n);
+}
+
+// Writes bytes straight to the link, bypassing framing (for testing error handling).
+void InkplateClient::writeRaw(const uint8_t *_d, size_t _n)
+{
+    flush();
+    writeAll(_d, _n);
+}
+
+void InkplateClient::drawPixel(int16_t _x, int16_t _y, uint8_t _c)
+{
+    begin(SLAVE_DRAW_PIXEL, 5);
+    put16(_x);
+    put16(_y);
+    put8(_c);
+}
+
+void InkplateClient::drawLine(int16_t _x1, int16_t _y1, int16_t _x2, int16_t _y2, uint8_t _c)
+{
+    begin(SLAVE_DRAW_LINE, 9);
+    put16(_x1);
+    put16(_y1);
+    put16(_x2);
+    put16(_y2);
+    put8(_c);
+}
+
+void InkplateClient::drawFastVLine(int16_t _x, int16_t _y, int16_t _l, uint8_t _c)
+{
+    begin(SLAVE_DRAW_FAST_VLINE, 7);
+    put16(_x);
+    put16(_y);
+    put16(_l);
+    put8(_c);
+}
+
+void InkplateClient::drawFastHLine(int16_t _x, int16_t _y, int16_t _l, uint8_t _c)
+{
+    begin(SLAVE_DRAW_FAST_HLINE, 7);
+    put16(_x);
+    put16(_y);
+    put16(_l);
+    put8(_c);
+}
+
+void InkplateClient::drawRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _c)
+{
+    begin(SLAVE_DRAW_RECT, 9);
+    put16(_x);
+    put16(_y);
+    put16(_w);
+    put16(_h);
+    put8(_c);
+}
+
+void InkplateClient::drawCircle(int16_t _x, int16_t _y, int16_t _r, uint8_t _c)
+{
+    begin(SLAVE_DRAW_CIRCLE, 7);
+    put16(_x);
+    put16(_y);
+    put16(_r);
+    put8(_c);
+}
+
+void InkplateClient::drawTriangle(int16_t _x1, int16_t _y1, int16_t _x2, int16_t _y2, int16_t _x3, int16_t _y3, uint8_t _c)
+{
+    begin(SLAVE_DRAW_TRIANGLE, 13);
+    put16(_x1);
+    put16(_y1);
+    put16(_x2);
+    put16(_y2);
+    put16(_x3);
+    put16(_y3);
+    put8(_c);
+}
+
+void InkplateClient::drawRoundRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, int16_t _r, uint8_t _c)
+{
+    begin(SLAVE_DRAW_ROUND_RECT, 11);
+    put16(_x);
+    put16(_y);
+    put16(_w);
+    put16(_h);
+    put16(_r);
+    put8(_c);
+}
+
+void InkplateClient::fillRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _c)
+{
+    begin(SLAVE_FILL_RECT, 9);
+    put16(_x);
+    put16(_y);
+    put16(_w);
+    put16(_h);
+    put8(_c);
+}
+
+void InkplateClient::fillCircle(int16_t _x, int16_t _y, int16_t _r, uint8_t _c)
+{
+    begin(SLAVE_FILL_CIRCLE, 7);
+    put16(_x);
+    put16(_y);
+    put16(_r);
+    put8(_c);
+}
+
+void InkplateClient::fillTriangle(int16_t _x1, int16_t _y1, int16_t _x2, int16_t _y2, int16_t _x3, int16_t _y3, uint8_t _c)
+{
+    begin(SLAVE_FILL_TRIANGLE, 13);
+    put16(_x1);
+    put16(_y1);
+    put16(_x2);
+    put16(_y2);
+    put16(_x3);
+    put16(_y3);
+    put8(_c);
+}
+
+void InkplateClient::fillRoundRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, int16_t _r, uint8_t _c)
+{
+    begin(SLAVE_FILL_ROUND_RECT, 11);
+    put16(_x);
+    put16(_y);
+    put16(_w);
+    put16(_h);
+    put16(_r);
+    put8(_c);
+}
+
+// Long strings are split into more print commands, so every part fits into one frame.
+void InkplateClient::print(const char *_s)
+{
+    size_t _n = strlen(_s);
+    do
+    {
+        size_t _part = _n;
+        if (_part > (size_t)_frameSize - 4) _part = _frameSize - 4;
+        begin(SLAVE_PRINT, 2 + _part);
+        putString(_s, _part);
+        _s += _part;
+        _n -= _part;
+    } while (_n);
+}
+
+void InkplateClient::setTextSize(uint8_t _s)
+{
+    begin(SLAVE_SET_TEXT_SIZE, 1);
+    put8(_s);
+}
+
+void InkplateClient::setCursor(int16_t _x, int16_t _y)
+{
+    begin(SLAVE_SET_CURSOR, 4);
+    put16(_x);
+    put16(_y);
+}
+
+void InkplateClient::setTextWrap(bool _w)
+{
+    begin(SLAVE_SET_TEXT_WRAP, 1);
+    put8(_w);
+}
+
+void InkplateClient::setRotation(uint8_t _r)
+{
+    begin(SLAVE_SET_ROTATION, 1);
+    put8(_r);
+}
+
+int InkplateClient::drawBitmap(int16_t _x, int16_t _y, const char *_path)
+{
+    size_t _n = strlen(_path);
+    std::vector<uint8_t> _a(6 + _n);
+    _a[0] = _x & 0xFF;
+    _a[1] = (uint16_t)_x >> 8;
+    _a[2] = _y & 0xFF;
+    _a[3] = (uint16_t)_y >> 8;
+    _a[4] = _n & 0xFF;
+    _a[5] = _n >> 8;
+    memcpy(&_a[6], _path, _n);
+    return query(SLAVE_DRAW_BITMAP, _a.data(), _a.size());
+}
+
+void InkplateClient::setDisplayMode(uint8_t _m)
+{
+    begin(SLAVE_SET_DISPLAY_MODE, 1);
+    put8(_m);
+    _mode = _m ? 1 : 0;
+}
+
+int InkplateClient::getDisplayMode()
+{
+    int _r = query(SLAVE_GET_DISPLAY_MODE, NULL, 0);
+    if (_r != CLIENT_NO_RESULT) _mode = _r;
+    return _r;
+}
+
+void InkplateClient::clearDisplay()
+{
+    begin(SLAVE_CLEAR_DISPLAY, 0);
+}
+
+void InkplateClient::display()
+{
+    begin(SLAVE_DISPLAY, 0);
+}
+
+void InkplateClient::partialUpdate()
+{
+    begin(SLAVE_PARTIAL_UPDATE, 0);
+}
+
+void InkplateClient::partialUpdate(int16_t _y1, int16_t _y2)
+{
+    begin(SLAVE_PARTIAL_ROWS, 4);
+    put16(_y1);
+    put16(_y2);
+}
+
+int InkplateClient::readTemperature()
+{
+    return query(SLAVE_READ_TEMPERATURE, NULL, 0);
+}
+
+// Battery voltage in volts, negative if there was no answer.
+double InkplateClient::readBattery()
+{
+    int _mv = query(SLAVE_READ_BATTERY, NULL, 0);
+    return _mv == CLIENT_NO_RESULT ? -1 : _mv / 1000.0;
+}
+
+void InkplateClient::panelSupply(bool _on)
+{
+    begin(SLAVE_PANEL_SUPPLY, 1);
+    put8(_on);
+}
+
+int InkplateClient::getPanelState()
+{
+    return query(SLAVE_GET_PANEL_STATE, NULL, 0);
+}
+
+// Uploads region of framebuffer in Inkplate layout (w / 8 bytes per row in 1 bit mode, w / 2 in 3 bit mode). If _prev
+// (previous content of the same region) is given, only XOR delta is sent. Returns true if Inkplate got the whole region.
+bool InkplateClient::upload(int16_t _x, int16_t _y, int16_t _w, int16_t _h, const uint8_t *_data, const uint8_t *_prev,
+                            bool _rle, bool _update)
+{
+    uint8_t _ppb = _mode ? 2 : 8;
+    if (_w <= 0 || _h <= 0 || _w % _ppb) return false;
+    size_t _size = (size_t)(_w / _ppb) * _h;
+    uint8_t _flags = 0;
+    const uint8_t *_src = _data;
+    std::vector<uint8_t> _delta, _packed;
+    if (_prev != NULL)
+    {
+        _delta.resize(_size);
+        for (size_t i = 0; i < _size; i++)
+            _delta[i] = _data[i] ^ _prev[i];
+        _src = _delta.data();
+        _flags |= SLAVE_UPLOAD_XOR;
+    }
+    if (_rle)
+    {
+        packBits(_src, _size, _packed);
+        _src = _packed.data();
+        _size = _packed.size();
+        _flags |= SLAVE_UPLOAD_RLE;
+    }
+
+    const uint8_t _a[9] = {(uint8_t)_x, (uint8_t)((uint16_t)_x >> 8), (uint8_t)_y, (uint8_t)((uint16_t)_y >> 8),
+                           (uint8_t)_w, (uint8_t)((uint16_t)_w >> 8), (uint8_t)_h, (uint8_t)((uint16_t)_h >> 8), _flags};
+    command(SLAVE_UPLOAD_BEGIN, _a, sizeof(_a));
+    _hasResult[SLAVE_UPLOAD_BEGIN] = false;
+
+    // Data fills the rest of every frame (uploadData opcode, length and echo at the end take 4 bytes)
+    size_t _off = 0;
+    while (_off < _size)
+    {
+        if (_frame.size() + 5 > _frameSize) sendFrame();
+        size_t _n = _frameSize - _frame.size() - 4;
+        if (_n > _size - _off) _n = _size - _off;
+        begin(SLAVE_UPLOAD_DATA, 2 + _n);
+        putString((const char *)_src + _off, _n);
+        _off += _n;
+    }
+
+    uint8_t _u = _update;
+    int _r = query(SLAVE_UPLOAD_END, &_u, 1);
+    return _r == 1 && _hasResult[SLAVE_UPLOAD_BEGIN] && _result[SLAVE_UPLOAD_BEGIN] == 1;
+}
+
+// Round trip: sends everything and waits until Inkplate confirms it.
+bool InkplateClient::echo()
+{
+    if (_frame.empty() && !sendFrame()) return false;
+    return sync();
+}
+
+// Sends current frame (doesn't wait for confirmation).
+bool InkplateClient::flush()
+{
+    if (_frame.empty()) return true;
+    return sendFrame();
+}
+
+// Sends current frame and waits until all sent frames are confirmed.
+bool InkplateClient::sync()
+{
+    if (!flush()) return false;
+    while (!_inFlight.empty())
+    {
+        if (!receive(_timeout))
+        {
+            _errors++;
+            _inFlight.clear();
+            _inFlightBytes = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+int InkplateClient::query(uint8_t _op, const uint8_t *_args, size_t _n)
+{
+    command(_op, _args, _n);
+    _hasResult[_op] = false;
+    if (!sync() || !_hasResult[_op]) return CLIENT_NO_RESULT;
+    return _result[_op];
+}
+
+bool InkplateClient::sendFrame()
+{
+    _frame.push_back(SLAVE_ECHO);
+    uint16_t _n = _frame.size();
+    std::vector<uint8_t> _buf(_n + 5);
+    _buf[0] = SLAVE_SYNC;
+    _buf[1] = _n & 0xFF;
+    _buf[2] = _n >> 8;
+    memcpy(&_buf[3], _frame.data(), _n);
+    uint16_t _crc = 0xFFFF;
+    for (int i = 1; i < _n + 3; i++)
+        _crc = crc16(_crc, _buf[i]);
+    _buf[_n + 3] = _crc & 0xFF;
+    _buf[_n + 4] = _crc >> 8;
+    _frame.clear();
+
+    // Wait until Inkplate has room for this frame
+    while (!_inFlight.empty() && _inFlightBytes + _buf.size() > _window)
+    {
+        if (!receive(_timeout))
+        {
+            _errors++;
+            _inFlight.clear();
+            _inFlightBytes = 0;
+        }
+    }
+
+    if (!writeAll(_buf.data(), _buf.size())) return false;
+    _inFlight.push_back(_buf.size());
+    _inFlightBytes += _buf.size();
+    _framesSent++;
+    _bytesSent += _buf.size();
+    return true;
+}
+
+bool InkplateClient::writeAll(const uint8_t *_d, size_t _n)
+{
+    if (_fd < 0) return false;
+    while (_n)
+    {
+        ssize_t _w = ::write(_fd, _d, _n);
+        if (_w < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN) return false;
+            struct pollfd _p = {_fd, POLLOUT, 0};
+            poll(&_p, 1, _timeout);
+            continue;
+        }
+        _d += _w;
+        _n -= _w;
+    }
+    return true;
+}
+
+// Waits up to _ms for data from Inkplate and parses everything that came. Returns false on timeout.
+bool InkplateClient::receive(uint32_t _ms)
+{
+    if (_fd < 0) return false;
+    struct pollfd _p = {_fd, POLLIN, 0};
+    if (poll(&_p, 1, _ms) <= 0) return false;
+    uint8_t _buf[4096];
+    ssize_t _n = ::read(_fd, _buf, sizeof(_buf));
+    if (_n <= 0) return _n < 0 && (errno == EINTR || errno == EAGAIN);
+    _rx.insert(_rx.end(), _buf, _buf + _n);
+    parseResponses();
+    return true;
+}
+
+void InkplateClient::parseResponses()
+{
+    size_t i = 0;
+    while (true)
+    {
+        while (i < _rx.size() && _rx[i] != SLAVE_SYNC)
+        {
+            i++;
+            _errors++;
+        }
+        if (_rx.size() - i < 3) break;
+        uint16_t _len = _rx[i + 1] | (_rx[i + 2] << 8);
+        if (_len > SLAVE_MAX_PAYLOAD)
+        {
+            i++;
+            _errors++;
+            continue;
+        }
+        if (_rx.size() - i < (size_t)_len + 5) break;
+        uint16_t _crc = 0xFFFF;
+        for (size_t j = i + 1; j < i + _len + 3; j++)
+            _crc = crc16(_crc, _rx[j]);
+        if (_crc != (_rx[i + _len + 3] | (_rx[i + _len + 4] << 8)))
+        {
+            i++;
+            _errors++;
+            continue;
+        }
+        parseFrame(&_rx[i + 3], _len);
+        i += _len + 5;
+    }
+    _rx.erase(_rx.begin(), _rx.begin() + i);
+}
+
+// One response frame, it can hold results of many commands.
+void InkplateClient::parseFrame(const uint8_t *_d, size_t _n)
+{
+    size_t _p = 0;
+    while (_p < _n)
+    {
+        uint8_t _op = _d[_p++];
+        if (_op == SLAVE_NAK)
+        {
+            // Frame with wrong command is stopped, so its echo never comes. Frame with wrong CRC can't be matched to sent
+            // frames (it may be just noise on the line), so it's left to time out in sync().
+            _naks++;
+            uint8_t _err = _p < _n ? _d[_p++] : 0;
+            if (_err == SLAVE_ERR_CRC) continue;
+            if (_p < _n) _p++;
+            confirm();
+            continue;
+        }
+        if (_op == (SLAVE_ECHO | SLAVE_RESPONSE))
+        {
+            confirm();
+            continue;
+        }
+        _op &= ~SLAVE_RESPONSE;
+        int _v;
+        if (_op == SLAVE_READ_BATTERY)
+        {
+            if (_p + 2 > _n) return;
+            _v = _d[_p] | (_d[_p + 1] << 8);
+            _p += 2;
+        }
+        else
+        {
+            if (_p >= _n) return;
+            _v = (_op == SLAVE_DRAW_BITMAP || _op == SLAVE_READ_TEMPERATURE) ? (int8_t)_d[_p] : _d[_p];
+            _p++;
+        }
+        _result[_op] = _v;
+        _hasResult[_op] = true;
+    }
+}
+
+void InkplateClient::confirm()
+{
+    if (_inFlight.empty()) return;
+    _inFlightBytes -= _inFlight.front();
+    _inFlight.pop_front();
+}
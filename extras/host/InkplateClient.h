@@ -0,0 +1,117 @@
+/***************************************************
+Host side client for Inkplate binary slave mode (see InkplateSlaveProtocol.h).
+
+Talks to Inkplate running InkplateSlave over a serial port (or any file descriptor) on Linux. Commands are batched into
+frames, frame is sent when the next command doesn't fit into it or on flush(). Frames are pipelined: client doesn't wait
+for the answer to every frame, it only keeps the number of unconfirmed bytes below what Inkplate can buffer (window).
+Every frame ends with echo command and its response confirms the whole frame. Commands that return something (queries)
+send the current frame and wait until all sent frames are confirmed.
+ ****************************************************/
+
+#ifndef __INKPLATECLIENT_H__
+#define __INKPLATECLIENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include "../../InkplateSlaveProtocol.h"
+
+#define CLIENT_FRAME_SIZE   1024                    // Default max payload of one frame
+// Default max number of sent and unconfirmed bytes. Inkplate has to be able to buffer all of them in its serial RX buffer
+// while it runs a long command (Serial.setRxBufferSize(SLAVE_RING_SIZE), default ESP32 RX buffer is 256 bytes).
+#define CLIENT_WINDOW       (SLAVE_RING_SIZE - 1)
+#define CLIENT_TIMEOUT_MS   5000
+#define CLIENT_NO_RESULT    (-1000)                 // Returned by queries if there was no answer
+
+class InkplateClient {
+  public:
+    InkplateClient();
+    ~InkplateClient();
+    bool open(const char *_dev, uint32_t _baud = 115200);
+    void attach(int _fd);
+    void close();
+    void setFrameSize(uint16_t _size);
+    void setWindow(uint32_t _bytes);
+    void setTimeout(uint32_t _ms);
+
+    void drawPixel(int16_t _x, int16_t _y, uint8_t _c);
+    void drawLine(int16_t _x1, int16_t _y1, int16_t _x2, int16_t _y2, uint8_t _c);
+    void drawFastVLine(int16_t _x, int16_t _y, int16_t _l, uint8_t _c);
+    void drawFastHLine(int16_t _x, int16_t _y, int16_t _l, uint8_t _c);
+    void drawRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _c);
+    void drawCircle(int16_t _x, int16_t _y, int16_t _r, uint8_t _c);
+    void drawTriangle(int16_t _x1, int16_t _y1, int16_t _x2, int16_t _y2, int16_t _x3, int16_t _y3, uint8_t _c);
+    void drawRoundRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, int16_t _r, uint8_t _c);
+    void fillRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _c);
+    void fillCircle(int16_t _x, int16_t _y, int16_t _r, uint8_t _c);
+    void fillTriangle(int16_t _x1, int16_t _y1, int16_t _x2, int16_t _y2, int16_t _x3, int16_t _y3, uint8_t _c);
+    void fillRoundRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, int16_t _r, uint8_t _c);
+    void print(const char *_s);
+    void setTextSize(uint8_t _s);
+    void setCursor(int16_t _x, int16_t _y);
+    void setTextWrap(bool _w);
+    void setRotation(uint8_t _r);
+    int drawBitmap(int16_t _x, int16_t _y, const char *_path);
+    void setDisplayMode(uint8_t _mode);
+    int getDisplayMode();
+    void clearDisplay();
+    void display();
+    void partialUpdate();
+    void partialUpdate(int16_t _y1, int16_t _y2);
+    int readTemperature();
+    double readBattery();
+    void panelSupply(bool _on);
+    int getPanelState();
+    bool upload(int16_t _x, int16_t _y, int16_t _w, int16_t _h, const uint8_t *_data, const uint8_t *_prev = NULL,
+                bool _rle = true, bool _update = true);
+    void command(uint8_t _op, const uint8_t *_args, size_t _n);
+    void writeRaw(const uint8_t *_d, size_t _n);
+    bool echo();
+    bool flush();
+    bool sync();
+
+    uint32_t getFramesSent();
+    uint64_t getBytesSent();
+    uint32_t getCommands();
+    uint32_t getNaks();
+    uint32_t getErrors();
+
+    static void packBits(const uint8_t *_in, size_t _n, std::vector<uint8_t> &_out);
+    static uint16_t crc16(uint16_t _crc, uint8_t _b);
+
+  private:
+    int _fd = -1;
+    bool _ownFd = false;
+    uint16_t _frameSize = CLIENT_FRAME_SIZE;
+    uint32_t _window = CLIENT_WINDOW;
+    uint32_t _timeout = CLIENT_TIMEOUT_MS;
+    uint8_t _mode = 0;
+
+    std::vector<uint8_t> _frame;        // Payload of the frame that is being built
+    std::deque<uint32_t> _inFlight;     // Sizes of sent frames that are not confirmed yet
+    uint32_t _inFlightBytes = 0;
+    std::vector<uint8_t> _rx;           // Received bytes that are not parsed yet
+    int _result[128];
+    bool _hasResult[128];
+
+    uint32_t _framesSent = 0;
+    uint64_t _bytesSent = 0;
+    uint32_t _commands = 0;
+    uint32_t _naks = 0;
+    uint32_t _errors = 0;
+
+    void begin(uint8_t _op, size_t _argSize);
+    void put8(uint8_t _b);
+    void put16(int16_t _v);
+    void putString(const char *_s, size_t _n);
+    int query(uint8_t _op, const uint8_t *_args, size_t _n);
+    bool sendFrame();
+    bool writeAll(const uint8_t *_d, size_t _n);
+    bool receive(uint32_t _ms);
+    void parseResponses();
+    void parseFrame(const uint8_t *_d, size_t _n);
+    void confirm();
+};
+
+#endif
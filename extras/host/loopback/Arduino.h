@@ -0,0 +1,41 @@
+/***************************************************
+Minimal Arduino API for running InkplateSlave on Linux (only what the slave mode code uses).
+ ****************************************************/
+
+#ifndef __ARDUINO_H__
+#define __ARDUINO_H__
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 1
+#define LOW  0
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long _ms);
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t _c) = 0;
+    virtual size_t write(const uint8_t *_b, size_t _n)
+    {
+        size_t _r = 0;
+        while (_n--) _r += write(*_b++);
+        return _r;
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t readBytes(uint8_t *_b, size_t _n) = 0;
+    virtual void flush() {}
+};
+
+#endif
@@ -0,0 +1,197 @@
+/***************************************************
+Simulated Inkplate class for running InkplateSlave on Linux.
+
+It has the same functions that InkplateSlave calls. Pixels, rectangles and framebuffer uploads are written into
+framebuffers with the same layout as on Inkplate, everything else is only counted (calls[] is indexed by slave mode
+opcode). Include guard is the same as the one of Inkplate6Plus.h, so InkplateSlave.cpp uses this class when this file is
+included before it.
+ ****************************************************/
+
+#ifndef __INKPLATE6PLUS_H__
+#define __INKPLATE6PLUS_H__
+
+#include "Arduino.h"
+#include "../../../InkplateSlaveProtocol.h"
+
+#define E_INK_WIDTH   1024
+#define E_INK_HEIGHT  758
+#define INKPLATE_1BIT 0
+#define INKPLATE_3BIT 1
+#define UPLOAD_RLE    1
+#define UPLOAD_XOR    2
+
+class Inkplate : public Print {
+  public:
+    uint8_t _partial[E_INK_WIDTH * E_INK_HEIGHT / 8];
+    uint8_t D_memory4Bit[E_INK_WIDTH * E_INK_HEIGHT / 2];
+    uint32_t calls[256];
+    uint32_t rowsUpdated = 0;   // Rows refreshed by display() and partialUpdate()
+
+    Inkplate(uint8_t _mode)
+    {
+        _displayMode = _mode;
+        memset(calls, 0, sizeof(calls));
+        clearDisplay();
+    }
+
+    void drawPixel(int16_t _x, int16_t _y, uint16_t _c)
+    {
+        calls[SLAVE_DRAW_PIXEL]++;
+        setPixel(_x, _y, _c);
+    }
+    void drawLine(int16_t, int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_LINE]++; }
+    void drawFastVLine(int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_FAST_VLINE]++; }
+    void drawFastHLine(int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_FAST_HLINE]++; }
+    void drawRect(int16_t, int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_RECT]++; }
+    void drawCircle(int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_CIRCLE]++; }
+    void drawTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_TRIANGLE]++; }
+    void drawRoundRect(int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_DRAW_ROUND_RECT]++; }
+    void fillRect(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint16_t _c)
+    {
+        calls[SLAVE_FILL_RECT]++;
+        for (int j = _y; j < _y + _h; j++)
+            for (int i = _x; i < _x + _w; i++)
+                setPixel(i, j, _c);
+    }
+    void fillCircle(int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_FILL_CIRCLE]++; }
+    void fillTriangle(int16_t, int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_FILL_TRIANGLE]++; }
+    void fillRoundRect(int16_t, int16_t, int16_t, int16_t, int16_t, uint16_t) { calls[SLAVE_FILL_ROUND_RECT]++; }
+
+    size_t write(uint8_t)
+    {
+        calls[SLAVE_PRINT]++;
+        return 1;
+    }
+    void setTextSize(uint8_t) { calls[SLAVE_SET_TEXT_SIZE]++; }
+    void setCursor(int16_t, int16_t) { calls[SLAVE_SET_CURSOR]++; }
+    void setTextWrap(bool) { calls[SLAVE_SET_TEXT_WRAP]++; }
+    void setRotation(uint8_t) { calls[SLAVE_SET_ROTATION]++; }
+    int sdCardInit() { return 0; }
+    int drawBitmapFromSD(char *, int, int) { return 0; }
+
+    void selectDisplayMode(uint8_t _mode)
+    {
+        calls[SLAVE_SET_DISPLAY_MODE]++;
+        _displayMode = _mode;
+        clearDisplay();
+    }
+    uint8_t getDisplayMode() { return _displayMode; }
+    void clearDisplay()
+    {
+        memset(_partial, 0, sizeof(_partial));
+        memset(D_memory4Bit, 255, sizeof(D_memory4Bit));
+    }
+    void display()
+    {
+        calls[SLAVE_DISPLAY]++;
+        rowsUpdated += E_INK_HEIGHT;
+    }
+    void partialUpdate()
+    {
+        partialUpdate(0, E_INK_HEIGHT - 1);
+    }
+    void partialUpdate(int16_t _y1, int16_t _y2)
+    {
+        calls[SLAVE_PARTIAL_UPDATE]++;
+        if (_y2 >= _y1) rowsUpdated += _y2 - _y1 + 1;
+    }
+    int8_t readTemperature() { return 23; }
+    double readBattery() { return 3.7; }
+    void einkOn() { _panelOn = 1; }
+    void einkOff() { _panelOn = 0; }
+    uint8_t getPanelState() { return _panelOn; }
+
+    // Same as Inkplate::uploadBegin(), uploadWrite() and uploadEnd()
+    bool uploadBegin(int16_t _x, int16_t _y, int16_t _w, int16_t _h, uint8_t _flags)
+    {
+        uint8_t _ppb = _displayMode == INKPLATE_1BIT ? 8 : 2;
+        _upLeft = 0;
+        _upH = 0;
+        if (_x < 0 || _y < 0 || _w <= 0 || _h <= 0 || _x + _w > E_INK_WIDTH || _y + _h > E_INK_HEIGHT || _x % _ppb || _w % _ppb)
+            return false;
+        _upRow = (_displayMode == INKPLATE_1BIT ? _partial : D_memory4Bit) + (uint32_t)_y * (E_INK_WIDTH / _ppb) + _x / _ppb;
+        _upStride = _w / _ppb;
+        _upCol = 0;
+        _upLeft = (uint32_t)_upStride * _h;
+        _upY = _y;
+        _upH = _h;
+        _upFlags = _flags;
+        _upState = 0;
+        _upOverflow = 0;
+        return true;
+    }
+    bool uploadWrite(const uint8_t *_d, uint32_t _n)
+    {
+        while (_n--)
+        {
+            uint8_t _b = *_d++;
+            if (!(_upFlags & UPLOAD_RLE))
+                uploadPut(_b);
+            else if (_upState == 0)
+            {
+                if (_b != 128) _upState = _b < 128 ? 1 : 2;
+                _upCount = _b < 128 ? _b + 1 : 257 - _b;
+            }
+            else if (_upState == 1)
+            {
+                uploadPut(_b);
+                if (--_upCount == 0) _upState = 0;
+            }
+            else
+            {
+                while (_upCount--) uploadPut(_b);
+                _upState = 0;
+            }
+        }
+        return !_upOverflow;
+    }
+    bool uploadEnd(bool _update)
+    {
+        bool _ok = _upLeft == 0 && !_upOverflow && _upState == 0;
+        if (_update && _upH) partialUpdate(_upY, _upY + _upH - 1);
+        _upLeft = 0;
+        _upH = 0;
+        return _ok;
+    }
+
+  private:
+    uint8_t _displayMode;
+    uint8_t _panelOn = 0;
+    uint8_t *_upRow = NULL;
+    uint16_t _upStride = 0, _upCol = 0;
+    uint32_t _upLeft = 0;
+    int16_t _upY = 0, _upH = 0;
+    uint8_t _upFlags = 0, _upState = 0, _upCount = 0, _upOverflow = 0;
+
+    void setPixel(int16_t _x, int16_t _y, uint16_t _c)
+    {
+        if (_x < 0 || _y < 0 || _x >= E_INK_WIDTH || _y >= E_INK_HEIGHT) return;
+        if (_displayMode == INKPLATE_1BIT)
+        {
+            uint8_t *_p = _partial + E_INK_WIDTH / 8 * _y + _x / 8;
+            *_p = _c ? (*_p | (1 << (_x % 8))) : (*_p & ~(1 << (_x % 8)));
+        }
+        else
+        {
+            uint8_t *_p = D_memory4Bit + E_INK_WIDTH / 2 * _y + _x / 2;
+            *_p = (_x % 2) ? ((*_p & 0xF0) | (_c & 7)) : ((*_p & 0x0F) | ((_c & 7) << 4));
+        }
+    }
+    void uploadPut(uint8_t _b)
+    {
+        if (_upLeft == 0)
+        {
+            _upOverflow = 1;
+            return;
+        }
+        _upRow[_upCol] = (_upFlags & UPLOAD_XOR) ? _upRow[_upCol] ^ _b : _b;
+        if (++_upCol == _upStride)
+        {
+            _upCol = 0;
+            _upRow += _displayMode == INKPLATE_1BIT ? E_INK_WIDTH / 8 : E_INK_WIDTH / 2;
+        }
+        _upLeft--;
+    }
+};
+
+#endif
@@ -0,0 +1,254 @@
+/***************************************************
+Loopback harness for Inkplate binary slave mode.
+
+Runs InkplateSlave with simulated Inkplate (InkplateSim.h) on one side of a Linux pseudo terminal and InkplateClient on
+the other side, so the protocol can be tested and its throughput measured without hardware. First it runs regression
+checks (every check prints PASS or FAIL, exit code is number of failed checks), then benchmarks that print commands/s
+and bytes/s. Pseudo terminal isn't limited by baud rate, so benchmarks show the cost of framing and parsing on both
+sides, not the speed of a real serial link.
+
+Build:  g++ -O2 -std=c++11 -pthread -o slave_loopback slave_loopback.cpp ../InkplateClient.cpp
+Usage:  slave_loopback [-n commands] [-f frameSize] [-w window]
+ ****************************************************/
+
+#include "InkplateSim.h"
+#include "../../../InkplateSlave.cpp"
+#include "../InkplateClient.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+unsigned long millis()
+{
+    return micros() / 1000;
+}
+
+unsigned long micros()
+{
+    struct timespec _t;
+    clock_gettime(CLOCK_MONOTONIC, &_t);
+    return _t.tv_sec * 1000000UL + _t.tv_nsec / 1000;
+}
+
+void delay(unsigned long _ms)
+{
+    usleep(_ms * 1000);
+}
+
+// Stream on master side of the pseudo terminal (Inkplate side of the link)
+class FdStream : public Stream {
+  public:
+    FdStream(int _f) : _fd(_f) {}
+    int available()
+    {
+        int _n = 0;
+        if (ioctl(_fd, FIONREAD, &_n) < 0) return 0;
+        return _n;
+    }
+    int read()
+    {
+        uint8_t _b;
+        return ::read(_fd, &_b, 1) == 1 ? _b : -1;
+    }
+    size_t readBytes(uint8_t *_b, size_t _n)
+    {
+        ssize_t _r = ::read(_fd, _b, _n);
+        return _r > 0 ? _r : 0;
+    }
+    size_t write(uint8_t _c)
+    {
+        return write(&_c, 1);
+    }
+    size_t write(const uint8_t *_b, size_t _n)
+    {
+        size_t _left = _n;
+        while (_left)
+        {
+            ssize_t _w = ::write(_fd, _b, _left);
+            if (_w <= 0) return _n - _left;
+            _b += _w;
+            _left -= _w;
+        }
+        return _n;
+    }
+
+  private:
+    int _fd;
+};
+
+static Inkplate display(INKPLATE_1BIT);
+static std::atomic<bool> stopDevice(false);
+static int failed = 0;
+
+static void deviceTask(int _fd, InkplateSlave *_slave)
+{
+    while (!stopDevice)
+    {
+        struct pollfd _p = {_fd, POLLIN, 0};
+        poll(&_p, 1, 10);
+        _slave->poll();
+    }
+}
+
+static void check(bool _ok, const char *_name)
+{
+    printf("%s %s\n", _ok ? "PASS" : "FAIL", _name);
+    if (!_ok) failed++;
+}
+
+static double seconds()
+{
+    return micros() / 1e6;
+}
+
+static void report(const char *_name, uint32_t _commands, uint64_t _bytes, double _t)
+{
+    printf("%-28s %10.0f commands/s %12.0f bytes/s  (%u commands, %llu bytes, %.3f s)\n", _name, _commands / _t,
+           _bytes / _t, _commands, (unsigned long long)_bytes, _t);
+}
+
+// Test image: diagonal stripes and text-like noise in some rows, so it compresses like real dashboards do
+static void makeImage(std::vector<uint8_t> &_img, int _w, int _h, int _seed)
+{
+    _img.assign(_w / 8 * _h, 0);
+    uint32_t _r = 12345 + _seed;
+    for (int y = 0; y < _h; y++)
+        for (int x = 0; x < _w / 8; x++)
+        {
+            _r = _r * 1103515245 + 12345;
+            if ((y / 40) % 3 == 0) _img[y * (_w / 8) + x] = _r >> 24;
+            else if (((x * 8 + y) / 32) % 2) _img[y * (_w / 8) + x] = 0xFF;
+        }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t _count = 200000;
+    uint16_t _frameSize = CLIENT_FRAME_SIZE;
+    uint32_t _window = CLIENT_WINDOW;
+    int _opt;
+    while ((_opt = getopt(argc, argv, "n:f:w:")) != -1)
+    {
+        if (_opt == 'n') _count = atoi(optarg);
+        else if (_opt == 'f') _frameSize = atoi(optarg);
+        else if (_opt == 'w') _window = atoi(optarg);
+        else
+        {
+            fprintf(stderr, "Usage: %s [-n commands] [-f frameSize] [-w window]\n", argv[0]);
+            return 255;
+        }
+    }
+
+    int _master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (_master < 0 || grantpt(_master) != 0 || unlockpt(_master) != 0)
+    {
+        perror("posix_openpt");
+        return 255;
+    }
+    InkplateClient _client;
+    if (!_client.open(ptsname(_master)))
+    {
+        perror("open pts");
+        return 255;
+    }
+    _client.setFrameSize(_frameSize);
+    _client.setWindow(_window);
+    _client.setTimeout(2000);
+
+    FdStream _stream(_master);
+    InkplateSlave *_slave = new InkplateSlave(display, _stream);
+    std::thread _device(deviceTask, _master, _slave);
+
+    // Regression checks
+    check(_client.echo(), "echo");
+    check(_client.readTemperature() == 23, "readTemperature");
+    check(_client.readBattery() > 3.69 && _client.readBattery() < 3.71, "readBattery");
+    _client.panelSupply(true);
+    check(_client.getPanelState() == 1, "panelSupply");
+    check(_client.getDisplayMode() == INKPLATE_1BIT, "getDisplayMode");
+
+    for (int i = 0; i < 100; i++)
+        _client.drawPixel(i, i / 2, 1);
+    _client.fillRect(200, 10, 64, 20, 1);
+    _client.print("Hello from the host side, this string is longer than nothing");
+    check(_client.echo(), "batched drawing");
+
+    uint8_t _bad[] = {0x7E};
+    _client.command(_bad[0], NULL, 0);
+    uint32_t _naks = _client.getNaks();
+    check(_client.echo() && _client.getNaks() == _naks + 1, "unknown opcode is rejected");
+
+    const uint8_t _garbage[] = {0x12, SLAVE_SYNC, 0x03, 0x00, SLAVE_ECHO, SLAVE_ECHO, SLAVE_ECHO, 0xDE, 0xAD};
+    _naks = _client.getNaks();
+    _client.writeRaw(_garbage, sizeof(_garbage));
+    check(_client.echo(), "resync after corrupted frame");
+    check(_client.getNaks() == _naks + 1, "corrupted frame is rejected");
+
+    std::vector<uint8_t> _img1, _img2;
+    makeImage(_img1, E_INK_WIDTH, 600, 1);
+    makeImage(_img2, E_INK_WIDTH, 600, 1);
+    for (int i = 0; i < 50; i++) _img2[300 * E_INK_WIDTH / 8 + i] ^= 0x5A;
+    check(_client.upload(0, 100, E_INK_WIDTH, 600, _img1.data(), NULL, false, false), "raw upload");
+    check(_client.upload(0, 100, E_INK_WIDTH, 600, _img1.data(), NULL, true, false), "RLE upload");
+    check(_client.upload(0, 100, E_INK_WIDTH, 600, _img2.data(), _img1.data(), true, true), "RLE XOR delta upload");
+    check(!_client.upload(3, 100, E_INK_WIDTH, 600, _img2.data()), "unaligned upload is rejected");
+
+    // Benchmarks
+    printf("\nframe size %u, window %u\n", _frameSize, _window);
+    uint64_t _b0 = _client.getBytesSent();
+    uint32_t _c0 = _client.getCommands();
+    double _t = seconds();
+    for (uint32_t i = 0; i < _count; i++)
+        _client.drawPixel(i % E_INK_WIDTH, 700 + i % 50, i & 1);
+    _client.sync();
+    report("drawPixel", _client.getCommands() - _c0, _client.getBytesSent() - _b0, seconds() - _t);
+
+    _b0 = _client.getBytesSent();
+    _c0 = _client.getCommands();
+    _t = seconds();
+    for (uint32_t i = 0; i < _count; i++)
+        _client.drawLine(0, 0, i % E_INK_WIDTH, 100, 1);
+    _client.sync();
+    report("drawLine", _client.getCommands() - _c0, _client.getBytesSent() - _b0, seconds() - _t);
+
+    const char *_names[] = {"full frame raw upload", "full frame RLE upload", "full frame RLE XOR delta"};
+    for (int k = 0; k < 3; k++)
+    {
+        int _n = 20;
+        _b0 = _client.getBytesSent();
+        _t = seconds();
+        for (int i = 0; i < _n; i++)
+            _client.upload(0, 100, E_INK_WIDTH, 600, (i & 1) ? _img2.data() : _img1.data(),
+                           k == 2 ? ((i & 1) ? _img1.data() : _img2.data()) : NULL, k > 0, true);
+        double _d = seconds() - _t;
+        uint64_t _bytes = _client.getBytesSent() - _b0;
+        printf("%-28s %10.1f frames/s   %12.0f bytes/s  (%llu bytes per frame)\n", _names[k], _n / _d, _bytes / _d,
+               (unsigned long long)(_bytes / _n));
+    }
+
+    check(_client.getErrors() == 0, "no client errors");
+
+    stopDevice = true;
+    _device.join();
+
+    // Device side state (safe to read after the device thread has stopped)
+    bool _pixels = true;
+    for (int i = 0; i < 100; i++)
+        _pixels = _pixels && (display._partial[(i / 2) * E_INK_WIDTH / 8 + i / 8] & (1 << (i % 8)));
+    check(_pixels && display._partial[20 * E_INK_WIDTH / 8 + 200 / 8] == 0xFF, "pixels and rectangles");
+    check(display.calls[SLAVE_PRINT] == strlen("Hello from the host side, this string is longer than nothing"), "print");
+    check(memcmp(display._partial + 100 * E_INK_WIDTH / 8, _img2.data(), _img2.size()) == 0, "uploaded framebuffer");
+    printf("device: %u frames, %u errors, %u rows updated\n", _slave->getFrames(), _slave->getErrors(), display.rowsUpdated);
+
+    delete _slave;
+    _client.close();
+    close(_master);
+    return failed;
+}
@@ -0,0 +1 @@
+// Included by newer Adafruit GFX versions, nothing from it is used in the host build
@@ -0,0 +1,282 @@
+/***************************************************
+Host (Linux) stand-in for Arduino ESP32 core, used to build Inkplate library with -DINKPLATE_HOST.
+
+Only the part of the core that the library uses is here. GPIO registers, I2C bus, ADC, SD card, flash partition,
+timers and FreeRTOS are implemented in HostBoard.cpp on top of the simulated board (see HostBoard.h). Time is virtual:
+delay() and delayMicroseconds() don't sleep, they only move the clock of the simulated board forward.
+ ****************************************************/
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#ifndef ARDUINO
+#define ARDUINO 10800
+#endif
+#ifndef ESP32
+#define ESP32
+#endif
+
+#include "binary.h"
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define F(s) ((const __FlashStringHelper *)(s))
+#define pgm_read_byte(addr) (*(const unsigned char *)(addr))
+#define pgm_read_word(addr) (*(const unsigned short *)(addr))
+#define pgm_read_dword(addr) (*(const unsigned long *)(addr))
+#define pgm_read_pointer(addr) (*(void *const *)(addr))
+#define pgm_read_float(addr) (*(const float *)(addr))
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define digitalPinToInterrupt(p) (p)
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+class __FlashStringHelper;
+
+// Only what Adafruit GFX and library need from Arduino String
+class String {
+  public:
+    String(const char *_s = "") : _str(_s ? _s : "") {}
+    String(const std::string &_s) : _str(_s) {}
+    const char *c_str() const { return _str.c_str(); }
+    unsigned int length() const { return _str.length(); }
+    char operator[](unsigned int _i) const { return _str[_i]; }
+    String &operator+=(const String &_s)
+    {
+        _str += _s._str;
+        return *this;
+    }
+    bool operator==(const char *_s) const { return _str == _s; }
+
+  private:
+    std::string _str;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *_b, size_t _n)
+    {
+        size_t _r = 0;
+        while (_n--) _r += write(*_b++);
+        return _r;
+    }
+    size_t write(const char *_s) { return _s ? write((const uint8_t *)_s, strlen(_s)) : 0; }
+    size_t write(const char *_b, size_t _n) { return write((const uint8_t *)_b, _n); }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper *_s) { return print((const char *)_s); }
+    size_t print(const String &_s) { return write((const uint8_t *)_s.c_str(), _s.length()); }
+    size_t print(const char *_s) { return write(_s); }
+    size_t print(char _c) { return write((uint8_t)_c); }
+    size_t print(unsigned char _v, int _base = DEC) { return print((unsigned long)_v, _base); }
+    size_t print(int _v, int _base = DEC) { return print((long)_v, _base); }
+    size_t print(unsigned int _v, int _base = DEC) { return print((unsigned long)_v, _base); }
+    size_t print(long _v, int _base = DEC)
+    {
+        if (_base == DEC && _v < 0) return print('-') + printNumber(-(unsigned long)_v, DEC);
+        return printNumber((unsigned long)_v, _base);
+    }
+    size_t print(unsigned long _v, int _base = DEC) { return printNumber(_v, _base); }
+    size_t print(double _v, int _digits = 2)
+    {
+        char _b[64];
+        snprintf(_b, sizeof(_b), "%.*f", _digits, _v);
+        return print(_b);
+    }
+    template <typename T> size_t println(T _v) { return print(_v) + println(); }
+    template <typename T> size_t println(T _v, int _f) { return print(_v, _f) + println(); }
+    size_t println() { return write("\r\n"); }
+    size_t printf(const char *_fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char _b[256];
+        va_list _a;
+        va_start(_a, _fmt);
+        int _n = vsnprintf(_b, sizeof(_b), _fmt, _a);
+        va_end(_a);
+        if (_n < 0) return 0;
+        if ((size_t)_n < sizeof(_b)) return write((const uint8_t *)_b, _n);
+        char *_big = (char *)malloc(_n + 1);
+        if (_big == NULL) return 0;
+        va_start(_a, _fmt);
+        vsnprintf(_big, _n + 1, _fmt, _a);
+        va_end(_a);
+        size_t _r = write((const uint8_t *)_big, _n);
+        free(_big);
+        return _r;
+    }
+
+  private:
+    size_t printNumber(unsigned long _v, int _base)
+    {
+        char _b[8 * sizeof(long) + 1];
+        char *_p = _b + sizeof(_b) - 1;
+        *_p = 0;
+        if (_base < 2) _base = 10;
+        do
+        {
+            int _d = _v % _base;
+            *--_p = _d < 10 ? '0' + _d : 'A' + _d - 10;
+            _v /= _base;
+        } while (_v);
+        return write(_p);
+    }
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() { return -1; }
+    void setTimeout(unsigned long _ms) { _timeout = _ms; }
+    // Waits for data by moving virtual time forward, so timeout is the same as on the board.
+    size_t readBytes(uint8_t *_b, size_t _n);
+    size_t readBytes(char *_b, size_t _n) { return readBytes((uint8_t *)_b, _n); }
+
+  protected:
+    unsigned long _timeout = 1000;
+};
+
+// Serial output goes to stdout, input is given with hostBoard.serialInput()
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long, uint32_t = 0, int8_t = -1, int8_t = -1) {}
+    void end() {}
+    int available();
+    int read();
+    int peek();
+    size_t write(uint8_t _c);
+    size_t write(const uint8_t *_b, size_t _n);
+    using Print::write;
+    void flush();
+    operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+// GPIO registers of ESP32. Every write goes to the simulated board (pins of panel interface are recorded there).
+// With -DHOST_GPIO_NULL they are plain memory like on ESP32, so panel code can be timed without the panel model (the
+// simulated panel and frame recorder don't see anything then).
+#ifdef HOST_GPIO_NULL
+struct HostGpioReg1 {
+    volatile uint32_t val;
+};
+
+struct gpio_dev_t {
+    volatile uint32_t out;
+    volatile uint32_t out_w1ts;
+    volatile uint32_t out_w1tc;
+    HostGpioReg1 out1;
+    HostGpioReg1 out1_w1ts;
+    HostGpioReg1 out1_w1tc;
+};
+#else
+struct HostGpioReg {
+    HostGpioReg &operator=(uint32_t _v);
+    operator uint32_t() const;
+    uint8_t _id;
+};
+
+struct HostGpioOut {
+    HostGpioOut &operator=(uint32_t _v);
+    HostGpioOut &operator&=(uint32_t _v);
+    HostGpioOut &operator|=(uint32_t _v);
+    operator uint32_t() const;
+    uint8_t _id;
+};
+
+struct HostGpioOut1 {
+    HostGpioOut val;
+};
+
+struct HostGpioReg1 {
+    HostGpioReg val;
+};
+
+struct gpio_dev_t {
+    HostGpioOut out;
+    HostGpioReg out_w1ts;
+    HostGpioReg out_w1tc;
+    HostGpioOut1 out1;
+    HostGpioReg1 out1_w1ts;
+    HostGpioReg1 out1_w1tc;
+};
+#endif
+extern gpio_dev_t GPIO;
+
+class EspClass {
+  public:
+    uint32_t getCycleCount();
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getFreeHeap() { return 300000; }
+    uint32_t getFreePsram() { return 4000000; }
+    void restart() { exit(0); }
+};
+extern EspClass ESP;
+
+void delay(uint32_t _ms);
+void delayMicroseconds(uint32_t _us);
+unsigned long millis();
+unsigned long micros();
+void yield();
+void pinMode(uint8_t _pin, uint8_t _mode);
+void digitalWrite(uint8_t _pin, uint8_t _val);
+int digitalRead(uint8_t _pin);
+uint16_t analogRead(uint8_t _pin);
+typedef enum
+{
+    ADC_0db,
+    ADC_2_5db,
+    ADC_6db,
+    ADC_11db
+} adc_attenuation_t;
+void analogSetPinAttenuation(uint8_t _pin, adc_attenuation_t _attenuation);
+void attachInterrupt(uint8_t _pin, void (*_isr)(void), int _mode);
+void detachInterrupt(uint8_t _pin);
+void *ps_malloc(size_t _size);
+long random(long _max);
+long random(long _min, long _max);
+void randomSeed(unsigned long _seed);
+
+using std::max;
+using std::min;
+#define constrain(v, lo, hi) ((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#endif
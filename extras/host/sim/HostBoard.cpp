@@ -0,0 +1,1520 @@
+/***************************************************
+Simulated Inkplate 6PLUS board and host implementation of Arduino core, Wire, SdFat, flash partition, esp_timer,
+ADC and FreeRTOS functions that the library uses. See HostBoard.h.
+ ****************************************************/
+
+#include "HostBoard.h"
+#include "Wire.h"
+#include "SdFat.h"
+#include "esp_adc_cal.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+// Panel interface pins (same as in Inkplate6Plus.h)
+#define HOST_CL   0x01       // GPIO0, out
+#define HOST_LE   0x04       // GPIO2, out
+#define HOST_CKV  0x01       // GPIO32, out1
+#define HOST_SPH  0x02       // GPIO33, out1
+
+// I/O expander pins
+#define HOST_OE          0
+#define HOST_SPV         2
+#define HOST_WAKEUP      3
+#define HOST_PWRUP       4
+#define HOST_PWRGOOD     6
+#define HOST_BATTERY_EN  9
+#define HOST_BACKLIGHT   11
+#define HOST_INT_PIN     34  // INTA of internal I/O expander
+#define HOST_BATTERY_PIN 35
+
+#define HOST_TPS_ADDR       0x48
+#define HOST_BACKLIGHT_ADDR 0x2E
+#define HOST_PWR_GOOD_OK    0xFA
+#define HOST_ADC_FULL_MV    3900 // ADC input voltage that gives 4095 (11 dB attenuation)
+
+HostBoard hostBoard;
+HardwareSerial Serial;
+TwoWire Wire;
+EspClass ESP;
+#ifdef HOST_GPIO_NULL
+gpio_dev_t GPIO;
+#else
+gpio_dev_t GPIO = {{0}, {1}, {2}, {{3}}, {{4}}, {{5}}};
+#endif
+
+static std::atomic<uint64_t> hostTime(0);
+
+//--------------------------Board----------------------------
+HostBoard::HostBoard()
+{
+    _panel.assign(HOST_PANEL_WIDTH * HOST_PANEL_HEIGHT, 0);
+    _partition.assign(HOST_PARTITION_SIZE, 0xFF);
+    memset(_shift, 0, sizeof(_shift));
+    memset(_tps, 0, sizeof(_tps));
+    memset(_i2cOther, 0, sizeof(_i2cOther));
+    memset(_isr, 0, sizeof(_isr));
+    memset(_isrMode, 0, sizeof(_isrMode));
+    _frame = HostFrame();
+    _tps[0x10] = 0x65; // Revision ID
+    for (int i = 0; i < 2; i++)
+    {
+        memset(_mcp[i].regs, 0, 22);
+        _mcp[i].addr = i ? 0x22 : 0x20;
+        _mcp[i].regs[0] = 0xFF; // All pins are inputs after reset
+        _mcp[i].regs[1] = 0xFF;
+        _mcp[i].ptr = 0;
+        _mcp[i].inputs = 0;
+        _mcp[i].transactions = 0;
+        _mcp[i].last = 0;
+    }
+    const char *_root = getenv("INKPLATE_SD_ROOT");
+    _sdRoot = _root != NULL ? _root : ".";
+}
+
+uint64_t HostBoard::now()
+{
+    return hostTime.load();
+}
+
+void HostBoard::advance(uint64_t _ns)
+{
+    hostTime.fetch_add(_ns);
+}
+
+// ---------------------Panel----------------------------
+void HostBoard::setRecording(bool _on)
+{
+    _recording = _on;
+}
+
+bool HostBoard::getRecording()
+{
+    return _recording;
+}
+
+void HostBoard::setPanelSteps(uint8_t _s)
+{
+    _steps = _s ? _s : 1;
+    for (size_t i = 0; i < _panel.size(); i++)
+        if (_panel[i] > _steps) _panel[i] = _steps;
+}
+
+uint8_t HostBoard::getPanelSteps()
+{
+    return _steps;
+}
+
+void HostBoard::setGpioWriteTime(uint32_t _ns)
+{
+    _gpioNs = _ns;
+}
+
+// Frame that is still open (last one) is closed first, so call this only when refresh is done.
+const std::vector<HostFrame> &HostBoard::frames()
+{
+    endFrame();
+    return _frames;
+}
+
+void HostBoard::clearFrames()
+{
+    endFrame();
+    _frames.clear();
+}
+
+uint8_t HostBoard::level(int _x, int _y)
+{
+    if (_x < 0 || _y < 0 || _x >= HOST_PANEL_WIDTH || _y >= HOST_PANEL_HEIGHT) return 0;
+    return _panel[_y * HOST_PANEL_WIDTH + _x];
+}
+
+uint8_t HostBoard::pixel(int _x, int _y)
+{
+    return 255 - level(_x, _y) * 255 / _steps;
+}
+
+void HostBoard::setPanel(uint8_t _level)
+{
+    _panel.assign(_panel.size(), _level > _steps ? _steps : _level);
+}
+
+bool HostBoard::savePgm(const char *_path)
+{
+    FILE *_f = fopen(_path, "wb");
+    if (_f == NULL) return false;
+    fprintf(_f, "P5\n%d %d\n255\n", HOST_PANEL_WIDTH, HOST_PANEL_HEIGHT);
+    std::vector<uint8_t> _line(HOST_PANEL_WIDTH);
+    for (int y = 0; y < HOST_PANEL_HEIGHT; y++)
+    {
+        for (int x = 0; x < HOST_PANEL_WIDTH; x++)
+            _line[x] = pixel(x, y);
+        fwrite(_line.data(), 1, _line.size(), _f);
+    }
+    return fclose(_f) == 0;
+}
+
+// Rows that weren't latched in the frame are left at the gray of skip code.
+bool HostBoard::saveFramePgm(size_t _n, const char *_path)
+{
+    const std::vector<HostFrame> &_all = frames();
+    if (_n >= _all.size() || _all[_n].data.empty()) return false;
+    const HostFrame &_fr = _all[_n];
+    const uint8_t _gray[4] = {128, 0, 255, 192};
+    std::vector<uint8_t> _img(HOST_PANEL_WIDTH * HOST_PANEL_HEIGHT, _gray[HOST_CODE_SKIP]);
+    for (int r = 0; r < _fr.rows && r < HOST_PANEL_HEIGHT; r++)
+    {
+        std::vector<uint8_t> _row(_fr.data.begin() + r * HOST_ROW_BYTES, _fr.data.begin() + (r + 1) * HOST_ROW_BYTES);
+        for (int x = 0; x < HOST_PANEL_WIDTH; x++)
+            _img[(HOST_PANEL_HEIGHT - 1 - r) * HOST_PANEL_WIDTH + x] = _gray[code(_row, x)];
+    }
+    FILE *_f = fopen(_path, "wb");
+    if (_f == NULL) return false;
+    fprintf(_f, "P5\n%d %d\n255\n", HOST_PANEL_WIDTH, HOST_PANEL_HEIGHT);
+    fwrite(_img.data(), 1, _img.size(), _f);
+    return fclose(_f) == 0;
+}
+
+// Row data is sent from the end of the framebuffer row: data byte k holds pixels 1020 - 4k to 1023 - 4k, lowest bits
+// first. First latched row of the frame is the last framebuffer row.
+uint8_t HostBoard::code(const std::vector<uint8_t> &_row, int _x)
+{
+    int _k = (HOST_PANEL_WIDTH - 4 - (_x & ~3)) / 4;
+    return (_row[_k] >> ((_x & 3) * 2)) & 3;
+}
+
+bool HostBoard::panelPowered()
+{
+    return powerGood() == HOST_PWR_GOOD_OK;
+}
+
+uint8_t HostBoard::dataByte()
+{
+    return ((_out >> 4) & 3) | (((_out >> 18) & 3) << 2) | (((_out >> 23) & 1) << 4) | (((_out >> 25) & 7) << 5);
+}
+
+bool HostBoard::spv()
+{
+    return (mcpPins(&_mcp[0]) >> HOST_SPV) & 1;
+}
+
+bool HostBoard::oe()
+{
+    return (mcpPins(&_mcp[0]) >> HOST_OE) & 1;
+}
+
+// _reg: 0 out, 1 out_w1ts, 2 out_w1tc, 3 out1, 4 out1_w1ts, 5 out1_w1tc. _op for out and out1: 0 =, 1 &=, 2 |=
+void HostBoard::gpioWrite(uint8_t _reg, uint32_t _v, uint8_t _op)
+{
+    uint32_t _o = _out, _o1 = _out1;
+    if (_gpioNs) advance(_gpioNs);
+    uint32_t *_r = _reg < 3 ? &_out : &_out1;
+    switch (_reg % 3)
+    {
+    case 0:
+        *_r = _op == 0 ? _v : (_op == 1 ? (*_r & _v) : (*_r | _v));
+        break;
+    case 1:
+        *_r |= _v;
+        break;
+    case 2:
+        *_r &= ~_v;
+        break;
+    }
+    sampleClocks(_o, _o1);
+}
+
+uint32_t HostBoard::gpioRead(uint8_t _reg)
+{
+    return _reg < 3 ? _out : _out1;
+}
+
+// Source driver: falling SPH starts a new row, every rising CL shifts in one data byte. Gate driver: rising CKV while
+// SPV is low starts a new frame, rising LE latches shifted data into the next row.
+void HostBoard::sampleClocks(uint32_t _o, uint32_t _o1)
+{
+    uint32_t _rise = _out & ~_o;
+    uint32_t _rise1 = _out1 & ~_o1;
+    if ((_o1 & ~_out1) & HOST_SPH)
+    {
+        _slot = 0;
+        _shiftLoaded = true;
+    }
+    if (_rise & HOST_CL)
+    {
+        if (_slot < HOST_ROW_BYTES) _shift[_slot] = dataByte();
+        _slot++;
+        if (_inFrame) _frame.cl++;
+    }
+    if (_rise1 & HOST_CKV)
+    {
+        if (!spv())
+        {
+            endFrame();
+            _frame = HostFrame();
+            _frame.start = now();
+            _frame.end = _frame.start;
+            _inFrame = true;
+            _row = 0;
+        }
+        if (_inFrame) _frame.ckv++;
+    }
+    if (_rise & HOST_LE) latchRow();
+}
+
+void HostBoard::latchRow()
+{
+    if (!_inFrame || _row >= HOST_PANEL_HEIGHT) return;
+    bool _drive = oe() && panelPowered();
+    uint8_t *_p = &_panel[(HOST_PANEL_HEIGHT - 1 - _row) * HOST_PANEL_WIDTH];
+    for (int k = 0; k < HOST_ROW_BYTES; k++)
+    {
+        uint8_t _b = _shift[k];
+        for (int i = 0; i < 4; i++, _b >>= 2)
+        {
+            uint8_t _c = _b & 3;
+            _frame.pixels[_c]++;
+            if (!_drive) continue;
+            uint8_t &_l = _p[HOST_PANEL_WIDTH - 4 - 4 * k + i];
+            if (_c == HOST_CODE_BLACK && _l < _steps) _l++;
+            else if (_c == HOST_CODE_WHITE && _l > 0) _l--;
+        }
+    }
+    if (_recording)
+    {
+        _frame.data.insert(_frame.data.end(), _shift, _shift + HOST_ROW_BYTES);
+        _frame.loaded.push_back(_shiftLoaded);
+    }
+    if (_shiftLoaded) _frame.loadedRows++;
+    _frame.driven = _frame.driven || _drive;
+    _frame.rows++;
+    _frame.end = now();
+    _shiftLoaded = false;
+    _row++;
+}
+
+// Frames without latched rows (e.g. start pulse at the end of every refresh) aren't kept.
+void HostBoard::endFrame()
+{
+    if (_inFrame && _frame.rows) _frames.push_back(std::move(_frame));
+    _inFrame = false;
+    _frame = HostFrame();
+}
+
+// ---------------------Pins and interrupts----------------------------
+int HostBoard::pinRead(uint8_t _pin)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    if (_pin == HOST_INT_PIN) return _intLine;
+    if (_pin < 32) return (_out >> _pin) & 1;
+    if (_pin < 40) return (_out1 >> (_pin - 32)) & 1;
+    return 0;
+}
+
+void HostBoard::pinWrite(uint8_t _pin, uint8_t _v)
+{
+    if (_pin < 32)
+        gpioWrite(_v ? 1 : 2, 1UL << _pin, 0);
+    else if (_pin < 40)
+        gpioWrite(_v ? 4 : 5, 1UL << (_pin - 32), 0);
+}
+
+void HostBoard::attachIsr(uint8_t _pin, void (*_isr_)(void), int _mode)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    if (_pin >= 40) return;
+    _isr[_pin] = _isr_;
+    _isrMode[_pin] = _mode;
+}
+
+// ---------------------I2C devices----------------------------
+void HostBoard::i2cTime(uint8_t _bytes, uint32_t _clock)
+{
+    // Address byte and data bytes (9 clocks each with ACK), start and stop condition
+    _i2cNs += ((uint64_t)(_bytes + 1) * 9 + 2) * 1000000000ULL;
+    advance(_i2cNs / _clock);
+    _i2cNs %= _clock;
+    _i2cBytes += _bytes + 1;
+}
+
+HostBoard::Mcp *HostBoard::mcp(uint8_t _addr)
+{
+    if (_addr == _mcp[0].addr) return &_mcp[0];
+    if (_addr == _mcp[1].addr) return &_mcp[1];
+    return NULL;
+}
+
+uint16_t HostBoard::mcpPins(Mcp *_m)
+{
+    uint16_t _dir = _m->regs[0] | (_m->regs[1] << 8);
+    uint16_t _olat = _m->regs[0x14] | (_m->regs[0x15] << 8);
+    return (_olat & ~_dir) | (_m->inputs & _dir);
+}
+
+uint8_t HostBoard::mcpRead(Mcp *_m, uint8_t _reg)
+{
+    uint8_t _port = _reg & 1;
+    if (_reg == 0x12 || _reg == 0x13)
+    {
+        _m->regs[0x0E + _port] = 0;
+        uint16_t _pins = mcpPins(_m);
+        uint8_t _v = _port ? _pins >> 8 : _pins;
+        return _v ^ (_m->regs[0x02 + _port] & _m->regs[_port]);
+    }
+    uint8_t _v = _m->regs[_reg];
+    if (_reg == 0x10 || _reg == 0x11) _m->regs[0x0E + _port] = 0;
+    return _v;
+}
+
+void HostBoard::mcpWrite(Mcp *_m, uint8_t _reg, uint8_t _v)
+{
+    if (_reg == 0x12 || _reg == 0x13)
+        _reg += 2; // Writing GPIO writes output latch
+    else if (_reg >= 0x0E && _reg <= 0x11)
+        return;    // INTF and INTCAP are read only
+    if (_reg == 0x0A || _reg == 0x0B) _m->regs[0x0A] = _m->regs[0x0B] = _v; // IOCON is shared
+    _m->regs[_reg] = _v;
+}
+
+// TPS65186 is on (and answers on I2C) while WAKEUP is high. Rails are up when PWRUP is high and all rails are enabled,
+// power good comes after setPowerGoodDelay().
+uint8_t HostBoard::powerGood()
+{
+    if (_railsOn == 0 || now() - _railsOn < (uint64_t)_pgDelay * 1000) return 0;
+    return HOST_PWR_GOOD_OK;
+}
+
+void HostBoard::updatePower()
+{
+    uint16_t _pins = mcpPins(&_mcp[0]);
+    bool _wakeup = (_pins >> HOST_WAKEUP) & 1;
+    bool _pwrup = (_pins >> HOST_PWRUP) & 1;
+    if (!_wakeup) _tps[0x01] = 0;
+    bool _on = _wakeup && _pwrup && (_tps[0x01] & 0x3F) == 0x3F;
+    if (!_on)
+        _railsOn = 0;
+    else if (_railsOn == 0)
+        _railsOn = now() ? now() : 1;
+    uint16_t _pg = powerGood() == HOST_PWR_GOOD_OK ? (1 << HOST_PWRGOOD) : 0;
+    _mcp[0].inputs = (_mcp[0].inputs & ~(1 << HOST_PWRGOOD)) | _pg;
+}
+
+// Interrupt on change (or compared to DEFVAL) of input pins, INTA of internal I/O expander is connected to GPIO34.
+void HostBoard::updateInterrupt()
+{
+    for (int i = 0; i < 2; i++)
+    {
+        Mcp *_m = &_mcp[i];
+        uint16_t _pins = mcpPins(_m);
+        uint16_t _en = (_m->regs[0x04] | (_m->regs[0x05] << 8)) & (_m->regs[0] | (_m->regs[1] << 8));
+        uint16_t _con = _m->regs[0x08] | (_m->regs[0x09] << 8);
+        uint16_t _def = _m->regs[0x06] | (_m->regs[0x07] << 8);
+        uint16_t _hit = _en & (((_pins ^ _m->last) & ~_con) | ((_pins ^ _def) & _con));
+        for (int p = 0; p < 2; p++)
+        {
+            uint8_t _h = p ? _hit >> 8 : _hit;
+            if (_h == 0) continue;
+            if (_m->regs[0x0E + p] == 0) _m->regs[0x10 + p] = p ? _pins >> 8 : _pins;
+            _m->regs[0x0E + p] |= _h;
+        }
+        _m->last = _pins;
+    }
+    uint8_t _iocon = _mcp[0].regs[0x0A];
+    bool _active = _mcp[0].regs[0x0E] || ((_iocon & 0x40) && _mcp[0].regs[0x0F]);
+    bool _line = (_iocon & 0x02) ? _active : !_active;
+    bool _old = _intLine;
+    _intLine = _line;
+    int _mode = _isrMode[HOST_INT_PIN];
+    if (_isr[HOST_INT_PIN] != NULL && _old != _line &&
+        (_mode == CHANGE || (_mode == FALLING && !_line) || (_mode == RISING && _line)))
+        _isr[HOST_INT_PIN]();
+}
+
+uint8_t HostBoard::i2cWrite(uint8_t _addr, const uint8_t *_d, uint8_t _n, uint32_t _clock)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    i2cTime(_n, _clock);
+    updatePower();
+    Mcp *_m = mcp(_addr);
+    if (_m != NULL)
+    {
+        _m->transactions++;
+        if (_n == 0) return 0;
+        _m->ptr = _d[0] % 22;
+        for (int i = 1; i < _n; i++)
+        {
+            mcpWrite(_m, _m->ptr, _d[i]);
+            _m->ptr = (_m->ptr + 1) % 22;
+        }
+    }
+    else if (_addr == HOST_TPS_ADDR && ((mcpPins(&_mcp[0]) >> HOST_WAKEUP) & 1))
+    {
+        _i2cOther[_addr]++;
+        if (_n == 0) return 0;
+        _tpsPtr = _d[0] % sizeof(_tps);
+        for (int i = 1; i < _n; i++)
+        {
+            uint8_t _v = _d[i];
+            if (_tpsPtr == 0x0D && (_v & 0x80)) // Start of temperature conversion, it's done right away
+            {
+                _tps[0x00] = (uint8_t)_temperature;
+                _v = (_v & ~0x80) | 0x20;
+            }
+            if (_tpsPtr != 0x00 && _tpsPtr != 0x0F && _tpsPtr != 0x10) _tps[_tpsPtr] = _v;
+            _tpsPtr = (_tpsPtr + 1) % sizeof(_tps);
+        }
+    }
+    else if (_addr == HOST_BACKLIGHT_ADDR)
+    {
+        _i2cOther[_addr]++;
+        if (_n >= 2) _backlight = _d[1] & 0x3F;
+    }
+    else
+    {
+        if (_addr < 128) _i2cOther[_addr]++;
+        return 2; // NACK on address
+    }
+    updatePower();
+    updateInterrupt();
+    return 0;
+}
+
+uint8_t HostBoard::i2cRead(uint8_t _addr, uint8_t *_d, uint8_t _n, uint32_t _clock)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    i2cTime(_n, _clock);
+    updatePower();
+    updateInterrupt();
+    Mcp *_m = mcp(_addr);
+    if (_m != NULL)
+    {
+        _m->transactions++;
+        for (int i = 0; i < _n; i++)
+        {
+            _d[i] = mcpRead(_m, _m->ptr);
+            _m->ptr = (_m->ptr + 1) % 22;
+        }
+    }
+    else if (_addr == HOST_TPS_ADDR && ((mcpPins(&_mcp[0]) >> HOST_WAKEUP) & 1))
+    {
+        _i2cOther[_addr]++;
+        for (int i = 0; i < _n; i++)
+        {
+            _d[i] = _tpsPtr == 0x0F ? powerGood() : _tps[_tpsPtr];
+            _tpsPtr = (_tpsPtr + 1) % sizeof(_tps);
+        }
+    }
+    else
+    {
+        if (_addr < 128) _i2cOther[_addr]++;
+        return 0;
+    }
+    updateInterrupt();
+    return _n;
+}
+
+void HostBoard::setTemperature(int8_t _t)
+{
+    _temperature = _t;
+}
+
+void HostBoard::setBattery(double _v)
+{
+    _battery = _v;
+}
+
+void HostBoard::setPowerGoodDelay(uint32_t _us)
+{
+    _pgDelay = _us;
+}
+
+uint8_t HostBoard::getBacklight()
+{
+    return 63 - _backlight;
+}
+
+// Backlight supply is enabled with low level on pin 11 of internal I/O expander.
+bool HostBoard::getBacklightOn()
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    uint16_t _dir = _mcp[0].regs[0] | (_mcp[0].regs[1] << 8);
+    return !((_dir >> HOST_BACKLIGHT) & 1) && !((mcpPins(&_mcp[0]) >> HOST_BACKLIGHT) & 1);
+}
+
+uint32_t HostBoard::i2cTransactions(uint8_t _addr)
+{
+    Mcp *_m = mcp(_addr);
+    if (_m != NULL) return _m->transactions;
+    return _addr < 128 ? _i2cOther[_addr] : 0;
+}
+
+uint32_t HostBoard::i2cTransactions()
+{
+    uint32_t _n = _mcp[0].transactions + _mcp[1].transactions;
+    for (int i = 0; i < 128; i++)
+        _n += _i2cOther[i];
+    return _n;
+}
+
+uint64_t HostBoard::i2cBytes()
+{
+    return _i2cBytes;
+}
+
+uint16_t HostBoard::expanderOutputs(uint8_t _addr)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    Mcp *_m = mcp(_addr);
+    return _m != NULL ? mcpPins(_m) : 0;
+}
+
+// Battery is measured through 1:2 divider that is connected while pin 9 of internal I/O expander is high.
+int HostBoard::adcRead(uint8_t _channel)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    if (_channel != 7 || !((mcpPins(&_mcp[0]) >> HOST_BATTERY_EN) & 1)) return 0;
+    int _raw = _battery * 1000 / 2 * 4095 / HOST_ADC_FULL_MV + 0.5;
+    return _raw > 4095 ? 4095 : _raw;
+}
+
+// ---------------------SD card, flash and Serial----------------------------
+void HostBoard::setSdRoot(const char *_dir)
+{
+    _sdRoot = _dir;
+}
+
+const char *HostBoard::getSdRoot()
+{
+    return _sdRoot.c_str();
+}
+
+void HostBoard::setSdPresent(bool _present)
+{
+    _sdPresent = _present;
+}
+
+bool HostBoard::getSdPresent()
+{
+    return _sdPresent;
+}
+
+void HostBoard::setSdContiguous(bool _on)
+{
+    _sdContiguous = _on;
+}
+
+bool HostBoard::getSdContiguous()
+{
+    return _sdContiguous;
+}
+
+void HostBoard::setSdMaxClock(uint32_t _hz)
+{
+    _sdMaxClock = _hz;
+}
+
+uint32_t HostBoard::getSdMaxClock()
+{
+    return _sdMaxClock;
+}
+
+void HostBoard::setSdClock(uint32_t _hz)
+{
+    _sdClock = _hz;
+}
+
+uint32_t HostBoard::getSdClock()
+{
+    return _sdClock;
+}
+
+uint32_t HostBoard::sdBlockReads(bool _clear)
+{
+    uint32_t _n = _sdBlockReads;
+    if (_clear) _sdBlockReads = 0;
+    return _n;
+}
+
+uint32_t HostBoard::sdBlockErrors(bool _clear)
+{
+    uint32_t _n = _sdBlockErrors;
+    if (_clear) _sdBlockErrors = 0;
+    return _n;
+}
+
+void HostBoard::setSdReadErrors(uint32_t _n)
+{
+    _sdReadErrors = _n;
+}
+
+// Counts raw block read, returns false if it has to fail (card doesn't work or error was injected)
+bool HostBoard::sdBlockRead(bool _ok)
+{
+    if (_ok && _sdReadErrors)
+    {
+        _sdReadErrors--;
+        _ok = false;
+    }
+    _sdBlockReads++;
+    if (!_ok) _sdBlockErrors++;
+    return _ok;
+}
+
+uint8_t *HostBoard::partition()
+{
+    return _partition.data();
+}
+
+void HostBoard::serialInput(const void *_d, size_t _n)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    _serialIn.insert(_serialIn.end(), (const uint8_t *)_d, (const uint8_t *)_d + _n);
+}
+
+void HostBoard::setSerialEcho(bool _on)
+{
+    _serialEcho = _on;
+}
+
+std::string HostBoard::serialOutput(bool _clear)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    std::string _s = _serialOut;
+    if (_clear) _serialOut.clear();
+    return _s;
+}
+
+int HostBoard::serialRead(bool _peek)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    if (_serialIn.empty()) return -1;
+    int _c = _serialIn.front();
+    if (!_peek) _serialIn.pop_front();
+    return _c;
+}
+
+int HostBoard::serialAvailable()
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    return _serialIn.size();
+}
+
+void HostBoard::serialWrite(const uint8_t *_d, size_t _n)
+{
+    std::lock_guard<std::recursive_mutex> _l(_lock);
+    _serialOut.append((const char *)_d, _n);
+    if (_serialEcho) fwrite(_d, 1, _n, stdout);
+}
+
+//--------------------------Arduino core----------------------------
+void delay(uint32_t _ms)
+{
+    hostBoard.advance((uint64_t)_ms * 1000000);
+    std::this_thread::yield();
+}
+
+void delayMicroseconds(uint32_t _us)
+{
+    hostBoard.advance((uint64_t)_us * 1000);
+}
+
+unsigned long micros()
+{
+    return (hostTime.fetch_add(HOST_POLL_NS) + HOST_POLL_NS) / 1000;
+}
+
+unsigned long millis()
+{
+    return (hostTime.fetch_add(HOST_POLL_NS) + HOST_POLL_NS) / 1000000;
+}
+
+void yield()
+{
+    std::this_thread::yield();
+}
+
+void pinMode(uint8_t _pin, uint8_t _mode)
+{
+}
+
+void digitalWrite(uint8_t _pin, uint8_t _val)
+{
+    hostBoard.pinWrite(_pin, _val);
+}
+
+int digitalRead(uint8_t _pin)
+{
+    return hostBoard.pinRead(_pin);
+}
+
+uint16_t analogRead(uint8_t _pin)
+{
+    return _pin == HOST_BATTERY_PIN ? hostBoard.adcRead(7) : 0;
+}
+
+void analogSetPinAttenuation(uint8_t _pin, adc_attenuation_t _attenuation)
+{
+}
+
+void attachInterrupt(uint8_t _pin, void (*_isr)(void), int _mode)
+{
+    hostBoard.attachIsr(_pin, _isr, _mode);
+}
+
+void detachInterrupt(uint8_t _pin)
+{
+    hostBoard.attachIsr(_pin, NULL, 0);
+}
+
+void *ps_malloc(size_t _size)
+{
+    return malloc(_size);
+}
+
+long random(long _max)
+{
+    return _max > 0 ? rand() % _max : 0;
+}
+
+long random(long _min, long _max)
+{
+    return _max > _min ? _min + random(_max - _min) : _min;
+}
+
+void randomSeed(unsigned long _seed)
+{
+    srand(_seed);
+}
+
+uint32_t EspClass::getCycleCount()
+{
+    return hostBoard.now() * getCpuFreqMHz() / 1000;
+}
+
+#ifndef HOST_GPIO_NULL
+HostGpioReg &HostGpioReg::operator=(uint32_t _v)
+{
+    hostBoard.gpioWrite(_id, _v, 0);
+    return *this;
+}
+
+HostGpioReg::operator uint32_t() const
+{
+    return hostBoard.gpioRead(_id);
+}
+
+HostGpioOut &HostGpioOut::operator=(uint32_t _v)
+{
+    hostBoard.gpioWrite(_id, _v, 0);
+    return *this;
+}
+
+HostGpioOut &HostGpioOut::operator&=(uint32_t _v)
+{
+    hostBoard.gpioWrite(_id, _v, 1);
+    return *this;
+}
+
+HostGpioOut &HostGpioOut::operator|=(uint32_t _v)
+{
+    hostBoard.gpioWrite(_id, _v, 2);
+    return *this;
+}
+
+HostGpioOut::operator uint32_t() const
+{
+    return hostBoard.gpioRead(_id);
+}
+#endif
+
+size_t Stream::readBytes(uint8_t *_b, size_t _n)
+{
+    size_t _done = 0;
+    unsigned long _start = millis();
+    while (_done < _n)
+    {
+        int _c = read();
+        if (_c >= 0)
+        {
+            _b[_done++] = _c;
+            _start = millis();
+            continue;
+        }
+        if (millis() - _start >= _timeout) break;
+        delay(1);
+    }
+    return _done;
+}
+
+int HardwareSerial::available()
+{
+    return hostBoard.serialAvailable();
+}
+
+int HardwareSerial::read()
+{
+    return hostBoard.serialRead(false);
+}
+
+int HardwareSerial::peek()
+{
+    return hostBoard.serialRead(true);
+}
+
+size_t HardwareSerial::write(uint8_t _c)
+{
+    hostBoard.serialWrite(&_c, 1);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *_b, size_t _n)
+{
+    hostBoard.serialWrite(_b, _n);
+    return _n;
+}
+
+void HardwareSerial::flush()
+{
+    fflush(stdout);
+}
+
+//--------------------------Wire----------------------------
+bool TwoWire::begin(int _sda, int _scl, uint32_t _freq)
+{
+    if (_freq) _clock = _freq;
+    return true;
+}
+
+void TwoWire::setClock(uint32_t _freq)
+{
+    if (_freq) _clock = _freq;
+}
+
+uint32_t TwoWire::getClock()
+{
+    return _clock;
+}
+
+void TwoWire::beginTransmission(uint8_t _a)
+{
+    _addr = _a;
+    _txLen = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool _stop)
+{
+    uint8_t _err = hostBoard.i2cWrite(_addr, _tx, _txLen, _clock);
+    _txLen = 0;
+    return _err;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t _a, uint8_t _n, bool _stop)
+{
+    if (_n > I2C_BUFFER_LENGTH) _n = I2C_BUFFER_LENGTH;
+    _rxLen = hostBoard.i2cRead(_a, _rx, _n, _clock);
+    _rxPos = 0;
+    return _rxLen;
+}
+
+size_t TwoWire::write(uint8_t _b)
+{
+    if (_txLen >= I2C_BUFFER_LENGTH) return 0;
+    _tx[_txLen++] = _b;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *_b, size_t _n)
+{
+    size_t i = 0;
+    while (i < _n && write(_b[i])) i++;
+    return i;
+}
+
+int TwoWire::available()
+{
+    return _rxLen - _rxPos;
+}
+
+int TwoWire::read()
+{
+    return _rxPos < _rxLen ? _rx[_rxPos++] : -1;
+}
+
+int TwoWire::peek()
+{
+    return _rxPos < _rxLen ? _rx[_rxPos] : -1;
+}
+
+//--------------------------ADC----------------------------
+int adc1_config_width(adc_bits_width_t width_bit)
+{
+    return 0;
+}
+
+int adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten)
+{
+    return 0;
+}
+
+int adc1_get_raw(adc1_channel_t channel)
+{
+    return hostBoard.adcRead(channel);
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t adc_num, adc_atten_t atten, adc_bits_width_t bit_width,
+                                             uint32_t default_vref, esp_adc_cal_characteristics_t *chars)
+{
+    memset(chars, 0, sizeof(*chars));
+    chars->adc_num = adc_num;
+    chars->atten = atten;
+    chars->bit_width = bit_width;
+    chars->vref = default_vref;
+    return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t adc_reading, const esp_adc_cal_characteristics_t *chars)
+{
+    return (adc_reading * HOST_ADC_FULL_MV + 2047) / 4095;
+}
+
+//--------------------------SD card----------------------------
+static std::string sdPath(const char *_path)
+{
+    while (*_path == '/') _path++;
+    return std::string(hostBoard.getSdRoot()) + "/" + _path;
+}
+
+static bool sdClockOk()
+{
+    return hostBoard.getSdMaxClock() == 0 || hostBoard.getSdClock() <= hostBoard.getSdMaxClock();
+}
+
+bool SdFat::begin(uint8_t _csPin, SPISettings _settings)
+{
+    struct stat _st;
+    hostBoard.setSdClock(_settings.clock);
+    return hostBoard.getSdPresent() && sdClockOk() && stat(hostBoard.getSdRoot(), &_st) == 0 && S_ISDIR(_st.st_mode);
+}
+
+// Block ranges given to files by contiguousRange(), block 0 is never used.
+struct SdBlockRange
+{
+    std::string path;
+    uint32_t bgn, end;
+};
+static std::vector<SdBlockRange> sdRanges;
+
+bool SdFile::contiguousRange(uint32_t *_bgnBlock, uint32_t *_endBlock)
+{
+    if (_f == NULL || !hostBoard.getSdContiguous() || fileSize() == 0) return false;
+    uint32_t _blocks = (fileSize() + 511) / 512;
+    for (size_t i = 0; i < sdRanges.size(); i++)
+    {
+        if (sdRanges[i].path == _path && sdRanges[i].end - sdRanges[i].bgn + 1 >= _blocks)
+        {
+            *_bgnBlock = sdRanges[i].bgn;
+            *_endBlock = sdRanges[i].bgn + _blocks - 1;
+            return true;
+        }
+    }
+    SdBlockRange _r;
+    _r.path = _path;
+    _r.bgn = sdRanges.empty() ? 1 : sdRanges.back().end + 1;
+    _r.end = _r.bgn + _blocks - 1;
+    sdRanges.push_back(_r);
+    *_bgnBlock = _r.bgn;
+    *_endBlock = _r.end;
+    return true;
+}
+
+// Reads blocks of the file that holds them, past the end of file blocks are zeros.
+bool Sd2Card::readBlocks(uint32_t _block, uint8_t *_dst, size_t _n)
+{
+    _error = 0;
+    const SdBlockRange *_r = NULL;
+    for (size_t i = 0; i < sdRanges.size() && _r == NULL; i++)
+        if (_block >= sdRanges[i].bgn && _block + _n - 1 <= sdRanges[i].end) _r = &sdRanges[i];
+    FILE *_f = NULL;
+    if (hostBoard.sdBlockRead(hostBoard.getSdPresent() && sdClockOk() && _r != NULL))
+        _f = fopen(_r->path.c_str(), "rb");
+    if (_f == NULL)
+    {
+        _error = SD_CARD_ERROR_READ_CRC;
+        return false;
+    }
+    memset(_dst, 0, _n * 512);
+    fseek(_f, (_block - _r->bgn) * 512, SEEK_SET);
+    fread(_dst, 1, _n * 512, _f);
+    fclose(_f);
+    return true;
+}
+
+bool SdFat::exists(const char *_path)
+{
+    struct stat _st;
+    return hostBoard.getSdPresent() && stat(sdPath(_path).c_str(), &_st) == 0;
+}
+
+bool SdFat::remove(const char *_path)
+{
+    return hostBoard.getSdPresent() && ::remove(sdPath(_path).c_str()) == 0;
+}
+
+bool SdFat::mkdir(const char *_path, bool _parents)
+{
+    return hostBoard.getSdPresent() && ::mkdir(sdPath(_path).c_str(), 0777) == 0;
+}
+
+bool SdFile::open(const char *_p, uint8_t _flags)
+{
+    close();
+    if (!hostBoard.getSdPresent()) return false;
+    std::string _full = sdPath(_p);
+    struct stat _st;
+    bool _exists = stat(_full.c_str(), &_st) == 0;
+    if (_exists && S_ISDIR(_st.st_mode)) return false;
+    if ((_flags & O_ACCMODE) == O_RDONLY)
+        _f = fopen(_full.c_str(), "rb");
+    else if (_exists && (_flags & O_CREAT) && (_flags & O_EXCL))
+        return false;
+    else if (!_exists && !(_flags & O_CREAT))
+        return false;
+    else
+        _f = fopen(_full.c_str(), (!_exists || (_flags & O_TRUNC)) ? "w+b" : "r+b");
+    if (_f == NULL) return false;
+    if (_flags & (O_APPEND | O_AT_END)) fseek(_f, 0, SEEK_END);
+    _path = strdup(_full.c_str());
+    return true;
+}
+
+bool SdFile::close()
+{
+    if (_f == NULL) return false;
+    fclose(_f);
+    _f = NULL;
+    free(_path);
+    _path = NULL;
+    return true;
+}
+
+int SdFile::read()
+{
+    if (_f == NULL) return -1;
+    int _c = fgetc(_f);
+    return _c == EOF ? -1 : _c;
+}
+
+int SdFile::read(void *_buf, size_t _n)
+{
+    if (_f == NULL) return -1;
+    return fread(_buf, 1, _n, _f);
+}
+
+int SdFile::peek()
+{
+    int _c = read();
+    if (_c >= 0) ungetc(_c, _f);
+    return _c;
+}
+
+int SdFile::available()
+{
+    return isOpen() ? fileSize() - curPosition() : 0;
+}
+
+size_t SdFile::write(uint8_t _b)
+{
+    return write(&_b, 1);
+}
+
+size_t SdFile::write(const uint8_t *_b, size_t _n)
+{
+    if (_f == NULL) return 0;
+    return fwrite(_b, 1, _n, _f);
+}
+
+bool SdFile::seekSet(uint32_t _pos)
+{
+    if (_f == NULL || _pos > fileSize()) return false;
+    return fseek(_f, _pos, SEEK_SET) == 0;
+}
+
+uint32_t SdFile::curPosition()
+{
+    return _f != NULL ? ftell(_f) : 0;
+}
+
+uint32_t SdFile::fileSize()
+{
+    if (_f == NULL) return 0;
+    fflush(_f);
+    struct stat _st;
+    return fstat(fileno(_f), &_st) == 0 ? _st.st_size : 0;
+}
+
+bool SdFile::sync()
+{
+    return _f != NULL && fflush(_f) == 0;
+}
+
+bool SdFile::remove()
+{
+    if (_path == NULL) return false;
+    std::string _p = _path;
+    close();
+    return ::remove(_p.c_str()) == 0;
+}
+
+//--------------------------Flash partition----------------------------
+// Writes behave like NOR flash: bits can only be cleared, erase (4 kB sectors) sets them back to 1.
+static esp_partition_t hostImages = {ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, 0x110000,
+                                     HOST_PARTITION_SIZE, "images", false};
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    if (type != hostImages.type) return NULL;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != hostImages.subtype) return NULL;
+    if (label != NULL && strcmp(label, hostImages.label) != 0) return NULL;
+    return &hostImages;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (partition != &hostImages || src_offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+    memcpy(dst, hostBoard.partition() + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    if (partition != &hostImages || dst_offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+    uint8_t *_d = hostBoard.partition() + dst_offset;
+    for (size_t i = 0; i < size; i++)
+        _d[i] &= ((const uint8_t *)src)[i];
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    if (partition != &hostImages || offset + size > partition->size || offset % 4096 || size % 4096)
+        return ESP_ERR_INVALID_ARG;
+    memset(hostBoard.partition() + offset, 0xFF, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             spi_flash_mmap_memory_t memory, const void **out_ptr, spi_flash_mmap_handle_t *out_handle)
+{
+    if (partition != &hostImages || offset + size > partition->size) return ESP_ERR_INVALID_ARG;
+    *out_ptr = hostBoard.partition() + offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle)
+{
+}
+
+//--------------------------FreeRTOS----------------------------
+// Every waiting with timeout is real waiting (other thread has to do something in the meantime) and virtual clock is
+// moved forward for the time that was spent waiting.
+struct HostTask
+{
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notify = 0;
+    int core = 1;
+};
+
+struct HostSemaphore
+{
+    std::mutex m;
+    std::condition_variable cv;
+    uint8_t type;            // 0 binary, 1 mutex, 2 recursive mutex
+    uint32_t count;
+    HostTask *holder;
+    uint32_t depth;
+};
+
+// Thrown by vTaskDelete(NULL), caught at the top of the task thread
+struct HostTaskExit
+{
+};
+
+static HostTask hostMainTask;
+static thread_local HostTask *hostCurrent = &hostMainTask;
+static std::recursive_mutex hostCritical;
+
+template <typename L, typename P> static bool hostWait(std::condition_variable &_cv, L &_l, TickType_t _ticks, P _pred)
+{
+    if (_pred()) return true;
+    std::chrono::steady_clock::time_point _t = std::chrono::steady_clock::now();
+    bool _ok;
+    if (_ticks == portMAX_DELAY)
+    {
+        _cv.wait(_l, _pred);
+        _ok = true;
+    }
+    else
+    {
+        _ok = _cv.wait_for(_l, std::chrono::milliseconds(_ticks), _pred);
+    }
+    hostBoard.advance(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _t).count());
+    return _ok;
+}
+
+void hostEnterCritical(portMUX_TYPE *_mux)
+{
+    hostCritical.lock();
+}
+
+void hostExitCritical(portMUX_TYPE *_mux)
+{
+    hostCritical.unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+                                   void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask,
+                                   BaseType_t xCoreID)
+{
+    HostTask *_t = new HostTask();
+    _t->core = xCoreID == tskNO_AFFINITY ? 0 : xCoreID;
+    if (pvCreatedTask != NULL) *pvCreatedTask = _t;
+    std::thread([=]() {
+        hostCurrent = _t;
+        try
+        {
+            pvTaskCode(pvParameters);
+        }
+        catch (HostTaskExit &)
+        {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth, void *pvParameters,
+                       UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask)
+{
+    return xTaskCreatePinnedToCore(pvTaskCode, pcName, usStackDepth, pvParameters, uxPriority, pvCreatedTask,
+                                   tskNO_AFFINITY);
+}
+
+// Task can only end itself. Other task that is deleted stays blocked where it is (its thread is never woken up again).
+void vTaskDelete(TaskHandle_t xTask)
+{
+    if (xTask == NULL || xTask == hostCurrent) throw HostTaskExit();
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(xTicksToDelay));
+    hostBoard.advance((uint64_t)xTicksToDelay * 1000000);
+}
+
+void vTaskDelayUntil(TickType_t *pxPreviousWakeTime, TickType_t xTimeIncrement)
+{
+    *pxPreviousWakeTime += xTimeIncrement;
+    TickType_t _now = xTaskGetTickCount();
+    if ((int32_t)(*pxPreviousWakeTime - _now) > 0) vTaskDelay(*pxPreviousWakeTime - _now);
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return hostBoard.now() / 1000000;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return hostCurrent;
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return hostCurrent->core;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify)
+{
+    std::lock_guard<std::mutex> _l(xTaskToNotify->m);
+    xTaskToNotify->notify++;
+    xTaskToNotify->cv.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    xTaskNotifyGive(xTaskToNotify);
+    if (pxHigherPriorityTaskWoken != NULL) *pxHigherPriorityTaskWoken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait)
+{
+    HostTask *_t = hostCurrent;
+    std::unique_lock<std::mutex> _l(_t->m);
+    if (!hostWait(_t->cv, _l, xTicksToWait, [_t] { return _t->notify > 0; })) return 0;
+    uint32_t _n = _t->notify;
+    _t->notify = xClearCountOnExit ? 0 : _n - 1;
+    return _n;
+}
+
+static SemaphoreHandle_t hostSemaphore(uint8_t _type)
+{
+    HostSemaphore *_s = new HostSemaphore();
+    _s->type = _type;
+    _s->count = _type ? 1 : 0;
+    _s->holder = NULL;
+    _s->depth = 0;
+    return _s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return hostSemaphore(0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return hostSemaphore(1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return hostSemaphore(2);
+}
+
+// Semaphore of a deleted task may still be waited on by its (blocked) thread, so it's never freed.
+void vSemaphoreDelete(SemaphoreHandle_t xSemaphore)
+{
+}
+
+static BaseType_t hostTake(SemaphoreHandle_t _s, TickType_t _ticks, bool _recursive)
+{
+    std::unique_lock<std::mutex> _l(_s->m);
+    if (_recursive && _s->holder == hostCurrent)
+    {
+        _s->depth++;
+        return pdTRUE;
+    }
+    if (!hostWait(_s->cv, _l, _ticks, [_s] { return _s->count > 0; })) return pdFALSE;
+    _s->count--;
+    if (_s->type)
+    {
+        _s->holder = hostCurrent;
+        _s->depth = 1;
+    }
+    return pdTRUE;
+}
+
+static BaseType_t hostGive(SemaphoreHandle_t _s, bool _recursive)
+{
+    std::lock_guard<std::mutex> _l(_s->m);
+    if (_s->type)
+    {
+        if (_s->holder != hostCurrent) return pdFALSE;
+        if (_recursive && --_s->depth > 0) return pdTRUE;
+        _s->holder = NULL;
+    }
+    else if (_s->count)
+    {
+        return pdFALSE;
+    }
+    _s->count = 1;
+    _s->cv.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+    return hostTake(xSemaphore, xBlockTime, false);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+    return hostGive(xSemaphore, false);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t xSemaphore, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    BaseType_t _r = hostGive(xSemaphore, false);
+    if (pxHigherPriorityTaskWoken != NULL) *pxHigherPriorityTaskWoken = _r;
+    return _r;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t xMutex, TickType_t xBlockTime)
+{
+    return hostTake(xMutex, xBlockTime, true);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t xMutex)
+{
+    return hostGive(xMutex, true);
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t xSemaphore)
+{
+    std::lock_guard<std::mutex> _l(xSemaphore->m);
+    return xSemaphore->holder;
+}
+
+//--------------------------esp_timer----------------------------
+// Callback runs on its own thread after real time has passed (keep-alive times are long compared to host refresh).
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t generation;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL) return ESP_ERR_INVALID_ARG;
+    esp_timer *_t = new esp_timer();
+    _t->callback = create_args->callback;
+    _t->arg = create_args->arg;
+    _t->generation = 0;
+    *out_handle = _t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    std::lock_guard<std::mutex> _l(timer->m);
+    uint32_t _gen = ++timer->generation;
+    std::thread([timer, _gen, timeout_us]() {
+        std::unique_lock<std::mutex> _w(timer->m);
+        if (timer->cv.wait_for(_w, std::chrono::microseconds(timeout_us), [&] { return timer->generation != _gen; }))
+            return;
+        _w.unlock();
+        timer->callback(timer->arg);
+    }).detach();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> _l(timer->m);
+    timer->generation++;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+// Timer thread may still hold the handle, so it's only stopped.
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    return esp_timer_stop(timer);
+}
+
+int64_t esp_timer_get_time()
+{
+    return hostBoard.now() / 1000;
+}
@@ -0,0 +1,194 @@
+/***************************************************
+Simulated Inkplate 6PLUS board for host (Linux) builds of the library.
+
+It has models of everything the library talks to: both MCP23017 I/O expanders (registers, interrupt output on GPIO34),
+TPS65186 (power good, temperature, rails), backlight DAC, battery ADC, SD card (directory on the host, raw block reads
+of files), flash partition (RAM) and the panel interface. Panel interface is recorded per frame: every frame (started with CKV pulse while SPV is
+low) keeps the source data that was latched into each row, how many CL and CKV pulses it took and when it started.
+Latched rows also drive the simulated panel, so its state after a refresh can be saved as PGM image.
+
+Panel model is simple: every pixel has a darkness level from 0 (white) to getPanelSteps() (black). Each frame that
+drives a pixel black adds one level and each frame that drives it white removes one. Rows are driven only while panel
+power is good and OE is high. It's enough to see which pixels a waveform turns black or white and to compare refresh
+sequences, not to predict real gray levels.
+
+All time is virtual: delay(), delayMicroseconds(), I2C transactions and GPIO writes (setGpioWriteTime()) move the clock
+forward, computation doesn't. Every read of micros() or millis() moves it by HOST_POLL_NS, so busy waiting loops end.
+ ****************************************************/
+
+#ifndef __HOSTBOARD_H__
+#define __HOSTBOARD_H__
+
+#include "Arduino.h"
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define HOST_PANEL_WIDTH  1024
+#define HOST_PANEL_HEIGHT 758
+#define HOST_ROW_BYTES    (HOST_PANEL_WIDTH / 4) // Source data bytes (4 pixels each) in one row
+#define HOST_POLL_NS      100                    // Virtual time spent by every read of micros() or millis()
+#define HOST_PANEL_STEPS  3                      // Default number of frames that turn pixel from white to black
+#define HOST_PARTITION_SIZE (3 * 1024 * 1024)    // Size of "images" flash partition
+
+// Source data codes of one pixel (2 bits in source data byte)
+#define HOST_CODE_DISCHARGE 0
+#define HOST_CODE_BLACK     1
+#define HOST_CODE_WHITE     2
+#define HOST_CODE_SKIP      3
+
+struct HostFrame
+{
+    uint64_t start;                // Virtual time (ns) of the frame start
+    uint64_t end;                  // Virtual time (ns) of the last latched row
+    uint32_t ckv;                  // CKV (gate clock) pulses in the frame
+    uint32_t cl;                   // CL (source clock) pulses in the frame
+    uint16_t rows;                 // Latched rows (LE pulses)
+    uint16_t loadedRows;           // Rows that got new source data (others repeat data of the previous row)
+    bool driven;                   // Panel was powered and OE was high, so rows changed the panel
+    uint32_t pixels[4];            // Latched pixels per code (HOST_CODE_...)
+    std::vector<uint8_t> data;     // Source data, HOST_ROW_BYTES per latched row (empty if recording is off)
+    std::vector<uint8_t> loaded;   // For every latched row 1 if new data was shifted in before it
+};
+
+class HostBoard {
+  public:
+    HostBoard();
+
+    // Virtual time in nanoseconds
+    uint64_t now();
+    void advance(uint64_t _ns);
+
+    // Panel
+    void setRecording(bool _on);
+    bool getRecording();
+    void setPanelSteps(uint8_t _steps);
+    uint8_t getPanelSteps();
+    void setGpioWriteTime(uint32_t _ns);     // Virtual time of one GPIO register write (0 by default)
+    const std::vector<HostFrame> &frames();
+    void clearFrames();
+    uint8_t pixel(int _x, int _y);          // Gray level of panel pixel (0 black, 255 white), framebuffer coordinates
+    uint8_t level(int _x, int _y);          // Darkness level of panel pixel
+    void setPanel(uint8_t _level);          // Sets all pixels to one darkness level
+    bool savePgm(const char *_path);        // Panel state as 8 bit PGM
+    bool saveFramePgm(size_t _frame, const char *_path); // Source data codes of one frame (black, white, gray, light)
+    static uint8_t code(const std::vector<uint8_t> &_row, int _x); // Code of pixel _x in recorded row data
+    bool panelPowered();
+
+    // I2C devices
+    void setTemperature(int8_t _t);
+    void setBattery(double _v);
+    void setPowerGoodDelay(uint32_t _us);   // Time from enabling rails to power good (0 = immediately)
+    uint8_t getBacklight();                 // Backlight DAC value (0 - 63)
+    bool getBacklightOn();
+    uint32_t i2cTransactions(uint8_t _addr);
+    uint32_t i2cTransactions();
+    uint64_t i2cBytes();
+    uint16_t expanderOutputs(uint8_t _addr); // Pin levels of I/O expander outputs
+
+    // SD card, flash and Serial
+    void setSdRoot(const char *_dir);
+    const char *getSdRoot();
+    void setSdPresent(bool _present);
+    bool getSdPresent();
+    void setSdContiguous(bool _on);         // Files are in contiguous blocks, so they can be read raw (on by default)
+    bool getSdContiguous();
+    void setSdMaxClock(uint32_t _hz);       // Highest SPI clock the card works with (0 = any)
+    void setSdReadErrors(uint32_t _n);      // Next _n raw block reads fail with CRC error
+    uint32_t getSdMaxClock();
+    void setSdClock(uint32_t _hz);          // SPI clock of the last SdFat::begin()
+    uint32_t getSdClock();
+    uint32_t sdBlockReads(bool _clear = true); // Successful and failed readBlocks() calls
+    uint32_t sdBlockErrors(bool _clear = true);
+    uint8_t *partition();
+    void serialInput(const void *_d, size_t _n);
+    void setSerialEcho(bool _on);           // Serial output to stdout (on by default)
+    std::string serialOutput(bool _clear = true);
+
+    // Used by the host core (Arduino.h, Wire.h, ...)
+    void gpioWrite(uint8_t _reg, uint32_t _v, uint8_t _op);
+    uint32_t gpioRead(uint8_t _reg);
+    int pinRead(uint8_t _pin);
+    void pinWrite(uint8_t _pin, uint8_t _v);
+    void attachIsr(uint8_t _pin, void (*_isr)(void), int _mode);
+    uint8_t i2cWrite(uint8_t _addr, const uint8_t *_d, uint8_t _n, uint32_t _clock);
+    uint8_t i2cRead(uint8_t _addr, uint8_t *_d, uint8_t _n, uint32_t _clock);
+    int adcRead(uint8_t _channel);
+    int serialRead(bool _peek);
+    int serialAvailable();
+    void serialWrite(const uint8_t *_d, size_t _n);
+    bool sdBlockRead(bool _ok);
+
+  private:
+    struct Mcp
+    {
+        uint8_t addr;
+        uint8_t regs[22];
+        uint8_t ptr;
+        uint16_t inputs;
+        uint16_t last;         // Pin levels at the last interrupt check
+        uint32_t transactions;
+    };
+
+    std::recursive_mutex _lock;
+    uint32_t _out = 0, _out1 = 0;
+    uint16_t _slot = 0;
+    uint8_t _shift[HOST_ROW_BYTES];
+    bool _shiftLoaded = false;
+    bool _inFrame = false;
+    uint16_t _row = 0;
+    HostFrame _frame;
+    std::vector<HostFrame> _frames;
+    bool _recording = true;
+    uint8_t _steps = HOST_PANEL_STEPS;
+    uint32_t _gpioNs = 0;
+    std::vector<uint8_t> _panel;
+
+    Mcp _mcp[2];
+    uint8_t _tps[17];
+    uint8_t _tpsPtr = 0;
+    int8_t _temperature = 25;
+    uint32_t _pgDelay = 0;
+    uint64_t _railsOn = 0;
+    uint8_t _backlight = 0;
+    uint32_t _i2cOther[128];
+    uint64_t _i2cBytes = 0;
+    uint64_t _i2cNs = 0;
+    double _battery = 3.9;
+    bool _intLine = true;
+    void (*_isr[40])(void);
+    int _isrMode[40];
+
+    std::string _sdRoot;
+    bool _sdPresent = true;
+    bool _sdContiguous = true;
+    uint32_t _sdMaxClock = 0;
+    uint32_t _sdReadErrors = 0;
+    uint32_t _sdClock = 0;
+    uint32_t _sdBlockReads = 0;
+    uint32_t _sdBlockErrors = 0;
+    std::vector<uint8_t> _partition;
+    std::deque<uint8_t> _serialIn;
+    std::string _serialOut;
+    bool _serialEcho = true;
+
+    void sampleClocks(uint32_t _oldOut, uint32_t _oldOut1);
+    void latchRow();
+    void endFrame();
+    uint8_t dataByte();
+    bool spv();
+    bool oe();
+    Mcp *mcp(uint8_t _addr);
+    uint8_t mcpRead(Mcp *_m, uint8_t _reg);
+    void mcpWrite(Mcp *_m, uint8_t _reg, uint8_t _v);
+    uint16_t mcpPins(Mcp *_m);
+    void updatePower();
+    uint8_t powerGood();
+    void updateInterrupt();
+    void i2cTime(uint8_t _bytes, uint32_t _clock);
+};
+
+extern HostBoard hostBoard;
+
+#endif
@@ -0,0 +1,2 @@
+// Print and Stream are in Arduino.h of the host build
+#include "Arduino.h"
@@ -0,0 +1,26 @@
+// Host stand-in for SPI, SD card (see SdFat.h) doesn't use it in the host build
+#ifndef __HOST_SPI_H__
+#define __HOST_SPI_H__
+
+#include "Arduino.h"
+
+#define HSPI 2
+#define VSPI 3
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0
+
+class SPISettings {
+  public:
+    SPISettings(uint32_t _clock = 1000000, uint8_t _order = MSBFIRST, uint8_t _mode = SPI_MODE0) : clock(_clock) {}
+    uint32_t clock;
+};
+
+class SPIClass {
+  public:
+    SPIClass(uint8_t _bus = HSPI) {}
+    void begin(int8_t _sck = -1, int8_t _miso = -1, int8_t _mosi = -1, int8_t _ss = -1) {}
+    void end() {}
+};
+
+#endif
@@ -0,0 +1,88 @@
+/***************************************************
+Host stand-in for SdFat (v1 API). Files are ordinary files in a directory on the host that acts as the SD card (see
+hostBoard.setSdRoot()). Every file is stored in contiguous blocks (unless hostBoard.setSdContiguous(false)): the first
+contiguousRange() call gives it a block range of its own, and readBlocks() reads file content through it. Card fails
+begin() and block reads if SPI clock is above hostBoard.setSdMaxClock(), block reads then report CRC error (errors can
+also be injected with hostBoard.setSdReadErrors()).
+ ****************************************************/
+
+#ifndef __HOST_SDFAT_H__
+#define __HOST_SDFAT_H__
+
+#include <stdio.h>
+#include "SPI.h"
+
+#define O_RDONLY 0x00
+#define O_READ   O_RDONLY
+#define O_WRONLY 0x01
+#define O_RDWR   0x02
+#define O_WRITE  O_RDWR
+#define O_ACCMODE 0x03
+#define O_APPEND 0x08
+#define O_CREAT  0x10
+#define O_TRUNC  0x20
+#define O_EXCL   0x40
+#define O_AT_END 0x80
+
+#define SD_SCK_MHZ(maxMhz) SPISettings(1000000UL * (maxMhz), MSBFIRST, SPI_MODE0)
+#define SD_SCK_HZ(maxHz)   SPISettings(maxHz, MSBFIRST, SPI_MODE0)
+
+#define SD_CARD_ERROR_READ_CRC 0x1B
+
+class Sd2Card {
+  public:
+    bool readBlocks(uint32_t _block, uint8_t *_dst, size_t _n);
+    uint8_t errorCode() { return _error; }
+
+  private:
+    uint8_t _error = 0;
+};
+
+class SdFile : public Print {
+  public:
+    SdFile() {}
+    SdFile(const char *_path, uint8_t _flags) { open(_path, _flags); }
+    ~SdFile() { close(); }
+    bool open(const char *_path, uint8_t _flags = O_RDONLY);
+    bool close();
+    bool isOpen() const { return _f != NULL; }
+    int read();
+    int read(void *_buf, size_t _n);
+    int peek();
+    int available();
+    size_t write(uint8_t _b);
+    size_t write(const uint8_t *_b, size_t _n);
+    using Print::write;
+    bool seekSet(uint32_t _pos);
+    bool seekCur(int32_t _off) { return seekSet(curPosition() + _off); }
+    bool seekEnd(int32_t _off = 0) { return seekSet(fileSize() + _off); }
+    void rewind() { seekSet(0); }
+    uint32_t curPosition();
+    uint32_t fileSize();
+    bool contiguousRange(uint32_t *_bgnBlock, uint32_t *_endBlock);
+    bool sync();
+    bool remove();
+    operator bool() const { return isOpen(); }
+
+  private:
+    SdFile(const SdFile &);
+    SdFile &operator=(const SdFile &);
+    FILE *_f = NULL;
+    char *_path = NULL;
+};
+
+class SdFat {
+  public:
+    SdFat(SPIClass *_spi = NULL) {}
+    bool begin(uint8_t _csPin = 0, SPISettings _settings = SPISettings());
+    bool cardBegin(uint8_t _csPin = 0, SPISettings _settings = SPISettings()) { return begin(_csPin, _settings); }
+    Sd2Card *card() { return &_card; }
+    bool exists(const char *_path);
+    bool remove(const char *_path);
+    bool mkdir(const char *_path, bool _parents = true);
+
+  private:
+    Sd2Card _card;
+};
+
+#endif
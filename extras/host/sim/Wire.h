@@ -0,0 +1,42 @@
+/***************************************************
+Host stand-in for Wire (I2C master). Transactions go to devices of the simulated board (see HostBoard.h) and take as
+much virtual time as they would take on the bus with the selected clock.
+ ****************************************************/
+
+#ifndef __HOST_WIRE_H__
+#define __HOST_WIRE_H__
+
+#include "Arduino.h"
+
+#define I2C_BUFFER_LENGTH 128
+
+class TwoWire : public Stream {
+  public:
+    bool begin(int _sda = -1, int _scl = -1, uint32_t _freq = 0);
+    void setClock(uint32_t _freq);
+    uint32_t getClock();
+    void beginTransmission(uint8_t _addr);
+    void beginTransmission(int _addr) { beginTransmission((uint8_t)_addr); }
+    uint8_t endTransmission(bool _stop = true);
+    uint8_t requestFrom(uint8_t _addr, uint8_t _n, bool _stop = true);
+    uint8_t requestFrom(int _addr, int _n) { return requestFrom((uint8_t)_addr, (uint8_t)_n); }
+    size_t write(uint8_t _b);
+    size_t write(const uint8_t *_b, size_t _n);
+    using Print::write;
+    int available();
+    int read();
+    int peek();
+
+  private:
+    uint32_t _clock = 100000;
+    uint8_t _addr = 0;
+    uint8_t _tx[I2C_BUFFER_LENGTH];
+    uint8_t _txLen = 0;
+    uint8_t _rx[I2C_BUFFER_LENGTH];
+    uint8_t _rxLen = 0;
+    uint8_t _rxPos = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,26 @@
+// Host stand-in for ESP32 heap capabilities, everything is allocated with malloc()
+#ifndef __HOST_ESP_HEAP_CAPS_H__
+#define __HOST_ESP_HEAP_CAPS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_EXEC     (1 << 0)
+#define MALLOC_CAP_32BIT    (1 << 1)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void *heap_caps_malloc(size_t _size, uint32_t _caps)
+{
+    return malloc(_size);
+}
+
+inline void heap_caps_free(void *_p)
+{
+    free(_p);
+}
+
+#endif
@@ -0,0 +1,47 @@
+/***************************************************
+Host stand-in for FreeRTOS of ESP32. Tasks are threads, semaphores and notifications are built on mutexes and condition
+variables (see HostBoard.cpp). Ticks are milliseconds. Waiting with timeout (semaphores, notifications, vTaskDelay) is
+real waiting, because other task has to run in the meantime.
+ ****************************************************/
+
+#ifndef __HOST_FREERTOS_H__
+#define __HOST_FREERTOS_H__
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct HostTask *TaskHandle_t;
+typedef struct HostSemaphore *SemaphoreHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE             ((BaseType_t)0)
+#define pdTRUE              ((BaseType_t)1)
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS  ((TickType_t)1)
+#define configTICK_RATE_HZ  1000
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+#define tskNO_AFFINITY      0x7FFFFFFF
+#define portYIELD_FROM_ISR()
+#define portYIELD()
+
+typedef struct
+{
+    uint32_t owner;
+    uint32_t count;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0, 0}
+
+void hostEnterCritical(portMUX_TYPE *_mux);
+void hostExitCritical(portMUX_TYPE *_mux);
+
+#define portENTER_CRITICAL(mux)     hostEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)      hostExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)  hostExitCritical(mux)
+
+#endif
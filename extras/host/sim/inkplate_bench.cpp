@@ -0,0 +1,290 @@
+/***************************************************
+Microbenchmarks of Inkplate library hot paths, run on the simulated board (HostBoard.h) on Linux.
+
+Workloads are fixed (same pattern, same coordinates every run), so results of two builds or releases can be compared.
+Every workload is run once to warm up and to pick the number of calls that takes at least -t milliseconds, then it is
+timed -r times with host clock. Median time of one call is reported together with ns per pixel and bytes per second.
+"pixels" are pixels drawn or scanned by one call, "bytes" are bytes of input data one call goes through (framebuffer
+bytes for drawing, diff and scanout, file bytes for BMP decoders, source bytes for drawBitmap3Bit).
+
+Library has to be built with -DHOST_GPIO_NULL, so GPIO registers are plain memory and refresh times are the time of
+computation and register writes, not of the panel model. Delays are virtual (they don't take any time). Refresh
+entries include scanout of frames that only clean the panel (cleanFast()), "rowPrep" entries are derived from them:
+refresh time minus the same number of cleanFast() frames, per data frame and pixel. These numbers are host numbers, they
+show relative changes, not the speed on ESP32.
+
+Results are written as JSON to stdout (or to the file given with -o), progress goes to stderr.
+
+Adafruit GFX library isn't a part of this repository, GFX_DIR has to point to it (version 1.7 or newer).
+
+Build (in this directory):
+  g++ -O2 -std=gnu++11 -pthread -DINKPLATE_HOST -DHOST_GPIO_NULL -I. -I../../.. -I$GFX_DIR -o inkplate_bench \
+      inkplate_bench.cpp HostBoard.cpp ../../../Inkplate6Plus.cpp $GFX_DIR/Adafruit_GFX.cpp
+Usage:  inkplate_bench [-r runs] [-t minMs] [-f filter] [-l label] [-o output.json]
+ ****************************************************/
+
+#include "HostBoard.h"
+#include "Inkplate6Plus.h"
+
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+
+#ifndef HOST_GPIO_NULL
+#error "Build benchmarks with -DHOST_GPIO_NULL"
+#endif
+
+#define BENCH_RECTS 1000 // Number of small rectangles in fillRect workload
+#define BENCH_RECT  32   // Their size
+
+struct BenchResult
+{
+    std::string name;
+    uint32_t calls;       // Calls per timed run
+    uint64_t pixels;      // Per call
+    uint64_t bytes;       // Per call
+    double ns;            // Median time of one call
+    double nsMin;         // Fastest run, time of one call
+    bool derived;         // Computed from other results, not timed
+};
+
+static Inkplate display(INKPLATE_1BIT);
+static std::vector<BenchResult> results;
+static int runs = 7;
+static double minNs = 50e6;
+static const char *filter = NULL;
+
+static double nowNs()
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Times _f and keeps the result. Returns median ns of one call (0 if skipped by filter).
+static double bench(const std::string &_name, uint64_t _pixels, uint64_t _bytes, const std::function<void()> &_f)
+{
+    if (filter != NULL && _name.find(filter) == std::string::npos) return 0;
+    double _t = nowNs();
+    _f();
+    _t = nowNs() - _t;
+    uint32_t _calls = _t >= minNs ? 1 : (uint32_t)(minNs / (_t > 1 ? _t : 1)) + 1;
+    std::vector<double> _times;
+    for (int r = 0; r < runs; r++)
+    {
+        _t = nowNs();
+        for (uint32_t i = 0; i < _calls; i++) _f();
+        _times.push_back((nowNs() - _t) / _calls);
+    }
+    std::sort(_times.begin(), _times.end());
+    BenchResult _r = {_name, _calls, _pixels, _bytes, _times[_times.size() / 2], _times[0], false};
+    results.push_back(_r);
+    fprintf(stderr, "%-32s %12.0f ns %9.3f ns/pixel %10.1f MB/s\n", _name.c_str(), _r.ns, _r.ns / _pixels,
+            _bytes / _r.ns * 1e3);
+    return _r.ns;
+}
+
+static void derived(const std::string &_name, uint64_t _pixels, uint64_t _bytes, double _ns)
+{
+    if (_ns <= 0) return;
+    BenchResult _r = {_name, 0, _pixels, _bytes, _ns, _ns, true};
+    results.push_back(_r);
+    fprintf(stderr, "%-32s %12.0f ns %9.3f ns/pixel (derived)\n", _name.c_str(), _ns, _ns / _pixels);
+}
+
+static bool writeJson(FILE *_f, const char *_label)
+{
+    fprintf(_f, "{\n  \"benchmark\": \"inkplate_bench\",\n  \"label\": \"%s\",\n", _label);
+    fprintf(_f, "  \"compiler\": \"%s\",\n  \"runs\": %d,\n  \"results\": [\n", __VERSION__, runs);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &_r = results[i];
+        fprintf(_f,
+                "    {\"name\": \"%s\", \"calls\": %u, \"pixels\": %llu, \"bytes\": %llu, \"ns\": %.0f, \"ns_min\": %.0f, "
+                "\"ns_per_pixel\": %.4f, \"bytes_per_s\": %.0f, \"derived\": %s}%s\n",
+                _r.name.c_str(), _r.calls, (unsigned long long)_r.pixels, (unsigned long long)_r.bytes, _r.ns,
+                _r.nsMin, _r.ns / _r.pixels, _r.bytes / _r.ns * 1e9, _r.derived ? "true" : "false",
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(_f, "  ]\n}\n");
+    return !ferror(_f);
+}
+
+// Full screen BMP in memory: 1 bit (diagonal stripes) or 24 bit (horizontal gradient)
+static std::vector<uint8_t> makeBmp(int _bits, int _w, int _h)
+{
+    uint32_t _palette = _bits == 1 ? 8 : 0;
+    uint32_t _stride = _bits == 1 ? ((_w + 31) / 32) * 4 : ((_w * 3 + 3) / 4) * 4;
+    uint32_t _start = 54 + _palette;
+    uint32_t _size = _start + _stride * _h;
+    std::vector<uint8_t> _b(_size, 0);
+    uint32_t _hdr[][2] = {{2, _size}, {10, _start}, {14, 40}, {18, (uint32_t)_w}, {22, (uint32_t)_h}};
+    _b[0] = 'B';
+    _b[1] = 'M';
+    for (size_t i = 0; i < sizeof(_hdr) / sizeof(_hdr[0]); i++)
+        for (int k = 0; k < 4; k++) _b[_hdr[i][0] + k] = _hdr[i][1] >> (8 * k);
+    _b[26] = 1;
+    _b[28] = _bits;
+    if (_bits == 1) _b[58] = _b[59] = _b[60] = 0xFF;
+    for (int y = 0; y < _h; y++)
+    {
+        uint8_t *_row = &_b[_start + _stride * y];
+        for (int x = 0; x < _w; x++)
+        {
+            if (_bits == 1)
+            {
+                if (((x + y) / 16) & 1) _row[x / 8] |= 0x80 >> (x % 8);
+            }
+            else
+                _row[3 * x] = _row[3 * x + 1] = _row[3 * x + 2] = x * 255 / (_w - 1);
+        }
+    }
+    return _b;
+}
+
+int main(int argc, char **argv)
+{
+    const char *_out = NULL, *_label = "";
+    int _opt;
+    while ((_opt = getopt(argc, argv, "r:t:f:l:o:")) != -1)
+    {
+        if (_opt == 'r') runs = atoi(optarg) > 0 ? atoi(optarg) : 1;
+        else if (_opt == 't') minNs = atof(optarg) * 1e6;
+        else if (_opt == 'f') filter = optarg;
+        else if (_opt == 'l') _label = optarg;
+        else if (_opt == 'o') _out = optarg;
+        else
+        {
+            fprintf(stderr, "Usage: %s [-r runs] [-t minMs] [-f filter] [-l label] [-o output.json]\n", argv[0]);
+            return 255;
+        }
+    }
+    hostBoard.setRecording(false);
+    hostBoard.setSerialEcho(false);
+    display.begin();
+
+    const uint64_t _pixels = (uint64_t)E_INK_WIDTH * E_INK_HEIGHT;
+    const uint64_t _fb1 = _pixels / 8, _fb3 = _pixels / 2;
+    const char *_modes[] = {"1bit", "3bit"};
+    const char *_text = "The quick brown fox jumps over the lazy dog 0123456789";
+
+    uint16_t _rects[BENCH_RECTS][2];
+    uint32_t _seed = 12345;
+    for (int i = 0; i < BENCH_RECTS; i++)
+    {
+        _seed = _seed * 1103515245 + 12345;
+        _rects[i][0] = (_seed >> 8) % (E_INK_WIDTH - BENCH_RECT);
+        _rects[i][1] = (_seed >> 20) % (E_INK_HEIGHT - BENCH_RECT);
+    }
+
+    // Drawing primitives in both modes
+    for (int m = 0; m < 2; m++)
+    {
+        display.selectDisplayMode(m ? INKPLATE_3BIT : INKPLATE_1BIT);
+        uint64_t _fb = m ? _fb3 : _fb1;
+        std::string _mode = _modes[m];
+        for (int r = 0; r < 4; r++)
+        {
+            display.setRotation(r);
+            bench("drawPixel/" + _mode + "/rot" + std::to_string(r), _pixels, _fb, [&]() {
+                int16_t _w = display.width(), _h = display.height();
+                for (int16_t y = 0; y < _h; y++)
+                    for (int16_t x = 0; x < _w; x++) display.drawPixel(x, y, (x ^ y) & 7);
+            });
+        }
+        display.setRotation(0);
+        bench("fillScreen/" + _mode, _pixels, _fb, [&]() { display.fillScreen(m ? 3 : BLACK); });
+        bench("fillRect/" + _mode + "/32x32", (uint64_t)BENCH_RECTS * BENCH_RECT * BENCH_RECT,
+              (uint64_t)BENCH_RECTS * BENCH_RECT * BENCH_RECT * (m ? 4 : 1) / 8, [&]() {
+                  for (int i = 0; i < BENCH_RECTS; i++)
+                      display.fillRect(_rects[i][0], _rects[i][1], BENCH_RECT, BENCH_RECT, i & 1 ? 1 : 0);
+              });
+        for (int _size = 1; _size <= 3; _size += 2)
+        {
+            // Text with background, lines of text fill the whole screen
+            uint32_t _cols = E_INK_WIDTH / (6 * _size), _lines = E_INK_HEIGHT / (8 * _size);
+            uint64_t _textPixels = (uint64_t)_cols * _lines * 48 * _size * _size;
+            bench("print/" + _mode + "/size" + std::to_string(_size), _textPixels, _textPixels * (m ? 4 : 1) / 8,
+                  [&]() {
+                      display.setTextSize(_size);
+                      display.setTextColor(BLACK, WHITE);
+                      for (uint32_t l = 0; l < _lines; l++)
+                      {
+                          display.setCursor(0, l * 8 * _size);
+                          for (uint32_t c = 0; c < _cols; c++) display.write(_text[(c + l) % strlen(_text)]);
+                      }
+                  });
+        }
+    }
+
+    // drawBitmap3Bit, full screen 4 bit source
+    display.selectDisplayMode(INKPLATE_3BIT);
+    std::vector<uint8_t> _gray(_fb3);
+    for (size_t i = 0; i < _gray.size(); i++) _gray[i] = (i * 37) ^ (i >> 9);
+    bench("drawBitmap3Bit", _pixels, _fb3,
+          [&]() { display.drawBitmap3Bit(0, 0, _gray.data(), E_INK_WIDTH, E_INK_HEIGHT); });
+
+    // BMP decoders, full screen images in memory (decoder selects display mode of the image)
+    std::vector<uint8_t> _bmp1 = makeBmp(1, E_INK_WIDTH, E_INK_HEIGHT);
+    std::vector<uint8_t> _bmp24 = makeBmp(24, E_INK_WIDTH, E_INK_HEIGHT);
+    bench("bmp/1bit", _pixels, _bmp1.size(),
+          [&]() { display.drawBitmapFromBuffer(_bmp1.data(), _bmp1.size(), 0, 0); });
+    bench("bmp/24bit", _pixels, _bmp24.size(),
+          [&]() { display.drawBitmapFromBuffer(_bmp24.data(), _bmp24.size(), 0, 0); });
+
+    // Refresh and its parts. Panel stays powered, so power sequence isn't a part of the numbers. Skipping of unchanged
+    // display() is off by default, partial updates change a pixel in every row, so every call does the whole refresh.
+    display.setPowerKeepAlive(60000);
+    display.selectDisplayMode(INKPLATE_1BIT);
+    display.fillRect(100, 100, 400, 300, BLACK);
+    display.display();
+    double _clean = bench("cleanFast/frame", _pixels, 0, [&]() { display.cleanFast(3, 1); });
+
+    // Refresh sequences, frames with framebuffer data and frames from cleanFast()
+    const int _frames1b[2] = {5, 41}, _frames3b[2] = {9, 39}, _framesPartial[2] = {3, 3};
+    double _t = bench("display/1bit", _pixels, _fb1, [&]() { display.display(); });
+    if (_t > 0 && _clean > 0)
+        derived("display1b/rowPrep", _pixels, _fb1, (_t - _frames1b[1] * _clean) / _frames1b[0]);
+
+    bench("partialDiff/full", _pixels, 2 * _fb1, [&]() { display.partialDiff(0, E_INK_HEIGHT - 1); });
+    bench("partialDiff/band", (uint64_t)E_INK_WIDTH * 121, 2 * E_INK_WIDTH / 8 * 121,
+          [&]() { display.partialDiff(440, 560); });
+    // Diff doesn't depend on the content, one changed pixel per row is enough (unchanged rows are skipped)
+    _t = bench("partialUpdate/full", _pixels, 2 * _fb1, [&]() {
+        display.drawFastVLine(0, 0, E_INK_HEIGHT, !(display._partial[0] & 1));
+        display.partialUpdate();
+    });
+    if (_t > 0 && _clean > 0)
+        derived("partialUpdate/rowPrep", _pixels, 2 * _fb1,
+                (_t - _framesPartial[1] * _clean) / _framesPartial[0]);
+    bench("partialUpdate/band", (uint64_t)E_INK_WIDTH * 121, 2 * E_INK_WIDTH / 8 * 121,
+          [&]() {
+              display.drawFastVLine(0, 440, 121, !(display._partial[440 * E_INK_WIDTH / 8] & 1));
+              display.partialUpdate(440, 560);
+          });
+
+    // With skipping: display() of the shown image costs only row checksums, partial update drives one changed row
+    display.setSkipUnchanged(true);
+    display.display();
+    bench("display/1bit/unchanged", _pixels, _fb1, [&]() { display.display(); });
+    bench("partialUpdate/1row", _pixels, _fb1, [&]() {
+        display.drawPixel(0, 0, !(display._partial[0] & 1));
+        display.partialUpdate();
+    });
+    display.setSkipUnchanged(false);
+
+    display.selectDisplayMode(INKPLATE_3BIT);
+    display.drawBitmap3Bit(0, 0, _gray.data(), E_INK_WIDTH, E_INK_HEIGHT);
+    _t = bench("display/3bit", _pixels, _fb3, [&]() { display.display(); });
+    if (_t > 0 && _clean > 0)
+        derived("display3b/rowPrep", _pixels, _fb3, (_t - _frames3b[1] * _clean) / _frames3b[0]);
+    display.setPowerKeepAlive(0);
+
+    FILE *_f = _out != NULL ? fopen(_out, "w") : stdout;
+    if (_f == NULL)
+    {
+        perror(_out);
+        return 255;
+    }
+    bool _ok = writeJson(_f, _label);
+    if (_f != stdout) _ok = fclose(_f) == 0 && _ok;
+    return _ok ? 0 : 1;
+}
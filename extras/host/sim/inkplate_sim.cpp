@@ -0,0 +1,501 @@
+/***************************************************
+Runs Inkplate library on the simulated board (HostBoard.h) on Linux.
+
+Library is built from the same sources as for ESP32, only against the host stand-ins in this directory. Program
+draws into framebuffer, refreshes the panel in both display modes and with partial updates, and checks that the
+simulated panel shows what is in the framebuffer. Every check prints PASS or FAIL (exit code is number of failed
+checks). After each refresh it prints the recorded frames (rows, CL and CKV pulses, virtual time) and saves the panel
+as PGM image into output directory.
+
+Adafruit GFX library isn't a part of this repository, GFX_DIR has to point to it (version 1.7 or newer).
+ARDUINO is defined like in Arduino IDE builds, InkplateTerminal.cpp includes Inkplate6Plus.h before any Arduino header.
+
+Build (in this directory):
+  g++ -O2 -std=gnu++11 -pthread -DINKPLATE_HOST -DARDUINO=10800 -I. -I../../.. -I$GFX_DIR -o inkplate_sim inkplate_sim.cpp \
+      HostBoard.cpp ../../../Inkplate6Plus.cpp ../../../InkplateTerminal.cpp ../../../InkplateTiledImage.cpp \
+      ../../../InkplateGesture.cpp $GFX_DIR/Adafruit_GFX.cpp
+Add -DMCP23017_INT_PIN=34 to run power good waits on the simulated I/O expander interrupt instead of polling.
+Usage:  inkplate_sim [-o outputDir]
+ ****************************************************/
+
+#include "HostBoard.h"
+#include "Inkplate6Plus.h"
+#include "InkplateTerminal.h"
+#include "InkplateTiledImage.h"
+#include "InkplateGesture.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+static Inkplate display(INKPLATE_1BIT);
+static int failed = 0;
+static std::string outDir = ".";
+
+static void check(bool _ok, const char *_name)
+{
+    printf("%s %s\n", _ok ? "PASS" : "FAIL", _name);
+    if (!_ok) failed++;
+}
+
+// Prints frames recorded since the last call and saves panel state
+static void report(const char *_name)
+{
+    const std::vector<HostFrame> &_f = hostBoard.frames();
+    uint32_t _rows = 0, _loaded = 0, _cl = 0, _ckv = 0;
+    for (size_t i = 0; i < _f.size(); i++)
+    {
+        _rows += _f[i].rows;
+        _loaded += _f[i].loadedRows;
+        _cl += _f[i].cl;
+        _ckv += _f[i].ckv;
+    }
+    double _ms = _f.empty() ? 0 : (_f.back().end - _f.front().start) / 1e6;
+    printf("  %s: %u frames, %u rows (%u loaded), %u CL, %u CKV, %.1f ms\n", _name, (unsigned)_f.size(), _rows,
+           _loaded, _cl, _ckv, _ms);
+    std::string _path = outDir + "/" + _name + ".pgm";
+    if (!hostBoard.savePgm(_path.c_str())) printf("  can't write %s\n", _path.c_str());
+}
+
+// Compares simulated panel with 1 bit framebuffer (black pixel must be fully black, white fully white)
+static bool panelMatches1b(uint8_t *_fb)
+{
+    for (int y = 0; y < E_INK_HEIGHT; y++)
+        for (int x = 0; x < E_INK_WIDTH; x++)
+        {
+            bool _black = _fb[y * E_INK_WIDTH / 8 + x / 8] & (1 << (x % 8));
+            if (hostBoard.pixel(x, y) != (_black ? 0 : 255)) return false;
+        }
+    return true;
+}
+
+// Pixels driven black or white in frames recorded since the last clearFrames()
+static uint64_t drivenPixels()
+{
+    uint64_t _n = 0;
+    for (size_t i = 0; i < hostBoard.frames().size(); i++)
+        _n += hostBoard.frames()[i].pixels[HOST_CODE_BLACK] + hostBoard.frames()[i].pixels[HOST_CODE_WHITE];
+    return _n;
+}
+
+static bool writeBmp1b(const char *_path, int _w, int _h)
+{
+    int _stride = ((_w + 31) / 32) * 4;
+    uint32_t _size = 62 + _stride * _h;
+    uint8_t _hdr[62] = {'B', 'M'};
+    _hdr[2] = _size;
+    _hdr[3] = _size >> 8;
+    _hdr[4] = _size >> 16;
+    _hdr[10] = 62;
+    _hdr[14] = 40;
+    _hdr[18] = _w;
+    _hdr[19] = _w >> 8;
+    _hdr[22] = _h;
+    _hdr[23] = _h >> 8;
+    _hdr[26] = 1;
+    _hdr[28] = 1;
+    _hdr[58] = _hdr[59] = _hdr[60] = 0xFF; // Palette: 0 black, 1 white
+    FILE *_f = fopen(_path, "wb");
+    if (_f == NULL) return false;
+    fwrite(_hdr, 1, sizeof(_hdr), _f);
+    std::vector<uint8_t> _row(_stride);
+    for (int y = _h - 1; y >= 0; y--)
+    {
+        for (int x = 0; x < _stride; x++)
+            _row[x] = ((x + y / 8) & 1) ? 0x00 : 0xFF; // 8x8 checkerboard, bit 0 is black
+        fwrite(_row.data(), 1, _stride, _f);
+    }
+    return fclose(_f) == 0;
+}
+
+// One level 100 x 50 tiled image with 64 pixel tiles (all blank), level table values can be damaged
+static bool writeTiled(const char *_path, uint16_t _tilesX, uint32_t _indexOffset)
+{
+    uint8_t _d[44] = {'I', 'P', 'T', 'I', 1, 1, 1, 0, 64, 0, 0, 0, 100, 0, 0, 0, 50, 0, 0, 0};
+    _d[20] = 100;
+    _d[24] = 50;
+    _d[28] = _tilesX;
+    _d[30] = 1;
+    _d[32] = _indexOffset;
+    _d[33] = _indexOffset >> 8;
+    FILE *_f = fopen(_path, "wb");
+    if (_f == NULL) return false;
+    fwrite(_d, 1, sizeof(_d), _f);
+    return fclose(_f) == 0;
+}
+
+// Feeds one touch sample (_fingers 0 is release), returns recognized gesture type or GESTURE_NONE
+static uint8_t touch(InkplateGesture &_r, gestureEvent *_g, uint32_t _t, uint8_t _fingers, uint16_t _x0 = 0,
+                     uint16_t _y0 = 0, uint16_t _x1 = 0, uint16_t _y1 = 0)
+{
+    touchEvent _e = {_t, _fingers, {_x0, _x1}, {_y0, _y1}};
+    return _r.feed(_e, _g) ? _g->type : GESTURE_NONE;
+}
+
+int main(int argc, char **argv)
+{
+    int _opt;
+    while ((_opt = getopt(argc, argv, "o:")) != -1)
+    {
+        if (_opt == 'o')
+            outDir = optarg;
+        else
+        {
+            fprintf(stderr, "Usage: %s [-o outputDir]\n", argv[0]);
+            return 255;
+        }
+    }
+    mkdir(outDir.c_str(), 0777);
+    hostBoard.setSdRoot(outDir.c_str());
+    hostBoard.setTemperature(31);
+    hostBoard.setBattery(3.7);
+
+    display.begin();
+    check(!hostBoard.panelPowered(), "panel is off after begin");
+    check(display.readTemperature() == 31, "readTemperature");
+    double _bat = display.readBattery();
+    check(_bat > 3.69 && _bat < 3.71, "readBattery");
+    check(!hostBoard.panelPowered(), "panel is off after temperature reading");
+
+    // 1 bit mode
+    hostBoard.clearFrames();
+    display.setRefreshStats(true);
+    display.setEnergyAccounting(true);
+    display.clearDisplay();
+    display.fillRect(100, 100, 300, 200, BLACK);
+    display.drawLine(0, 0, E_INK_WIDTH - 1, E_INK_HEIGHT - 1, BLACK);
+    display.setTextSize(4);
+    display.setTextColor(BLACK, WHITE);
+    display.setCursor(500, 50);
+    display.print("Inkplate host build");
+    display.display();
+    check(!hostBoard.panelPowered(), "panel is off after refresh");
+    check(panelMatches1b(display._partial), "display() 1 bit");
+    const std::vector<HostFrame> &_f = hostBoard.frames();
+    bool _full = !_f.empty();
+    for (size_t i = 0; i < _f.size(); i++)
+        _full = _full && _f[i].rows == E_INK_HEIGHT && _f[i].loadedRows == E_INK_HEIGHT && _f[i].driven;
+    check(_full, "every frame of display() latches all rows");
+    report("display_1bit");
+    refreshStats _st = display.getRefreshStats();
+    uint64_t _phases = 0;
+    for (int i = 0; i < REFRESH_PHASES; i++) _phases += _st.cycles[i];
+    check(_st.refreshes == 1 && _st.frames == _f.size() && _st.rows == _f.size() * E_INK_HEIGHT &&
+              _st.cycles[REFRESH_PHASE_POWER_ON] > 0 && _st.cycles[REFRESH_PHASE_DATA] > 0 &&
+              _phases >= _st.lastCycles && _st.i2cTransactions > 0,
+          "refresh stats of display()");
+    display.printRefreshStats(Serial);
+    check(display.getEnergyStats().drivenPixels == drivenPixels() && display.getEnergyStats().last > 0,
+          "energy model of display()");
+
+    // Partial update of the whole screen and of a band of rows
+    hostBoard.clearFrames();
+    display.fillRect(600, 300, 200, 100, BLACK);
+    display.fillRect(100, 150, 100, 50, WHITE);
+    display.partialUpdate();
+    check(panelMatches1b(display._partial), "partialUpdate()");
+    report("partial_full");
+
+    hostBoard.clearFrames();
+    display.resetRefreshStats();
+    display.resetEnergyStats();
+    display.fillCircle(700, 500, 60, BLACK);
+    display.fillRect(0, 100, 50, 50, BLACK); // Outside of updated rows, must stay for the next update
+    display.partialUpdate(440, 560);
+    const std::vector<HostFrame> &_p = hostBoard.frames();
+    check(!_p.empty() && _p[0].loadedRows == (560 - 440 + 1) + 2, "partialUpdate(y1, y2) loads only updated rows");
+    check(hostBoard.pixel(700, 500) == 0 && hostBoard.pixel(10, 110) == 255, "partialUpdate(y1, y2) panel content");
+    report("partial_band");
+    _st = display.getRefreshStats();
+    check(_st.refreshes == 1 && _st.frames == 6 && _st.loadedRows == 3 * (560 - 440 + 1 + 2) + 3 * E_INK_HEIGHT,
+          "refresh stats of partialUpdate(y1, y2)");
+    check(display.getEnergyStats().drivenPixels == drivenPixels() && display.getEnergyStats().refreshes == 1,
+          "energy model of partialUpdate(y1, y2)");
+    display.setRefreshStats(false);
+    display.setEnergyAccounting(false);
+    hostBoard.clearFrames();
+    display.partialUpdate();
+    check(panelMatches1b(display._partial), "change outside of band is shown by the next update");
+
+    // Partial update without changes is skipped. display() is skipped only if turned on and the last refresh was
+    // display() of the same image, so display() after partial updates still removes ghosting.
+    uint32_t _skipped = display.getRefreshesSkipped();
+    hostBoard.clearFrames();
+    display.partialUpdate();
+    check(hostBoard.frames().empty() && display.getRefreshesSkipped() == _skipped + 1, "unchanged partialUpdate is skipped");
+    display.display();
+    check(!hostBoard.frames().empty(), "display() of unchanged image refreshes by default");
+    display.setSkipUnchanged(true);
+    display.fillRect(200, 650, 10, 4, BLACK);
+    display.partialUpdate();
+    hostBoard.clearFrames();
+    display.display();
+    check(!hostBoard.frames().empty(), "display() after partialUpdate() refreshes with skipping on");
+    hostBoard.clearFrames();
+    display.display();
+    check(hostBoard.frames().empty() && display.getRefreshesSkipped() == _skipped + 2,
+          "display() of the image shown by the last display() is skipped");
+    display.setSkipUnchanged(false);
+    display.fillRect(200, 600, 10, 4, BLACK);
+    display.partialUpdate();
+    check(!_p.empty() && _p[0].loadedRows == 4 + 2 && panelMatches1b(display._partial),
+          "partialUpdate() drives only changed rows");
+
+    // Event tracer, dumped as Chrome trace JSON
+    check(display.traceBegin(4096), "traceBegin");
+    display.fillRect(300, 300, 100, 100, BLACK);
+    display.partialUpdate();
+    hostBoard.setSerialEcho(false);
+    hostBoard.serialOutput();
+    uint32_t _events = display.traceDump(Serial);
+    std::string _json = hostBoard.serialOutput();
+    hostBoard.setSerialEcho(true);
+    display.traceEnd();
+    size_t _b = 0, _e = 0;
+    for (size_t p = 0; (p = _json.find("\"ph\":\"B\"", p)) != std::string::npos; p++) _b++;
+    for (size_t p = 0; (p = _json.find("\"ph\":\"E\"", p)) != std::string::npos; p++) _e++;
+    check(_events > 0 && _b + _e == _events && _b == _e && _json.find("\"partialUpdate\"") != std::string::npos &&
+              _json.find("\"i2c 0x20\"") != std::string::npos && display.getTraceDropped() == 0,
+          "traceDump");
+    FILE *_tf = fopen((outDir + "/trace.json").c_str(), "w");
+    if (_tf != NULL)
+    {
+        fwrite(_json.data(), 1, _json.size(), _tf);
+        fclose(_tf);
+    }
+
+    // Gap between events longer than any 32 bit counter period must not shift later timestamps
+    display.traceBegin(16);
+    Inkplate::traceWrite(TRACE_USER, 'i');
+    hostBoard.advance(60ull * 1000000000);
+    Inkplate::traceWrite(TRACE_USER, 'i');
+    hostBoard.setSerialEcho(false);
+    display.traceDump(Serial);
+    _json = hostBoard.serialOutput();
+    hostBoard.setSerialEcho(true);
+    display.traceEnd();
+    double _ts[2] = {0, 0};
+    size_t _at = 0;
+    for (int i = 0; i < 2 && (_at = _json.find("\"ts\":", _at)) != std::string::npos; i++, _at++)
+        _ts[i] = atof(_json.c_str() + _at + 5);
+    check(_ts[1] - _ts[0] >= 60e6 && _ts[1] - _ts[0] < 60e6 + 1000, "trace timestamps after long gap");
+
+    // Keep-alive timer and battery monitor run on their own threads
+    display.setPowerKeepAlive(50);
+    display.fillRect(300, 300, 100, 100, WHITE);
+    display.partialUpdate();
+    bool _kept = hostBoard.panelPowered();
+    usleep(200000);
+    check(_kept && !hostBoard.panelPowered(), "panel power keep-alive");
+    display.setPowerKeepAlive(0);
+    hostBoard.setBattery(3.5);
+    check(display.batteryMonitorBegin(20), "batteryMonitorBegin");
+    usleep(100000);
+    _bat = display.readBattery();
+    display.batteryMonitorEnd();
+    check(display.getBatteryTime() != 0 && _bat > 3.49 && _bat < 3.71, "battery monitor");
+
+    // Flash image store
+    check(display.flashStoreBegin() && display.flashStoreSave("screen"), "flashStoreSave");
+    std::vector<uint8_t> _saved(display._partial, display._partial + E_INK_WIDTH * E_INK_HEIGHT / 8);
+    display.clearDisplay();
+    check(display.flashStoreDraw("screen") &&
+              memcmp(_saved.data(), display._partial, _saved.size()) == 0,
+          "flashStoreDraw");
+    // Space of removed images is used again, failed write keeps the old image, damaged directory falls back to the
+    // previous copy
+    std::vector<uint8_t> _img(E_INK_WIDTH * E_INK_HEIGHT / 2);
+    int _stored = 0;
+    char _name[16];
+    display.flashStoreFormat();
+    for (bool _ok = true; _ok; _stored += _ok)
+    {
+        memset(_img.data(), _stored, _img.size());
+        MemorySource _src(_img.data(), _img.size());
+        sprintf(_name, "img%d", _stored);
+        _ok = display.flashStoreWrite(_name, INKPLATE_3BIT, &_src);
+    }
+    MemorySource _again(_img.data(), _img.size());
+    check(_stored > 2 && display.flashStoreRemove("img0") && display.flashStoreWrite("again", INKPLATE_3BIT, &_again),
+          "flash store reuses space");
+    MemorySource _short(_img.data(), 1000);
+    display.flashStoreRemove("again");
+    check(!display.flashStoreWrite("img1", INKPLATE_3BIT, &_short) && display.flashStoreDraw("img1") &&
+              display.D_memory4Bit[0] == 1 && display.D_memory4Bit[_img.size() - 1] == 1,
+          "failed flash write keeps old image");
+    display.flashStoreRemove("img2");
+    uint8_t *_part = hostBoard.partition();
+    uint32_t _seq0, _seq1;
+    memcpy(&_seq0, _part + 8, 4);
+    memcpy(&_seq1, _part + 4096 + 8, 4);
+    _part[(_seq1 > _seq0 ? 4096 : 0) + 20] ^= 1;
+    Inkplate *_fresh = new Inkplate(INKPLATE_1BIT);
+    check(_fresh->flashStoreBegin() && _fresh->flashStoreCount() == _stored - 1 && _fresh->flashStoreFind("img2") >= 0,
+          "flash store directory fallback");
+    delete _fresh;
+    display.flashStoreFormat();
+    display.selectDisplayMode(INKPLATE_1BIT);
+
+    // Bitmap from SD card
+    std::string _bmp = outDir + "/checker.bmp";
+    check(writeBmp1b(_bmp.c_str(), 256, 128) && display.sdCardInit(), "sdCardInit");
+    display.clearDisplay();
+    hostBoard.sdBlockReads();
+    check(display.drawBitmapFromSD((char *)"checker.bmp", 64, 64) == 1, "drawBitmapFromSD");
+    check(hostBoard.sdBlockReads() > 0 && hostBoard.sdBlockErrors() == 0, "bitmap read with raw SD block reads");
+    hostBoard.clearFrames();
+    display.display();
+    // Decoder draws the top row of the bitmap at y + 1
+    check(hostBoard.pixel(64, 65) == 255 && hostBoard.pixel(72, 65) == 0 && hostBoard.pixel(64, 73) == 0,
+          "bitmap on panel");
+    report("bitmap");
+
+    // Raw SD reads: on read error SPI clock is lowered (not below SD_MIN_MHZ), card is initialized again and the read is
+    // retried, if it still fails, file is read through FAT functions. Card that can't be initialized is a read error.
+    std::vector<uint8_t> _bmpFb(display._partial, display._partial + E_INK_WIDTH * E_INK_HEIGHT / 8);
+    hostBoard.setSdMaxClock(8000000);
+    display.clearDisplay();
+    check(display.drawBitmapFromSD((char *)"checker.bmp", 64, 64) == 1 && display.getSdClock() == 6 &&
+              hostBoard.sdBlockErrors() == 2 && memcmp(_bmpFb.data(), display._partial, _bmpFb.size()) == 0,
+          "SD read retried at lower clock");
+    hostBoard.setSdMaxClock(0);
+    hostBoard.setSdReadErrors(100);
+    display.clearDisplay();
+    check(display.drawBitmapFromSD((char *)"checker.bmp", 64, 64) == 1 && display.getSdClock() == SD_MIN_MHZ &&
+              memcmp(_bmpFb.data(), display._partial, _bmpFb.size()) == 0,
+          "SD read falls back to FAT at minimal clock");
+    hostBoard.setSdReadErrors(0);
+    SdFile _bmpFile;
+    check(_bmpFile.open("checker.bmp", O_RDONLY) && display.drawBitmapFromSD(&_bmpFile, 64, 64) == 1 &&
+              _bmpFile.isOpen(),
+          "drawBitmapFromSD leaves file open");
+    _bmpFile.close();
+    display.sdCardInit();
+    hostBoard.setSdMaxClock(1000000);
+    check(display.drawBitmapFromSD((char *)"checker.bmp", 64, 64) == 0 && display.getSdClock() == SD_MIN_MHZ,
+          "SD card that can't be initialized is read error");
+    hostBoard.setSdMaxClock(5000000);
+    check(display.sdCardInit() && display.getSdClock() == SD_MIN_MHZ, "sdCardInit lowers clock to SD_MIN_MHZ");
+    hostBoard.setSdMaxClock(0);
+    display.sdCardInit();
+
+    // Slideshow: image that fails to prefetch keeps the shown image in framebuffer, task exits when slideshow ends
+    display.clearDisplay();
+    display.drawBitmapFromSD((char *)"checker.bmp", 64, 64);
+    check(display.displayAndPrefetch((char *)"missing.bmp", 0, 0) == 0 &&
+              memcmp(_bmpFb.data(), display._partial, _bmpFb.size()) == 0,
+          "failed prefetch keeps previous image");
+    display.clearDisplay();
+    check(display.displayAndPrefetch((char *)"checker.bmp", 64, 64) == 1 &&
+              memcmp(_bmpFb.data(), display._partial, _bmpFb.size()) == 0,
+          "prefetched image in framebuffer");
+    display.slideshowEnd();
+    check(display.displayAndPrefetch((char *)"checker.bmp", 64, 64) == 1, "slideshow restarts after slideshowEnd");
+    display.slideshowEnd();
+
+    // Tiled image: level table that doesn't cover the level or points outside of the file is rejected
+    InkplateTiledImage _tiled(display);
+    check(writeTiled((outDir + "/tiled.ipt").c_str(), 2, 36) && _tiled.open("tiled.ipt") && _tiled.getWidth() == 100,
+          "tiled image open");
+    check(writeTiled((outDir + "/tiled.ipt").c_str(), 1, 36) && !_tiled.open("tiled.ipt"),
+          "tiled image with too few tiles rejected");
+    check(writeTiled((outDir + "/tiled.ipt").c_str(), 2, 40) && !_tiled.open("tiled.ipt"),
+          "tiled image with index outside of file rejected");
+
+    // Terminal: output is batched into one refresh of changed rows, scrolling moves framebuffer rows
+    InkplateTerminal _term(display);
+    check(_term.begin() && _term.getColumns() == E_INK_WIDTH / 6 && _term.getRows() == E_INK_HEIGHT / 8,
+          "terminal begin");
+    _term.refresh();
+    hostBoard.clearFrames();
+    _term.print("first line\nsecond \x1b[7mreverse\x1b[0m line\r\n\x1b[4munderlined\x1b[24m");
+    uint32_t _refreshes = _term.getRefreshes();
+    check(_term.refresh() && _term.getRefreshes() == _refreshes + 1 && panelMatches1b(display._partial) &&
+              !_p.empty() && _p[0].loadedRows <= 3 * 8 + 1,
+          "terminal refresh of changed rows");
+    for (int i = 0; i < 300; i++) _term.printf("log line %d\n", i);
+    hostBoard.clearFrames();
+    check(_term.refresh() && _term.getRefreshes() == _refreshes + 2 && panelMatches1b(display._partial) &&
+              _term.getCursorRow() == _term.getRows() - 1 && _term.getCursorColumn() == 0,
+          "terminal scrolling");
+    _term.print("\x1b[5;10r\x1b[10;1Hbottom\n\x1b[3;20H\x1b[2Dab\x1b[K\x1b[2A");
+    check(_term.getCursorRow() == 0 && _term.getCursorColumn() == 19, "terminal escape sequences");
+    _term.print("\x1b[2J\x1b[H\x1b]0;title\x07\x1b[?25lhome");
+    check(_term.getCursorRow() == 0 && _term.getCursorColumn() == 4 && _term.refresh() &&
+              panelMatches1b(display._partial) && !_term.refresh(),
+          "terminal clear screen");
+    _term.end();
+
+    // Frame start staging: same panel content, SPV low write moves out of vscan_start()
+    display.clearDisplay();
+    display.fillRect(200, 200, 300, 300, BLACK);
+    display.setFrameStartStaging(false);
+    display.display();
+    uint32_t _startPlain = display.getFrameStartTime();
+    display.setFrameStartStaging(true);
+    display.display();
+    uint32_t _startStaged = display.getFrameStartTime();
+    display.setFrameStartStaging(VSCAN_STAGE_SPV);
+    check(panelMatches1b(display._partial) && _startStaged < _startPlain, "frame start staging");
+
+    // Gestures from synthetic touch samples
+    InkplateGesture _gr;
+    gestureEvent _ge;
+    bool _ok = touch(_gr, &_ge, 0, 1, 100, 100) == GESTURE_NONE && touch(_gr, &_ge, 100, 0) == GESTURE_NONE &&
+               !_gr.update(300, &_ge) && _gr.update(460, &_ge) && _ge.type == GESTURE_TAP && _ge.x == 100 &&
+               _ge.y == 100 && !_gr.update(2000, &_ge);
+    check(_ok, "gesture tap reported after double tap time");
+    _ok = touch(_gr, &_ge, 1000, 1, 100, 100) == GESTURE_NONE && touch(_gr, &_ge, 1100, 0) == GESTURE_NONE &&
+          touch(_gr, &_ge, 1500, 1, 600, 600) == GESTURE_TAP && _ge.x == 100 && touch(_gr, &_ge, 1600, 0) == GESTURE_NONE;
+    check(_ok, "gesture pending tap reported by next sample");
+    _gr.reset();
+    _ok = touch(_gr, &_ge, 2000, 1, 300, 300) == GESTURE_NONE && touch(_gr, &_ge, 2080, 0) == GESTURE_NONE &&
+          touch(_gr, &_ge, 2200, 1, 305, 302) == GESTURE_NONE && touch(_gr, &_ge, 2280, 0) == GESTURE_DOUBLE_TAP &&
+          !_gr.update(3000, &_ge);
+    check(_ok, "gesture double tap");
+    _ok = touch(_gr, &_ge, 4000, 1, 200, 200) == GESTURE_NONE && !_gr.update(4500, &_ge) && _gr.update(4800, &_ge) &&
+          _ge.type == GESTURE_LONG_PRESS && !_gr.update(4900, &_ge) && touch(_gr, &_ge, 5200, 0) == GESTURE_NONE &&
+          !_gr.update(6000, &_ge);
+    check(_ok, "gesture long press");
+    const int16_t _swipe[4][2] = {{-200, 0}, {200, 0}, {0, -200}, {0, 200}};
+    _ok = true;
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t _t = 7000 + i * 1000;
+        _ok = _ok && touch(_gr, &_ge, _t, 1, 500, 400) == GESTURE_NONE &&
+              touch(_gr, &_ge, _t + 100, 1, 500 + _swipe[i][0] / 2, 400 + _swipe[i][1] / 2) == GESTURE_NONE &&
+              touch(_gr, &_ge, _t + 200, 1, 500 + _swipe[i][0], 400 + _swipe[i][1]) == GESTURE_NONE &&
+              touch(_gr, &_ge, _t + 250, 0) == GESTURE_SWIPE_LEFT + i && _ge.dx == _swipe[i][0] &&
+              _ge.dy == _swipe[i][1];
+    }
+    check(_ok, "gesture swipes");
+    _ok = touch(_gr, &_ge, 12000, 2, 450, 400, 550, 400) == GESTURE_NONE &&
+          touch(_gr, &_ge, 12100, 2, 425, 400, 575, 400) == GESTURE_PINCH_OUT && _ge.scale > 1.49 &&
+          _ge.scale < 1.51 && _ge.x == 500 && touch(_gr, &_ge, 12150, 2, 430, 400, 570, 400) == GESTURE_NONE &&
+          touch(_gr, &_ge, 12200, 2, 475, 400, 525, 400) == GESTURE_PINCH_IN && _ge.scale < 0.34 &&
+          touch(_gr, &_ge, 12300, 0) == GESTURE_NONE && !_gr.update(13000, &_ge);
+    check(_ok, "gesture pinch out and in");
+    // Release that completes a swipe also ends the double tap wait: tap comes first, swipe on the next call
+    _ok = touch(_gr, &_ge, 14000, 1, 300, 300) == GESTURE_NONE && touch(_gr, &_ge, 14050, 0) == GESTURE_NONE &&
+          touch(_gr, &_ge, 14200, 1, 300, 300) == GESTURE_NONE && touch(_gr, &_ge, 14340, 1, 500, 300) == GESTURE_NONE &&
+          touch(_gr, &_ge, 14450, 0) == GESTURE_TAP && _ge.time == 14050 && _gr.update(14460, &_ge) &&
+          _ge.type == GESTURE_SWIPE_RIGHT && _ge.dx == 200 && !_gr.update(14470, &_ge);
+    check(_ok, "gesture after pending tap returned by update()");
+    _ok = touch(_gr, &_ge, 15000, 1, 300, 300) == GESTURE_NONE && touch(_gr, &_ge, 15050, 0) == GESTURE_NONE &&
+          touch(_gr, &_ge, 15200, 1, 300, 300) == GESTURE_NONE && touch(_gr, &_ge, 15340, 1, 300, 100) == GESTURE_NONE &&
+          touch(_gr, &_ge, 15450, 0) == GESTURE_TAP && touch(_gr, &_ge, 15460, 1, 700, 700) == GESTURE_SWIPE_UP &&
+          _ge.dy == -200 && touch(_gr, &_ge, 15500, 0) == GESTURE_NONE;
+    check(_ok, "gesture after pending tap returned by feed()");
+
+    // 3 bit mode: black and white must end up at the ends of the scale
+    display.selectDisplayMode(INKPLATE_3BIT);
+    hostBoard.clearFrames();
+    for (int i = 0; i < 8; i++)
+        display.fillRect(i * 128, 0, 128, E_INK_HEIGHT, i);
+    display.display();
+    check(hostBoard.level(64, 300) > hostBoard.level(E_INK_WIDTH - 64, 300), "display() 3 bit");
+    report("display_3bit");
+
+    printf("I2C: %u transactions, %llu bytes, virtual time %.3f s\n", hostBoard.i2cTransactions(),
+           (unsigned long long)hostBoard.i2cBytes(), hostBoard.now() / 1e9);
+    return failed;
+}
@@ -0,0 +1,242 @@
+/***************************************************
+Host-side encoder for Inkplate tiled images (see InkplateTiledImage.h for file format).
+
+Converts binary grayscale PGM (P5) image into multi-resolution tiled image that can be viewed with InkplateTiledImage.
+Any image can be converted to PGM first, for example with ImageMagick: convert map.png map.pgm
+
+Build:  g++ -O2 -o tiled_image_encoder tiled_image_encoder.cpp
+Usage:  tiled_image_encoder [-b 1|3] [-t tileSize] [-l levels] input.pgm output.ipt
+  -b  bits per pixel of the output, 1 (black and white, default) or 3 (8 levels of grayscale)
+  -t  tile size in pixels, multiple of 8 (default 128)
+  -l  number of pyramid levels, every next level is half the size of previous one (default: until image fits the panel)
+ ****************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define PANEL_WIDTH  1024
+#define PANEL_HEIGHT 758
+#define MAX_LEVELS   8
+
+struct image
+{
+    uint32_t w;
+    uint32_t h;
+    std::vector<uint8_t> px;
+};
+
+static int readToken(FILE *f)
+{
+    int c, v = 0;
+    do
+    {
+        c = fgetc(f);
+        if (c == '#')
+            while (c != '\n' && c != EOF) c = fgetc(f);
+    } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    if (c < '0' || c > '9') return -1;
+    while (c >= '0' && c <= '9')
+    {
+        v = v * 10 + (c - '0');
+        c = fgetc(f);
+    }
+    return v;
+}
+
+static bool readPgm(const char *name, image &img)
+{
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) return false;
+    if (fgetc(f) != 'P' || fgetc(f) != '5')
+    {
+        fclose(f);
+        return false;
+    }
+    int w = readToken(f);
+    int h = readToken(f);
+    int maxVal = readToken(f);
+    if (w <= 0 || h <= 0 || maxVal <= 0 || maxVal > 255)
+    {
+        fclose(f);
+        return false;
+    }
+    img.w = w;
+    img.h = h;
+    img.px.resize((size_t)w * h);
+    bool ok = fread(img.px.data(), 1, img.px.size(), f) == img.px.size();
+    fclose(f);
+    if (maxVal != 255)
+        for (size_t i = 0; i < img.px.size(); i++) img.px[i] = img.px[i] * 255 / maxVal;
+    return ok;
+}
+
+static image halfSize(const image &src)
+{
+    image dst;
+    dst.w = (src.w + 1) / 2;
+    dst.h = (src.h + 1) / 2;
+    dst.px.resize((size_t)dst.w * dst.h);
+    for (uint32_t y = 0; y < dst.h; y++)
+    {
+        for (uint32_t x = 0; x < dst.w; x++)
+        {
+            uint32_t x1 = (x * 2 + 1) < src.w ? x * 2 + 1 : x * 2;
+            uint32_t y1 = (y * 2 + 1) < src.h ? y * 2 + 1 : y * 2;
+            uint32_t s = src.px[(size_t)(y * 2) * src.w + x * 2] + src.px[(size_t)(y * 2) * src.w + x1] +
+                         src.px[(size_t)y1 * src.w + x * 2] + src.px[(size_t)y1 * src.w + x1];
+            dst.px[(size_t)y * dst.w + x] = s / 4;
+        }
+    }
+    return dst;
+}
+
+// Packs one tile into Inkplate framebuffer layout. Returns false if the tile is completely white.
+static bool packTile(const image &img, uint32_t tx, uint32_t ty, uint16_t ts, uint8_t bpp, std::vector<uint8_t> &out)
+{
+    uint32_t rowBytes = bpp == 1 ? ts / 8 : ts / 2;
+    bool blank = true;
+    out.assign((size_t)rowBytes * ts, bpp == 1 ? 0x00 : 0xFF);
+    for (uint32_t y = 0; y < ts; y++)
+    {
+        uint32_t iy = ty * ts + y;
+        if (iy >= img.h) break;
+        for (uint32_t x = 0; x < ts; x++)
+        {
+            uint32_t ix = tx * ts + x;
+            if (ix >= img.w) break;
+            uint8_t g = img.px[(size_t)iy * img.w + ix];
+            uint8_t *b = &out[(size_t)y * rowBytes + (x / (bpp == 1 ? 8 : 2))];
+            if (bpp == 1)
+            {
+                if (g < 128)
+                {
+                    *b |= 1 << (x & 7);
+                    blank = false;
+                }
+            }
+            else
+            {
+                uint8_t v = g >> 5;
+                *b = (x & 1) ? ((*b & 0xF0) | v) : ((*b & 0x0F) | (v << 4));
+                if (v != 7) blank = false;
+            }
+        }
+    }
+    return !blank;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) p[i] = (v >> (i * 8)) & 0xFF;
+}
+
+int main(int argc, char **argv)
+{
+    int bpp = 1, ts = 128, levels = 0;
+    int i;
+    for (i = 1; i < argc - 2; i++)
+    {
+        if (!strcmp(argv[i], "-b") && i + 1 < argc - 2)
+            bpp = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc - 2)
+            ts = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-l") && i + 1 < argc - 2)
+            levels = atoi(argv[++i]);
+        else
+            break;
+    }
+    if (i != argc - 2 || (bpp != 1 && bpp != 3) || ts <= 0 || ts > 4096 || (ts % 8) != 0 || levels < 0 || levels > MAX_LEVELS)
+    {
+        fprintf(stderr, "Usage: %s [-b 1|3] [-t tileSize] [-l levels] input.pgm output.ipt\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<image> pyramid(1);
+    if (!readPgm(argv[argc - 2], pyramid[0]))
+    {
+        fprintf(stderr, "Can't read binary PGM image %s\n", argv[argc - 2]);
+        return 1;
+    }
+    while ((int)pyramid.size() < (levels ? levels : MAX_LEVELS))
+    {
+        const image &last = pyramid.back();
+        if (!levels && last.w <= PANEL_WIDTH && last.h <= PANEL_HEIGHT) break;
+        if (last.w == 1 && last.h == 1) break;
+        pyramid.push_back(halfSize(last));
+    }
+
+    FILE *f = fopen(argv[argc - 1], "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Can't create %s\n", argv[argc - 1]);
+        return 1;
+    }
+
+    // Header and level table go first, tile index of every level after them and tile data at the end.
+    uint32_t n = pyramid.size();
+    std::vector<uint8_t> header(20 + n * 16, 0);
+    memcpy(&header[0], "IPTI", 4);
+    header[4] = 1;
+    header[5] = bpp;
+    header[6] = n;
+    put16(&header[8], ts);
+    put32(&header[12], pyramid[0].w);
+    put32(&header[16], pyramid[0].h);
+
+    uint32_t offset = header.size();
+    std::vector<std::vector<uint32_t> > index(n);
+    for (uint32_t l = 0; l < n; l++)
+    {
+        uint32_t tilesX = (pyramid[l].w + ts - 1) / ts;
+        uint32_t tilesY = (pyramid[l].h + ts - 1) / ts;
+        put32(&header[20 + l * 16], pyramid[l].w);
+        put32(&header[24 + l * 16], pyramid[l].h);
+        put16(&header[28 + l * 16], tilesX);
+        put16(&header[30 + l * 16], tilesY);
+        put32(&header[32 + l * 16], offset);
+        index[l].assign(tilesX * tilesY, 0);
+        offset += tilesX * tilesY * 4;
+    }
+
+    fseek(f, offset, SEEK_SET);
+    std::vector<uint8_t> tile;
+    uint32_t written = 0, blank = 0;
+    for (uint32_t l = 0; l < n; l++)
+    {
+        uint32_t tilesX = (pyramid[l].w + ts - 1) / ts;
+        for (uint32_t t = 0; t < index[l].size(); t++)
+        {
+            if (!packTile(pyramid[l], t % tilesX, t / tilesX, ts, bpp, tile))
+            {
+                blank++;
+                continue;
+            }
+            index[l][t] = offset;
+            fwrite(tile.data(), 1, tile.size(), f);
+            offset += tile.size();
+            written++;
+        }
+    }
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(header.data(), 1, header.size(), f);
+    for (uint32_t l = 0; l < n; l++)
+    {
+        std::vector<uint8_t> raw(index[l].size() * 4);
+        for (size_t t = 0; t < index[l].size(); t++) put32(&raw[t * 4], index[l][t]);
+        fwrite(raw.data(), 1, raw.size(), f);
+    }
+    fclose(f);
+
+    printf("%s: %u levels, %u tiles written, %u blank tiles skipped, %u bytes\n", argv[argc - 1], n, written, blank, offset);
+    return 0;
+}